@@ -0,0 +1,140 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+// Walker/Vose alias table: draws index i with probability weights[i] / sum in
+// O(1) from a single uniform (column from the integer part, coin from the
+// fraction), so a batch of draws is one branch-free loop of two lookups.
+class AliasTable {
+private:
+    std::vector<double> threshold; // keep the column when the coin is below this
+    std::vector<uint32_t> alias;
+
+public:
+    AliasTable() = default;
+
+    explicit AliasTable(const std::vector<double>& weights) : threshold(weights.size()), alias(weights.size()) {
+        const size_t n = weights.size();
+        double total = 0.0;
+        for (double weight : weights) {
+            if (!(weight >= 0.0)) throw std::invalid_argument("alias table weights must be non-negative");
+            total += weight;
+        }
+        if (n == 0 || total <= 0.0) throw std::invalid_argument("alias table needs a positive weight");
+
+        std::vector<double> scaled(n);
+        std::vector<uint32_t> small, large;
+        for (size_t i = 0; i < n; ++i) {
+            scaled[i] = weights[i] * n / total;
+            (scaled[i] < 1.0 ? small : large).push_back(static_cast<uint32_t>(i));
+        }
+        while (!small.empty() && !large.empty()) {
+            uint32_t low = small.back(), high = large.back();
+            small.pop_back();
+            threshold[low] = scaled[low];
+            alias[low] = high;
+            scaled[high] -= 1.0 - scaled[low];
+            if (scaled[high] < 1.0) {
+                large.pop_back();
+                small.push_back(high);
+            }
+        }
+        // Leftovers are 1 up to rounding
+        for (const auto* rest : {&large, &small}) {
+            for (uint32_t i : *rest) {
+                threshold[i] = 1.0;
+                alias[i] = i;
+            }
+        }
+    }
+
+    size_t size() const { return threshold.size(); }
+
+    uint32_t sample(double uniform) const {
+        double scaled = uniform * static_cast<double>(threshold.size());
+        uint32_t column = std::min(static_cast<uint32_t>(scaled), static_cast<uint32_t>(threshold.size() - 1));
+        return scaled - column < threshold[column] ? column : alias[column];
+    }
+
+    // Indices for uniforms[0..count)
+    void sample(const double* uniforms, size_t count, uint32_t* out) const {
+        const double n = static_cast<double>(threshold.size());
+        const uint32_t last = static_cast<uint32_t>(threshold.size() - 1);
+        for (size_t k = 0; k < count; ++k) {
+            double scaled = uniforms[k] * n;
+            uint32_t column = std::min(static_cast<uint32_t>(scaled), last);
+            out[k] = scaled - column < threshold[column] ? column : alias[column];
+        }
+    }
+};
+
+// Historical per-period log returns for the bootstrap engines, one run of
+// consecutive returns per segment (a ticker's series splits at gaps and at
+// non-positive values). next[i] is the return after i within its segment,
+// wrapping to the segment's first, so blocks never cross a gap or a ticker
+// (circular block bootstrap). Start positions are drawn through an alias table
+// in which every series added weighs the same, however long its history.
+class ReturnHistory {
+private:
+    std::vector<double> logReturns;
+    std::vector<uint32_t> following;
+    std::vector<double> weights;
+    size_t seriesCount = 0;
+    AliasTable starts;
+
+public:
+    // values[0..count) in time order, one per period; NaN marks a missing period
+    template <typename Value>
+    void addSeries(const Value* values, size_t count) {
+        size_t first = logReturns.size();
+        size_t segmentStart = first;
+        auto closeSegment = [&] {
+            for (size_t i = segmentStart; i < logReturns.size(); ++i) {
+                following.push_back(static_cast<uint32_t>(i + 1 < logReturns.size() ? i + 1 : segmentStart));
+            }
+            segmentStart = logReturns.size();
+        };
+        for (size_t t = 1; t < count; ++t) {
+            double previous = values[t - 1], current = values[t];
+            if (previous > 0 && current > 0) {
+                logReturns.push_back(std::log(current / previous));
+            } else {
+                closeSegment();
+            }
+        }
+        closeSegment();
+
+        size_t added = logReturns.size() - first;
+        if (added == 0) return;
+        seriesCount++;
+        weights.insert(weights.end(), added, 1.0 / static_cast<double>(added));
+        starts = AliasTable();
+    }
+
+    // Builds the start table; call after the last addSeries
+    void finish() {
+        if (!logReturns.empty()) starts = AliasTable(weights);
+    }
+
+    bool empty() const { return logReturns.empty(); }
+    size_t size() const { return logReturns.size(); }
+    size_t series() const { return seriesCount; }
+    const double* returns() const { return logReturns.data(); }
+    const uint32_t* next() const { return following.data(); }
+    const AliasTable& startTable() const { return starts; }
+    bool ready() const { return starts.size() == logReturns.size() && !logReturns.empty(); }
+};
+
+enum class BootstrapMode {
+    Block,     // circular blocks of a fixed length
+    Stationary // geometric block lengths with the given mean (Politis & Romano)
+};
+
+inline const char* bootstrapModeName(BootstrapMode mode) {
+    return mode == BootstrapMode::Block ? "Block bootstrap" : "Stationary bootstrap";
+}
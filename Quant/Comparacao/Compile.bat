@@ -1,12 +1,29 @@
 @echo off
-echo Compiling with SQLite library...
-g++ -std=c++17 main.cpp -lsqlite3 -o app.exe
-
-if %errorlevel% equ 0 (
-    echo Compilation successful!
-    echo Running application...
-    app.exe
-) else (
-    echo Compilation failed!
-    pause
-)
\ No newline at end of file
+rem Quick build without CMake (see CMakeLists.txt for the LTO / PGO / -march=native
+rem configurations). sqlite3.o is only compiled when it is missing.
+cd /d "%~dp0"
+set SQLITE_FLAGS=-DSQLITE_THREADSAFE=2 -DSQLITE_DEFAULT_MEMSTATUS=0 -DSQLITE_DEFAULT_WAL_SYNCHRONOUS=1 -DSQLITE_LIKE_DOESNT_MATCH_BLOBS -DSQLITE_OMIT_DEPRECATED -DSQLITE_OMIT_SHARED_CACHE -DSQLITE_OMIT_LOAD_EXTENSION -DSQLITE_USE_ALLOCA
+set CXXFLAGS=-std=c++17 -O2 -pthread -I.
+
+if not exist sqlite3.o (
+    echo Compiling SQLite...
+    gcc -O2 -w %SQLITE_FLAGS% -c sqlite3.c -o sqlite3.o
+    if errorlevel 1 goto failed
+)
+
+echo Compiling Finance Analysis Tool...
+g++ %CXXFLAGS% main.cpp sqlite3.o -o app.exe
+if errorlevel 1 goto failed
+
+echo Compilation successful!
+echo Compiling SEC ingestion tool...
+g++ %CXXFLAGS% ingest.cpp sqlite3.o -lcurl -o ingest.exe || echo ingest not built (requires libcurl)
+echo Compiling benchmarks...
+g++ %CXXFLAGS% bench.cpp sqlite3.o -lbenchmark -lshlwapi -o bench.exe || echo bench not built (requires Google Benchmark)
+echo Running application...
+app.exe
+goto :eof
+
+:failed
+echo Compilation failed!
+pause
\ No newline at end of file
@@ -1,11 +1,24 @@
 #!/bin/bash
+# Quick build without CMake (see CMakeLists.txt for the LTO / PGO / -march=native
+# configurations). sqlite3.o is only recompiled when sqlite3.c changes.
+cd "$(dirname "$0")"
+SQLITE_FLAGS="-DSQLITE_THREADSAFE=2 -DSQLITE_DEFAULT_MEMSTATUS=0 -DSQLITE_DEFAULT_WAL_SYNCHRONOUS=1 -DSQLITE_LIKE_DOESNT_MATCH_BLOBS -DSQLITE_OMIT_DEPRECATED -DSQLITE_OMIT_SHARED_CACHE -DSQLITE_OMIT_LOAD_EXTENSION -DSQLITE_USE_ALLOCA"
+CXXFLAGS="-std=c++17 -O2 -pthread -I."
+if [ ! -f sqlite3.o ] || [ sqlite3.c -nt sqlite3.o ]; then
+    echo "Compiling SQLite..."
+    gcc -O2 -w $SQLITE_FLAGS -c sqlite3.c -o sqlite3.o || { echo "Compilation failed!"; read -p "Press enter to continue..."; exit 1; }
+fi
 echo "Compiling Finance Analysis Tool..."
-g++ -std=c++17 -o app main.cpp ../sqlite3.c -I..
+g++ $CXXFLAGS -o app main.cpp sqlite3.o
 if [ $? -eq 0 ]; then
     echo "Compilation successful!"
+    echo "Compiling SEC ingestion tool..."
+    g++ $CXXFLAGS -o ingest ingest.cpp sqlite3.o -lcurl || echo "ingest not built (requires libcurl)"
+    echo "Compiling benchmarks..."
+    g++ $CXXFLAGS -o bench bench.cpp sqlite3.o -lbenchmark || echo "bench not built (requires Google Benchmark)"
     echo "Running application..."
     ./app
 else
     echo "Compilation failed!"
     read -p "Press enter to continue..."
-fi
\ No newline at end of file
+fi
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "Database.h"
+#include <algorithm>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Read-only connections to one database file for worker threads. Each
+// connection is opened with SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, so it
+// must only be used by the thread holding its lease; SQLite's own locking
+// then lets all of them read at once (concurrently with a writer when the
+// database is in WAL mode, which prepareForAnalysis sets up). Connections are
+// opened on first demand, up to capacity, and kept with their statement
+// caches for the next lease.
+class ConnectionPool {
+private:
+    std::string path;
+    size_t capacity;
+    size_t opened = 0;
+    std::vector<std::unique_ptr<Database>> idle;
+    std::mutex mutex;
+    std::condition_variable released;
+
+    void release(std::unique_ptr<Database> connection) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            idle.push_back(std::move(connection));
+        }
+        released.notify_one();
+    }
+
+public:
+    // One connection for as long as the lease lives
+    class Lease {
+    private:
+        ConnectionPool* pool;
+        std::unique_ptr<Database> connection;
+
+    public:
+        Lease(ConnectionPool& owner, std::unique_ptr<Database> database)
+            : pool(&owner), connection(std::move(database)) {}
+
+        Lease(Lease&&) = default;
+        Lease& operator=(Lease&&) = delete;
+
+        ~Lease() {
+            if (connection) pool->release(std::move(connection));
+        }
+
+        Database& operator*() const { return *connection; }
+        Database* operator->() const { return connection.get(); }
+    };
+
+    ConnectionPool(std::string databasePath, size_t maxConnections)
+        : path(std::move(databasePath)), capacity(std::max<size_t>(maxConnections, 1)) {}
+
+    ConnectionPool(const ConnectionPool&) = delete;
+    ConnectionPool& operator=(const ConnectionPool&) = delete;
+
+    // Blocks while every connection is leased out; throws when a new one cannot be opened
+    Lease acquire() {
+        std::unique_lock<std::mutex> lock(mutex);
+        released.wait(lock, [this] { return !idle.empty() || opened < capacity; });
+        if (!idle.empty()) {
+            std::unique_ptr<Database> connection = std::move(idle.back());
+            idle.pop_back();
+            return Lease(*this, std::move(connection));
+        }
+
+        opened++;
+        lock.unlock();
+        try {
+            return Lease(*this, std::make_unique<Database>(path, Database::Access::ReadOnly));
+        } catch (...) {
+            lock.lock();
+            opened--;
+            lock.unlock();
+            released.notify_one();
+            throw;
+        }
+    }
+
+    const std::string& databasePath() const { return path; }
+    size_t maxConnections() const { return capacity; }
+
+    size_t openConnections() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return opened;
+    }
+};
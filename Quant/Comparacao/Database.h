@@ -0,0 +1,922 @@
+#pragma once
+
+#include "Profiler.h"
+#include <sqlite3.h>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <memory_resource>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Typed, column-oriented query result. Numeric columns are read straight
+// from SQLite with sqlite3_column_double/int64 into contiguous vectors, so
+// callers never go through text and std::stod.
+struct ColumnarResult {
+    enum class Type { Integer, Real, Text };
+
+    struct Column {
+        std::string name;
+        Type type = Type::Real;
+        std::vector<int64_t> integers;
+        std::vector<double> reals;
+        std::vector<std::string> texts;
+        std::vector<uint64_t> nulls; // bit set => row is NULL (or non-numeric text in a numeric column)
+
+        bool isNull(size_t row) const {
+            return (nulls[row >> 6] >> (row & 63)) & 1u;
+        }
+
+        bool isNumeric() const { return type != Type::Text; }
+
+        // Numeric value of a row; NaN for NULL or text cells
+        double number(size_t row) const {
+            if (isNull(row)) return std::numeric_limits<double>::quiet_NaN();
+            switch (type) {
+                case Type::Integer: return static_cast<double>(integers[row]);
+                case Type::Real: return reals[row];
+                default: return std::numeric_limits<double>::quiet_NaN();
+            }
+        }
+
+        bool hasNumber(size_t row) const { return isNumeric() && !isNull(row); }
+    };
+
+    std::vector<Column> columns;
+    size_t rowCount = 0;
+
+    const Column* find(const std::string& name) const {
+        for (const auto& column : columns) {
+            if (column.name == name) return &column;
+        }
+        return nullptr;
+    }
+
+    const Column& at(const std::string& name) const {
+        const Column* column = find(name);
+        if (!column) {
+            throw std::out_of_range("No such column in result: " + name);
+        }
+        return *column;
+    }
+};
+
+// Text query result as views into the connection's query arena. Cells are
+// row-major, NULL reads as "N/A" like executeQuery. Everything stays valid
+// until the next executeRows call on the same Database.
+struct RowSet {
+    std::vector<std::string_view> columns;
+    std::vector<std::string_view> cells;
+    size_t rowCount = 0;
+    
+    // Position of a column, or -1
+    int columnIndex(std::string_view name) const {
+        for (size_t i = 0; i < columns.size(); ++i) {
+            if (columns[i] == name) return static_cast<int>(i);
+        }
+        return -1;
+    }
+    
+    std::string_view at(size_t row, size_t column) const {
+        return cells[row * columns.size() + column];
+    }
+};
+
+// Scratch memory for one query at a time: a monotonic resource over a block
+// that is kept between queries, so steady-state reads allocate nothing. When
+// a result outgrows the block the excess comes from the heap and the block is
+// grown by that much on the next reset().
+class QueryArena {
+private:
+    // Heap fallback that records how much the block was short by
+    class Overflow : public std::pmr::memory_resource {
+    public:
+        size_t bytes = 0;
+        
+    private:
+        void* do_allocate(size_t size, size_t alignment) override {
+            bytes += size;
+            return std::pmr::new_delete_resource()->allocate(size, alignment);
+        }
+        void do_deallocate(void* p, size_t size, size_t alignment) override {
+            std::pmr::new_delete_resource()->deallocate(p, size, alignment);
+        }
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+            return this == &other;
+        }
+    };
+    
+    std::vector<std::byte> block;
+    Overflow overflow;
+    std::optional<std::pmr::monotonic_buffer_resource> resource;
+    
+public:
+    explicit QueryArena(size_t initialBytes = 64 * 1024) : block(initialBytes) {}
+    
+    QueryArena(const QueryArena&) = delete;
+    QueryArena& operator=(const QueryArena&) = delete;
+    
+    // Drops everything handed out since the last reset
+    std::pmr::memory_resource& reset() {
+        resource.reset();
+        if (overflow.bytes > 0) {
+            block.resize(block.size() + overflow.bytes);
+            overflow.bytes = 0;
+        }
+        resource.emplace(block.data(), block.size(), &overflow);
+        return *resource;
+    }
+    
+    size_t capacity() const {
+        return block.size();
+    }
+};
+
+// Value bound to a '?' placeholder of a cached statement
+struct SqlParam {
+    enum class Kind { Null, Integer, Real, Text };
+    
+    Kind kind;
+    int64_t integer = 0;
+    double real = 0.0;
+    std::string text;
+    
+    SqlParam(std::nullptr_t) : kind(Kind::Null) {}
+    SqlParam(int value) : kind(Kind::Integer), integer(value) {}
+    SqlParam(int64_t value) : kind(Kind::Integer), integer(value) {}
+    SqlParam(double value) : kind(Kind::Real), real(value) {}
+    SqlParam(std::string value) : kind(Kind::Text), text(std::move(value)) {}
+    SqlParam(const char* value) : kind(Kind::Text), text(value) {}
+};
+
+class Database {
+private:
+    sqlite3* db;
+    // Prepared statements keyed by their SQL template; reused with sqlite3_reset
+    std::unordered_map<std::string, sqlite3_stmt*> statementCache;
+    // Backing store of the RowSet handed out by executeRows
+    QueryArena queryArena;
+    RowSet rowSet;
+    
+    // Resets and unbinds a cached statement when the caller is done with it
+    struct StatementLease {
+        sqlite3_stmt* stmt;
+        ~StatementLease() {
+            sqlite3_reset(stmt);
+            sqlite3_clear_bindings(stmt);
+        }
+    };
+    
+    static ColumnarResult::Type typeFromDeclaration(std::string declType) {
+        std::transform(declType.begin(), declType.end(), declType.begin(), ::toupper);
+        if (declType.find("INT") != std::string::npos) return ColumnarResult::Type::Integer;
+        if (declType.find("CHAR") != std::string::npos || declType.find("CLOB") != std::string::npos ||
+            declType.find("TEXT") != std::string::npos || declType.find("BLOB") != std::string::npos) {
+            return ColumnarResult::Type::Text;
+        }
+        return ColumnarResult::Type::Real; // REAL, FLOAT, DOUBLE and NUMERIC affinity
+    }
+    
+    static void appendDefaults(ColumnarResult::Column& column, size_t count) {
+        switch (column.type) {
+            case ColumnarResult::Type::Integer: column.integers.resize(column.integers.size() + count); break;
+            case ColumnarResult::Type::Real: column.reals.resize(column.reals.size() + count); break;
+            case ColumnarResult::Type::Text: column.texts.resize(column.texts.size() + count); break;
+        }
+    }
+    
+    sqlite3_stmt* prepare(const std::string& query) {
+        Profiler::Scope profile("sql.prepare");
+        sqlite3_stmt* stmt;
+        if (sqlite3_prepare_v2(db, query.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+            throw std::runtime_error("Failed to prepare statement: " + std::string(sqlite3_errmsg(db)));
+        }
+        return stmt;
+    }
+    
+    sqlite3_stmt* prepareCached(const std::string& query) {
+        auto it = statementCache.find(query);
+        if (it != statementCache.end()) {
+            return it->second;
+        }
+        
+        Profiler::Scope profile("sql.prepare");
+        sqlite3_stmt* stmt;
+        if (sqlite3_prepare_v3(db, query.c_str(), -1, SQLITE_PREPARE_PERSISTENT, &stmt, nullptr) != SQLITE_OK) {
+            throw std::runtime_error("Failed to prepare statement: " + std::string(sqlite3_errmsg(db)));
+        }
+        statementCache.emplace(query, stmt);
+        return stmt;
+    }
+    
+    void bindParameters(sqlite3_stmt* stmt, const std::vector<SqlParam>& params) {
+        if (static_cast<int>(params.size()) != sqlite3_bind_parameter_count(stmt)) {
+            throw std::runtime_error("Expected " + std::to_string(sqlite3_bind_parameter_count(stmt)) +
+                                     " query parameters, got " + std::to_string(params.size()));
+        }
+        
+        for (size_t i = 0; i < params.size(); i++) {
+            int index = static_cast<int>(i) + 1;
+            const SqlParam& param = params[i];
+            int rc = SQLITE_OK;
+            switch (param.kind) {
+                case SqlParam::Kind::Null: rc = sqlite3_bind_null(stmt, index); break;
+                case SqlParam::Kind::Integer: rc = sqlite3_bind_int64(stmt, index, param.integer); break;
+                case SqlParam::Kind::Real: rc = sqlite3_bind_double(stmt, index, param.real); break;
+                case SqlParam::Kind::Text:
+                    // The lease clears bindings before params goes out of scope
+                    rc = sqlite3_bind_text(stmt, index, param.text.c_str(),
+                                           static_cast<int>(param.text.size()), SQLITE_STATIC);
+                    break;
+            }
+            if (rc != SQLITE_OK) {
+                throw std::runtime_error("Failed to bind parameter: " + std::string(sqlite3_errmsg(db)));
+            }
+        }
+    }
+    
+    std::vector<std::map<std::string, std::string>> collectRows(sqlite3_stmt* stmt) {
+        Profiler::Scope profile("sql.step");
+        std::vector<std::map<std::string, std::string>> results;
+        int columnCount = sqlite3_column_count(stmt);
+        uint64_t converted = 0;
+        std::vector<std::string> columnNames;
+        for (int i = 0; i < columnCount; i++) {
+            columnNames.emplace_back(sqlite3_column_name(stmt, i));
+        }
+        
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            std::map<std::string, std::string> row;
+            for (int i = 0; i < columnCount; i++) {
+                const unsigned char* value = sqlite3_column_text(stmt, i);
+                std::string& cell = row[columnNames[i]];
+                cell = value ? std::string(reinterpret_cast<const char*>(value)) : "N/A";
+                converted += cell.size();
+            }
+            results.push_back(std::move(row));
+        }
+        
+        Profiler::add(Profiler::Counter::RowsRead, results.size());
+        Profiler::add(Profiler::Counter::BytesConverted, converted);
+        return results;
+    }
+    
+    // Copies the result's text into the rewound arena; rowSet keeps the
+    // capacity of its vectors, so repeated queries reuse all of their memory
+    const RowSet& collectRowSet(sqlite3_stmt* stmt) {
+        Profiler::Scope profile("sql.step");
+        std::pmr::memory_resource& arena = queryArena.reset();
+        auto store = [&arena](const void* text, size_t size) {
+            if (size == 0) return std::string_view();
+            char* copy = static_cast<char*>(arena.allocate(size, 1));
+            std::memcpy(copy, text, size);
+            return std::string_view(copy, size);
+        };
+        
+        rowSet.columns.clear();
+        rowSet.cells.clear();
+        rowSet.rowCount = 0;
+        int columnCount = sqlite3_column_count(stmt);
+        for (int i = 0; i < columnCount; i++) {
+            const char* name = sqlite3_column_name(stmt, i);
+            rowSet.columns.push_back(store(name, std::strlen(name)));
+        }
+        
+        int rc;
+        uint64_t converted = 0;
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+            for (int i = 0; i < columnCount; i++) {
+                const unsigned char* value = sqlite3_column_text(stmt, i);
+                if (!value) {
+                    rowSet.cells.push_back("N/A");
+                    continue;
+                }
+                size_t size = static_cast<size_t>(sqlite3_column_bytes(stmt, i));
+                rowSet.cells.push_back(store(value, size));
+                converted += size;
+            }
+            rowSet.rowCount++;
+        }
+        
+        if (rc != SQLITE_DONE) {
+            throw std::runtime_error("Failed to execute statement: " + std::string(sqlite3_errmsg(db)));
+        }
+        
+        Profiler::add(Profiler::Counter::RowsRead, rowSet.rowCount);
+        Profiler::add(Profiler::Counter::BytesConverted, converted);
+        return rowSet;
+    }
+    
+    // Collects the result column by column. Column types come from the declared
+    // type (SQLite affinity rules) or, for expressions, from the first non-NULL value.
+    // An Integer column that meets a REAL value (INTEGER affinity keeps 1500.75 as
+    // REAL) becomes Real, so no value is truncated.
+    ColumnarResult collectColumnar(sqlite3_stmt* stmt) {
+        Profiler::Scope profile("sql.step");
+        ColumnarResult result;
+        uint64_t converted = 0;
+        int columnCount = sqlite3_column_count(stmt);
+        result.columns.resize(columnCount);
+        std::vector<bool> typed(columnCount, false);
+        
+        for (int i = 0; i < columnCount; i++) {
+            result.columns[i].name = sqlite3_column_name(stmt, i);
+            const char* declType = sqlite3_column_decltype(stmt, i);
+            if (declType && *declType) {
+                result.columns[i].type = typeFromDeclaration(declType);
+                typed[i] = true;
+            }
+        }
+        
+        int rc;
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+            size_t row = result.rowCount++;
+            
+            for (int i = 0; i < columnCount; i++) {
+                auto& column = result.columns[i];
+                int valueType = sqlite3_column_type(stmt, i);
+                
+                if (!typed[i] && valueType != SQLITE_NULL) {
+                    // Every earlier row was NULL, so only the sizes need fixing up
+                    column.type = valueType == SQLITE_INTEGER ? ColumnarResult::Type::Integer :
+                                  valueType == SQLITE_FLOAT ? ColumnarResult::Type::Real :
+                                  ColumnarResult::Type::Text;
+                    column.integers.clear();
+                    column.reals.clear();
+                    column.texts.clear();
+                    appendDefaults(column, row);
+                    typed[i] = true;
+                }
+                
+                if ((row & 63) == 0) column.nulls.push_back(0);
+                
+                bool isNull = valueType == SQLITE_NULL ||
+                              (column.type != ColumnarResult::Type::Text &&
+                               (valueType == SQLITE_TEXT || valueType == SQLITE_BLOB));
+                if (isNull) {
+                    column.nulls.back() |= uint64_t(1) << (row & 63);
+                    appendDefaults(column, 1);
+                    continue;
+                }
+                
+                if (column.type == ColumnarResult::Type::Integer && valueType == SQLITE_FLOAT) {
+                    column.reals.assign(column.integers.begin(), column.integers.end());
+                    std::vector<int64_t>().swap(column.integers);
+                    column.type = ColumnarResult::Type::Real;
+                }
+                
+                switch (column.type) {
+                    case ColumnarResult::Type::Integer:
+                        column.integers.push_back(sqlite3_column_int64(stmt, i));
+                        break;
+                    case ColumnarResult::Type::Real:
+                        column.reals.push_back(sqlite3_column_double(stmt, i));
+                        break;
+                    case ColumnarResult::Type::Text: {
+                        const unsigned char* text = sqlite3_column_text(stmt, i);
+                        column.texts.emplace_back(reinterpret_cast<const char*>(text),
+                                                  sqlite3_column_bytes(stmt, i));
+                        converted += column.texts.back().size();
+                        break;
+                    }
+                }
+            }
+        }
+        
+        if (rc != SQLITE_DONE) {
+            throw std::runtime_error("Failed to execute statement: " + std::string(sqlite3_errmsg(db)));
+        }
+        
+        Profiler::add(Profiler::Counter::RowsRead, result.rowCount);
+        Profiler::add(Profiler::Counter::BytesConverted, converted);
+        return result;
+    }
+    
+public:
+    // ReadOnly connections skip SQLite's per-connection mutex (SQLITE_OPEN_NOMUTEX):
+    // they are meant for one worker thread at a time, see ConnectionPool
+    enum class Access { ReadWrite, ReadOnly };
+    
+    explicit Database(const std::string& db_path, Access access = Access::ReadWrite) : db(nullptr) {
+        int flags = access == Access::ReadOnly ? SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX
+                                               : SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE;
+        if (sqlite3_open_v2(db_path.c_str(), &db, flags, nullptr) != SQLITE_OK) {
+            std::string message = db ? sqlite3_errmsg(db) : "out of memory";
+            sqlite3_close(db);
+            db = nullptr;
+            throw std::runtime_error("Cannot open database: " + message);
+        }
+        // A misspelled quoted column must be an error, not a string literal
+        sqlite3_db_config(db, SQLITE_DBCONFIG_DQS_DML, 0, nullptr);
+        // Per-connection storage settings: memory-mapped reads (256 MB), a 64 MB
+        // page cache and in-memory temporary tables for sorts
+        execute("PRAGMA mmap_size = 268435456; PRAGMA cache_size = -65536; PRAGMA temp_store = MEMORY;");
+    }
+    
+    ~Database() {
+        clearStatementCache();
+        if (db) {
+            sqlite3_close(db);
+        }
+    }
+    
+    Database(const Database&) = delete;
+    Database& operator=(const Database&) = delete;
+    
+    // Quotes a table or column name for splicing into SQL; identifiers cannot be bound
+    static std::string quoteIdentifier(const std::string& name) {
+        std::string quoted = "\"";
+        for (char c : name) {
+            if (c == '"') quoted += '"';
+            quoted += c;
+        }
+        quoted += '"';
+        return quoted;
+    }
+    
+    std::vector<std::map<std::string, std::string>> executeQuery(const std::string& query) {
+        sqlite3_stmt* stmt = prepare(query);
+        try {
+            auto results = collectRows(stmt);
+            sqlite3_finalize(stmt);
+            return results;
+        } catch (...) {
+            sqlite3_finalize(stmt);
+            throw;
+        }
+    }
+    
+    // Cached-statement variant: values go through sqlite3_bind_* and the
+    // statement is kept prepared for the next call with the same SQL.
+    std::vector<std::map<std::string, std::string>> executeQuery(const std::string& query,
+                                                                 const std::vector<SqlParam>& params) {
+        StatementLease lease{prepareCached(query)};
+        bindParameters(lease.stmt, params);
+        return collectRows(lease.stmt);
+    }
+    
+    // Allocation-free variant of executeQuery for short-lived reads: the cells
+    // are views into the query arena, good until the next executeRows call
+    const RowSet& executeRows(const std::string& query) {
+        sqlite3_stmt* stmt = prepare(query);
+        try {
+            const RowSet& result = collectRowSet(stmt);
+            sqlite3_finalize(stmt);
+            return result;
+        } catch (...) {
+            sqlite3_finalize(stmt);
+            throw;
+        }
+    }
+    
+    const RowSet& executeRows(const std::string& query, const std::vector<SqlParam>& params) {
+        StatementLease lease{prepareCached(query)};
+        bindParameters(lease.stmt, params);
+        return collectRowSet(lease.stmt);
+    }
+    
+    ColumnarResult executeColumnar(const std::string& query) {
+        sqlite3_stmt* stmt = prepare(query);
+        try {
+            auto result = collectColumnar(stmt);
+            sqlite3_finalize(stmt);
+            return result;
+        } catch (...) {
+            sqlite3_finalize(stmt);
+            throw;
+        }
+    }
+    
+    ColumnarResult executeColumnar(const std::string& query, const std::vector<SqlParam>& params) {
+        StatementLease lease{prepareCached(query)};
+        bindParameters(lease.stmt, params);
+        return collectColumnar(lease.stmt);
+    }
+    
+    // Streams the rows of a cached query to onRow without materializing them
+    void forEachRow(const std::string& query, const std::vector<SqlParam>& params,
+                    const std::function<void(sqlite3_stmt*)>& onRow) {
+        StatementLease lease{prepareCached(query)};
+        bindParameters(lease.stmt, params);
+        Profiler::Scope profile("sql.step");
+        int rc;
+        uint64_t rows = 0;
+        while ((rc = sqlite3_step(lease.stmt)) == SQLITE_ROW) {
+            onRow(lease.stmt);
+            rows++;
+        }
+        Profiler::add(Profiler::Counter::RowsRead, rows);
+        if (rc != SQLITE_DONE) {
+            throw std::runtime_error("Failed to read results: " + std::string(sqlite3_errmsg(db)));
+        }
+    }
+    
+    // Runs one or more statements that return no rows
+    void execute(const std::string& sql) {
+        char* error = nullptr;
+        if (sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &error) != SQLITE_OK) {
+            std::string message = error ? error : sqlite3_errmsg(db);
+            sqlite3_free(error);
+            throw std::runtime_error("Failed to execute statement: " + message);
+        }
+    }
+    
+    // Cached INSERT/UPDATE/DELETE; returns the number of rows changed
+    int executeUpdate(const std::string& query, const std::vector<SqlParam>& params) {
+        StatementLease lease{prepareCached(query)};
+        bindParameters(lease.stmt, params);
+        Profiler::Scope profile("sql.update");
+        int rc = sqlite3_step(lease.stmt);
+        if (rc != SQLITE_DONE && rc != SQLITE_ROW) {
+            throw std::runtime_error("Failed to execute statement: " + std::string(sqlite3_errmsg(db)));
+        }
+        return sqlite3_changes(db);
+    }
+    
+    // BEGIN on construction, ROLLBACK on destruction unless commit() was called
+    class Transaction {
+    private:
+        Database& database;
+        bool finished = false;
+        
+    public:
+        explicit Transaction(Database& db) : database(db) {
+            database.execute("BEGIN IMMEDIATE;");
+        }
+        
+        ~Transaction() {
+            if (!finished) {
+                sqlite3_exec(database.db, "ROLLBACK;", nullptr, nullptr, nullptr);
+            }
+        }
+        
+        void commit() {
+            database.execute("COMMIT;");
+            finished = true;
+        }
+    };
+    
+    // Finalizes every cached statement (e.g. before the schema changes underneath them)
+    void clearStatementCache() {
+        for (auto& [query, stmt] : statementCache) {
+            sqlite3_finalize(stmt);
+        }
+        statementCache.clear();
+    }
+    
+    size_t cachedStatementCount() const {
+        return statementCache.size();
+    }
+
+    // Path of the main database file; empty for in-memory databases
+    std::string fileName() const {
+        const char* name = sqlite3_db_filename(db, "main");
+        return name ? name : "";
+    }
+
+    // PRAGMA data_version: moves whenever another connection commits
+    int64_t dataVersion() {
+        auto result = executeColumnar("PRAGMA data_version;", {});
+        if (result.rowCount == 0 || !result.columns[0].hasNumber(0)) return -1;
+        return static_cast<int64_t>(result.columns[0].number(0));
+    }
+
+    std::vector<std::string> getTableNames() {
+        std::vector<std::string> tables;
+        try {
+            const RowSet& results = executeRows("SELECT name FROM sqlite_master WHERE type='table';", {});
+            for (size_t row = 0; row < results.rowCount; ++row) {
+                tables.emplace_back(results.at(row, 0));
+            }
+        } catch (const std::exception& e) {
+            std::cout << "Error getting table names: " << e.what() << "\n";
+        }
+        return tables;
+    }
+
+    std::vector<std::string> getColumnNames(const std::string& tableName) {
+        std::vector<std::string> columns;
+        try {
+            const RowSet& results = executeRows("SELECT name FROM pragma_table_info(?) ORDER BY cid;", {tableName});
+            for (size_t row = 0; row < results.rowCount; ++row) {
+                columns.emplace_back(results.at(row, 0));
+            }
+        } catch (const std::exception& e) {
+            std::cout << "Error getting column names for " << tableName << ": " << e.what() << "\n";
+        }
+        return columns;
+    }
+
+    // Prints columns and two sample rows of every table (or only `onlyTable`)
+    void inspectDatabase(const std::string& onlyTable = "") {
+        std::cout << "\n=== DATABASE INSPECTION ===\n";
+        auto tables = getTableNames();
+        
+        if (!onlyTable.empty()) {
+            if (std::find(tables.begin(), tables.end(), onlyTable) == tables.end()) {
+                std::cout << "Table '" << onlyTable << "' does not exist!\n";
+                return;
+            }
+            tables = {onlyTable};
+        }
+        
+        if (tables.empty()) {
+            std::cout << "No tables found in the database!\n";
+            return;
+        }
+        
+        std::cout << "Found " << tables.size() << " tables:\n";
+        
+        for (const auto& table : tables) {
+            std::cout << "\nTable: " << table << "\n";
+            auto columns = getColumnNames(table);
+            std::cout << "Columns (" << columns.size() << "): ";
+            for (size_t i = 0; i < columns.size(); ++i) {
+                std::cout << columns[i];
+                if (i < columns.size() - 1) std::cout << ", ";
+            }
+            std::cout << "\n";
+            
+            // Show sample data
+            try {
+                std::string sampleQuery = "SELECT * FROM " + quoteIdentifier(table) + " LIMIT 2;";
+                const RowSet& sampleResults = executeRows(sampleQuery);
+                if (sampleResults.rowCount > 0) {
+                    // Columns by name, as the sample has always been listed
+                    std::vector<size_t> order(sampleResults.columns.size());
+                    for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+                    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+                        return sampleResults.columns[a] < sampleResults.columns[b];
+                    });
+                    std::cout << "Sample data:\n";
+                    for (size_t row = 0; row < sampleResults.rowCount; ++row) {
+                        for (size_t column : order) {
+                            std::string_view value = sampleResults.at(row, column);
+                            std::cout << "  " << sampleResults.columns[column] << ": " << value.substr(0, 50)
+                                      << (value.length() > 50 ? "..." : "") << "\n";
+                        }
+                        std::cout << "  ---\n";
+                    }
+                } else {
+                    std::cout << "  Table is empty\n";
+                }
+            } catch (const std::exception& e) {
+                std::cout << "  Could not sample data: " << e.what() << "\n";
+            }
+        }
+    }
+    
+    bool tableExists(const std::string& tableName) {
+        auto tables = getTableNames();
+        return std::find(tables.begin(), tables.end(), tableName) != tables.end();
+    }
+    
+    // True when some index of the table starts with exactly these columns, in order
+    bool hasIndexOn(const std::string& table, const std::vector<std::string>& columns) {
+        auto result = executeColumnar(
+            "SELECT il.name AS index_name, ii.seqno AS seqno, ii.name AS column_name "
+            "FROM pragma_index_list(?) il, pragma_index_info(il.name) ii "
+            "ORDER BY il.name, ii.seqno;", {table});
+        const auto& indexNames = result.at("index_name");
+        const auto& seqnos = result.at("seqno");
+        const auto& columnNames = result.at("column_name");
+        
+        std::map<std::string, std::vector<std::string>> indexColumns;
+        for (size_t i = 0; i < result.rowCount; ++i) {
+            if (indexNames.isNull(i) || columnNames.isNull(i) || !seqnos.hasNumber(i)) continue;
+            indexColumns[indexNames.texts[i]].push_back(columnNames.texts[i]);
+        }
+        for (const auto& [name, indexed] : indexColumns) {
+            if (indexed.size() >= columns.size() && std::equal(columns.begin(), columns.end(), indexed.begin())) {
+                return true;
+            }
+        }
+        return false;
+    }
+    
+    // "Prepare database" step: WAL journal, the given indexes where no index with
+    // the same leading columns exists, and planner statistics (ANALYZE) when
+    // something was created or the table was never analyzed. Returns the names
+    // of the indexes it created.
+    std::vector<std::string> prepareForAnalysis(const std::string& table,
+                                                const std::vector<std::vector<std::string>>& indexes) {
+        execute("PRAGMA journal_mode = WAL;");
+        
+        std::vector<std::string> created;
+        for (const auto& columns : indexes) {
+            if (columns.empty() || hasIndexOn(table, columns)) continue;
+            std::string name = "idx_" + table;
+            std::string columnList;
+            for (const auto& column : columns) {
+                name += "_" + column;
+                columnList += (columnList.empty() ? "" : ", ") + quoteIdentifier(column);
+            }
+            execute("CREATE INDEX IF NOT EXISTS " + quoteIdentifier(name) + " ON " + quoteIdentifier(table) +
+                    " (" + columnList + ");");
+            created.push_back(name);
+        }
+        
+        bool analyzed = false;
+        auto statTable = executeColumnar("SELECT name FROM sqlite_master WHERE type = 'table' AND name = 'sqlite_stat1';", {});
+        if (statTable.rowCount > 0) {
+            analyzed = executeColumnar("SELECT 1 FROM sqlite_stat1 WHERE tbl = ? LIMIT 1;", {table}).rowCount > 0;
+        }
+        if (!created.empty() || !analyzed) {
+            execute("ANALYZE " + quoteIdentifier(table) + ";");
+        }
+        return created;
+    }
+    
+    // EXPLAIN QUERY PLAN output as indented lines; '?' placeholders may stay unbound
+    std::vector<std::string> explainQueryPlan(const std::string& query) {
+        sqlite3_stmt* stmt = prepare("EXPLAIN QUERY PLAN " + query);
+        std::vector<std::string> lines;
+        std::map<int, int> depth;
+        int rc;
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+            int id = sqlite3_column_int(stmt, 0);
+            int parent = sqlite3_column_int(stmt, 1);
+            const unsigned char* detail = sqlite3_column_text(stmt, 3);
+            int level = depth.count(parent) ? depth[parent] + 1 : 0;
+            depth[id] = level;
+            lines.push_back(std::string(static_cast<size_t>(level) * 2, ' ') +
+                            (detail ? reinterpret_cast<const char*>(detail) : ""));
+        }
+        sqlite3_finalize(stmt);
+        if (rc != SQLITE_DONE) {
+            throw std::runtime_error("Failed to explain query: " + std::string(sqlite3_errmsg(db)));
+        }
+        return lines;
+    }
+};
+
+// Column metadata for one table, as reported by PRAGMA table_info
+struct TableSchema {
+    struct ColumnInfo {
+        std::string name;
+        std::string declaredType;
+        int index = 0;
+        bool numeric = false; // INTEGER/REAL/NUMERIC-like declared type (not dates/timestamps)
+        bool key = false;     // part of the primary key or of a UNIQUE index
+    };
+    
+    std::string name;
+    std::vector<ColumnInfo> columns;
+    std::unordered_map<std::string, size_t> columnIndex;
+    
+    const ColumnInfo* find(const std::string& columnName) const {
+        auto it = columnIndex.find(columnName);
+        return it == columnIndex.end() ? nullptr : &columns[it->second];
+    }
+    
+    bool hasColumn(const std::string& columnName) const {
+        return columnIndex.count(columnName) > 0;
+    }
+    
+    std::vector<std::string> columnNames() const {
+        std::vector<std::string> names;
+        names.reserve(columns.size());
+        for (const auto& column : columns) names.push_back(column.name);
+        return names;
+    }
+    
+    // Numeric, non-key columns in declaration order
+    std::vector<std::string> numericColumns() const {
+        std::vector<std::string> names;
+        for (const auto& column : columns) {
+            if (column.numeric && !column.key) names.push_back(column.name);
+        }
+        return names;
+    }
+    
+    static bool isNumericDeclaration(std::string declType) {
+        std::transform(declType.begin(), declType.end(), declType.begin(), ::toupper);
+        for (const char* token : {"INT", "REAL", "FLOA", "DOUB", "NUM", "DEC", "BOOL"}) {
+            if (declType.find(token) != std::string::npos) return true;
+        }
+        return false;
+    }
+};
+
+// Schema metadata loaded once from sqlite_master and the table_info/index pragmas.
+// Lookups only read the loaded copy; call refreshIfChanged() once per command to
+// pick up schema changes (it costs one PRAGMA schema_version query), or refresh()
+// right after changing the schema.
+class SchemaCatalog {
+private:
+    Database& db;
+    int64_t schemaVersion = -1;
+    std::vector<std::string> tableNames;
+    std::unordered_map<std::string, TableSchema> tables;
+    
+    int64_t currentSchemaVersion() {
+        auto result = db.executeColumnar("PRAGMA schema_version;", {});
+        if (result.rowCount == 0 || !result.columns[0].hasNumber(0)) return -1;
+        return static_cast<int64_t>(result.columns[0].number(0));
+    }
+    
+public:
+    explicit SchemaCatalog(Database& database) : db(database) {
+        refresh();
+    }
+    
+    void refresh() {
+        tableNames.clear();
+        tables.clear();
+        
+        try {
+            schemaVersion = currentSchemaVersion();
+            
+            auto names = db.executeColumnar("SELECT name FROM sqlite_master WHERE type='table';", {});
+            const auto& nameColumn = names.at("name");
+            for (size_t i = 0; i < names.rowCount; ++i) {
+                tableNames.push_back(nameColumn.texts[i]);
+                tables[nameColumn.texts[i]].name = nameColumn.texts[i];
+            }
+            
+            auto info = db.executeColumnar(
+                "SELECT m.name AS table_name, p.cid AS cid, p.name AS column_name, p.type AS column_type, p.pk AS pk "
+                "FROM sqlite_master m, pragma_table_info(m.name) p "
+                "WHERE m.type='table' ORDER BY m.name, p.cid;", {});
+            const auto& tableColumn = info.at("table_name");
+            const auto& cidColumn = info.at("cid");
+            const auto& columnName = info.at("column_name");
+            const auto& typeColumn = info.at("column_type");
+            const auto& pkColumn = info.at("pk");
+            
+            for (size_t i = 0; i < info.rowCount; ++i) {
+                TableSchema& table = tables[tableColumn.texts[i]];
+                TableSchema::ColumnInfo column;
+                column.name = columnName.texts[i];
+                column.declaredType = typeColumn.isNull(i) ? "" : typeColumn.texts[i];
+                column.index = static_cast<int>(cidColumn.number(i));
+                column.numeric = TableSchema::isNumericDeclaration(column.declaredType);
+                column.key = pkColumn.hasNumber(i) && pkColumn.number(i) > 0;
+                table.columnIndex[column.name] = table.columns.size();
+                table.columns.push_back(std::move(column));
+            }
+            
+            auto keys = db.executeColumnar(
+                "SELECT m.name AS table_name, ii.name AS column_name "
+                "FROM sqlite_master m, pragma_index_list(m.name) il, pragma_index_info(il.name) ii "
+                "WHERE m.type='table' AND il.\"unique\" = 1;", {});
+            const auto& keyTable = keys.at("table_name");
+            const auto& keyColumn = keys.at("column_name");
+            for (size_t i = 0; i < keys.rowCount; ++i) {
+                if (keyColumn.isNull(i)) continue; // expression index
+                auto it = tables.find(keyTable.texts[i]);
+                if (it == tables.end()) continue;
+                auto index = it->second.columnIndex.find(keyColumn.texts[i]);
+                if (index != it->second.columnIndex.end()) {
+                    it->second.columns[index->second].key = true;
+                }
+            }
+        } catch (const std::exception& e) {
+            std::cout << "Error loading schema catalog: " << e.what() << "\n";
+        }
+    }
+    
+    // Reloads when another statement or connection changed the schema
+    bool refreshIfChanged() {
+        try {
+            if (currentSchemaVersion() == schemaVersion) return false;
+        } catch (const std::exception&) {
+            return false;
+        }
+        refresh();
+        return true;
+    }
+    
+    const std::vector<std::string>& getTableNames() const {
+        return tableNames;
+    }
+    
+    bool tableExists(const std::string& tableName) const {
+        return tables.count(tableName) > 0;
+    }
+    
+    // Valid until the next refresh
+    const TableSchema* getTable(const std::string& tableName) const {
+        auto it = tables.find(tableName);
+        return it == tables.end() ? nullptr : &it->second;
+    }
+    
+    std::vector<std::string> getColumnNames(const std::string& tableName) const {
+        const TableSchema* table = getTable(tableName);
+        return table ? table->columnNames() : std::vector<std::string>{};
+    }
+    
+    int64_t version() const {
+        return schemaVersion;
+    }
+};
@@ -0,0 +1,235 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Event callbacks of JsonStreamParser. Scalars arrive as text: numbers keep
+// their literal spelling so the handler decides how (and whether) to convert.
+class JsonHandler {
+public:
+    enum class Scalar { String, Number, True, False, Null };
+
+    virtual ~JsonHandler() = default;
+    virtual void startObject() {}
+    virtual void endObject() {}
+    virtual void startArray() {}
+    virtual void endArray() {}
+    virtual void key(const std::string& name) { (void)name; }
+    virtual void value(Scalar type, const std::string& text) { (void)type; (void)text; }
+};
+
+// Incremental (push) JSON parser: feed() accepts the document in arbitrary
+// chunks, e.g. straight from a network callback, and reports SAX-style events
+// without ever building a tree. Memory use is bounded by the nesting depth and
+// the longest single token.
+class JsonStreamParser {
+private:
+    enum class Token { None, String, Escape, Unicode, Number, Literal };
+    enum class Expect { Value, KeyOrEnd, Key, Colon, CommaOrEnd, Done };
+
+    JsonHandler& handler;
+    std::vector<bool> containers; // true = object, false = array
+    Token token = Token::None;
+    Expect expect = Expect::Value;
+    bool afterOpen = false;       // right after '[' so ']' is allowed
+    std::string text;
+    uint32_t unicode = 0;
+    int unicodeDigits = 0;
+    uint32_t highSurrogate = 0;
+    size_t offset = 0;
+
+    [[noreturn]] void fail(const char* message) const {
+        throw std::runtime_error(std::string("JSON parse error at byte ") + std::to_string(offset) + ": " + message);
+    }
+
+    void appendUtf8(uint32_t codePoint) {
+        if (codePoint < 0x80) {
+            text += static_cast<char>(codePoint);
+        } else if (codePoint < 0x800) {
+            text += static_cast<char>(0xC0 | (codePoint >> 6));
+            text += static_cast<char>(0x80 | (codePoint & 0x3F));
+        } else if (codePoint < 0x10000) {
+            text += static_cast<char>(0xE0 | (codePoint >> 12));
+            text += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+            text += static_cast<char>(0x80 | (codePoint & 0x3F));
+        } else {
+            text += static_cast<char>(0xF0 | (codePoint >> 18));
+            text += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+            text += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+            text += static_cast<char>(0x80 | (codePoint & 0x3F));
+        }
+    }
+
+    // A complete value was produced at the current nesting level
+    void valueDone() {
+        afterOpen = false;
+        expect = containers.empty() ? Expect::Done : Expect::CommaOrEnd;
+    }
+
+    void emitScalar(JsonHandler::Scalar type) {
+        handler.value(type, text);
+        text.clear();
+        valueDone();
+    }
+
+    void finishLiteral() {
+        if (text == "true") emitScalar(JsonHandler::Scalar::True);
+        else if (text == "false") emitScalar(JsonHandler::Scalar::False);
+        else if (text == "null") emitScalar(JsonHandler::Scalar::Null);
+        else fail("invalid literal");
+    }
+
+    void closeContainer(bool object) {
+        if (containers.empty() || containers.back() != object) fail("mismatched bracket");
+        containers.pop_back();
+        if (object) handler.endObject(); else handler.endArray();
+        valueDone();
+    }
+
+    void structural(char c) {
+        switch (expect) {
+            case Expect::Done:
+                fail("trailing characters after document");
+            case Expect::Colon:
+                if (c != ':') fail("expected ':'");
+                expect = Expect::Value;
+                return;
+            case Expect::CommaOrEnd:
+                if (c == ',') {
+                    expect = containers.back() ? Expect::Key : Expect::Value;
+                } else if (c == '}' || c == ']') {
+                    closeContainer(c == '}');
+                } else {
+                    fail("expected ',' or closing bracket");
+                }
+                return;
+            case Expect::KeyOrEnd:
+            case Expect::Key:
+                if (c == '"') {
+                    token = Token::String;
+                } else if (c == '}' && expect == Expect::KeyOrEnd) {
+                    closeContainer(true);
+                } else {
+                    fail("expected object key");
+                }
+                return;
+            case Expect::Value:
+                break;
+        }
+
+        if (c == ']' && afterOpen) {
+            closeContainer(false);
+        } else if (c == '{') {
+            containers.push_back(true);
+            handler.startObject();
+            expect = Expect::KeyOrEnd;
+        } else if (c == '[') {
+            containers.push_back(false);
+            handler.startArray();
+            afterOpen = true;
+        } else if (c == '"') {
+            token = Token::String;
+        } else if (c == '-' || (c >= '0' && c <= '9')) {
+            token = Token::Number;
+            text += c;
+        } else if (c >= 'a' && c <= 'z') {
+            token = Token::Literal;
+            text += c;
+        } else {
+            fail("unexpected character");
+        }
+    }
+
+public:
+    explicit JsonStreamParser(JsonHandler& handler) : handler(handler) {}
+
+    void feed(const char* data, size_t size) {
+        for (size_t i = 0; i < size; ++i, ++offset) {
+            char c = data[i];
+            switch (token) {
+                case Token::String:
+                    if (c == '"') {
+                        token = Token::None;
+                        if (expect == Expect::Key || expect == Expect::KeyOrEnd) {
+                            handler.key(text);
+                            text.clear();
+                            expect = Expect::Colon;
+                        } else {
+                            emitScalar(JsonHandler::Scalar::String);
+                        }
+                    } else if (c == '\\') {
+                        token = Token::Escape;
+                    } else {
+                        text += c;
+                    }
+                    continue;
+                case Token::Escape:
+                    token = Token::String;
+                    switch (c) {
+                        case 'n': text += '\n'; break;
+                        case 't': text += '\t'; break;
+                        case 'r': text += '\r'; break;
+                        case 'b': text += '\b'; break;
+                        case 'f': text += '\f'; break;
+                        case 'u': token = Token::Unicode; unicode = 0; unicodeDigits = 0; break;
+                        default: text += c; break; // '"', '\\', '/'
+                    }
+                    continue;
+                case Token::Unicode: {
+                    int digit = (c >= '0' && c <= '9') ? c - '0'
+                              : (c >= 'a' && c <= 'f') ? c - 'a' + 10
+                              : (c >= 'A' && c <= 'F') ? c - 'A' + 10 : -1;
+                    if (digit < 0) fail("invalid \\u escape");
+                    unicode = (unicode << 4) | static_cast<uint32_t>(digit);
+                    if (++unicodeDigits < 4) continue;
+                    token = Token::String;
+                    if (unicode >= 0xD800 && unicode < 0xDC00) {
+                        highSurrogate = unicode;
+                    } else if (unicode >= 0xDC00 && unicode < 0xE000 && highSurrogate) {
+                        appendUtf8(0x10000 + ((highSurrogate - 0xD800) << 10) + (unicode - 0xDC00));
+                        highSurrogate = 0;
+                    } else {
+                        appendUtf8(unicode);
+                    }
+                    continue;
+                }
+                case Token::Number:
+                    if ((c >= '0' && c <= '9') || c == '.' || c == 'e' || c == 'E' || c == '+' || c == '-') {
+                        text += c;
+                        continue;
+                    }
+                    token = Token::None;
+                    emitScalar(JsonHandler::Scalar::Number);
+                    break; // c still has to be handled below
+                case Token::Literal:
+                    if (c >= 'a' && c <= 'z') {
+                        text += c;
+                        continue;
+                    }
+                    token = Token::None;
+                    finishLiteral();
+                    break;
+                case Token::None:
+                    break;
+            }
+
+            if (c == ' ' || c == '\n' || c == '\r' || c == '\t') continue;
+            structural(c);
+        }
+    }
+
+    // Call after the last chunk; throws if the document is incomplete
+    void finish() {
+        if (token == Token::Number) {
+            token = Token::None;
+            emitScalar(JsonHandler::Scalar::Number);
+        } else if (token == Token::Literal) {
+            token = Token::None;
+            finishLiteral();
+        }
+        if (token != Token::None || expect != Expect::Done) fail("unexpected end of document");
+    }
+};
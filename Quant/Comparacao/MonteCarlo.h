@@ -0,0 +1,1054 @@
+#pragma once
+
+#include "Bootstrap.h"
+#include "Profiler.h"
+#include "SimulationKernels.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Philox4x32-10 counter-based generator (Salmon et al., "Parallel random numbers:
+// as easy as 1, 2, 3"). Every (key, counter) pair maps to four independent 32-bit
+// words, so any path can draw its numbers without sharing generator state.
+struct Philox4x32 {
+    using Counter = std::array<uint32_t, 4>;
+    using Key = std::array<uint32_t, 2>;
+    
+    static Counter generate(Counter counter, Key key) {
+        constexpr uint32_t multiplier0 = 0xD2511F53u, multiplier1 = 0xCD9E8D57u;
+        constexpr uint32_t weyl0 = 0x9E3779B9u, weyl1 = 0xBB67AE85u;
+        
+        for (int round = 0; round < 10; ++round) {
+            uint64_t product0 = uint64_t(multiplier0) * counter[0];
+            uint64_t product1 = uint64_t(multiplier1) * counter[2];
+            counter = {
+                uint32_t(product1 >> 32) ^ counter[1] ^ key[0],
+                uint32_t(product1),
+                uint32_t(product0 >> 32) ^ counter[3] ^ key[1],
+                uint32_t(product0)
+            };
+            key[0] += weyl0;
+            key[1] += weyl1;
+        }
+        return counter;
+    }
+    
+    // Uniforms in (0, 1) for stream `stream` of generator `seed`, starting at draw
+    // index `offset` (a multiple of 4); out must hold count rounded up to 4.
+    static void uniforms(uint64_t seed, uint64_t stream, uint64_t offset, double* out, size_t count) {
+        size_t blocks = (count + 3) / 4;
+        Key key = {uint32_t(seed), uint32_t(seed >> 32)};
+        uint64_t firstBlock = offset / 4;
+        
+        for (size_t b = 0; b < blocks; ++b) {
+            uint64_t block = firstBlock + b;
+            Counter words = generate({uint32_t(block), uint32_t(block >> 32),
+                                      uint32_t(stream), uint32_t(stream >> 32)}, key);
+            for (int k = 0; k < 4; ++k) {
+                out[b * 4 + k] = (words[k] + 0.5) * (1.0 / 4294967296.0);
+            }
+        }
+    }
+    
+    // Standard normals from the same streams. Uniforms are produced first and then
+    // transformed with Box-Muller in one flat loop the compiler can vectorize.
+    static void normals(uint64_t seed, uint64_t stream, uint64_t offset, double* out, size_t count,
+                        std::vector<double>& scratch) {
+        size_t blocks = (count + 3) / 4;
+        scratch.resize(blocks * 4);
+        uniforms(seed, stream, offset, scratch.data(), count);
+        
+        constexpr double twoPi = 6.283185307179586;
+        size_t pairs = blocks * 2;
+        for (size_t p = 0; p < pairs; ++p) {
+            double radius = std::sqrt(-2.0 * std::log(scratch[2 * p]));
+            double angle = twoPi * scratch[2 * p + 1];
+            scratch[2 * p] = radius * std::cos(angle);
+            scratch[2 * p + 1] = radius * std::sin(angle);
+        }
+        
+        std::copy(scratch.begin(), scratch.begin() + count, out);
+    }
+};
+
+enum class VarianceReduction { None, Antithetic, ControlVariate, QuasiRandom };
+
+inline const char* varianceReductionName(VarianceReduction mode) {
+    switch (mode) {
+        case VarianceReduction::Antithetic: return "Antithetic variates";
+        case VarianceReduction::ControlVariate: return "Control variate";
+        case VarianceReduction::QuasiRandom: return "Quasi-random (Halton + Brownian bridge)";
+        default: return "None";
+    }
+}
+
+// Inverse of the standard normal CDF (Acklam's rational approximation, |rel. error| < 1.2e-9)
+inline double inverseNormalCdf(double p) {
+    static const double a[] = {-3.969683028665376e+01, 2.209460984245205e+02, -2.759285104469687e+02,
+                               1.383577518672690e+02, -3.066479806614716e+01, 2.506628277459239e+00};
+    static const double b[] = {-5.447609879822406e+01, 1.615858368580409e+02, -1.556989798598866e+02,
+                               6.680131188771972e+01, -1.328068155288572e+01};
+    static const double c[] = {-7.784894002430293e-03, -3.223964580411365e-01, -2.400758277161838e+00,
+                               -2.549732539343734e+00, 4.374664141464968e+00, 2.938163982698783e+00};
+    static const double d[] = {7.784695709041462e-03, 3.224671290700398e-01, 2.445134137142996e+00,
+                               3.754408661907416e+00};
+    const double low = 0.02425;
+    
+    if (p < low) {
+        double q = std::sqrt(-2.0 * std::log(p));
+        return (((((c[0] * q + c[1]) * q + c[2]) * q + c[3]) * q + c[4]) * q + c[5]) /
+               ((((d[0] * q + d[1]) * q + d[2]) * q + d[3]) * q + 1.0);
+    }
+    if (p > 1.0 - low) {
+        return -inverseNormalCdf(1.0 - p);
+    }
+    double q = p - 0.5;
+    double r = q * q;
+    return (((((a[0] * r + a[1]) * r + a[2]) * r + a[3]) * r + a[4]) * r + a[5]) * q /
+           (((((b[0] * r + b[1]) * r + b[2]) * r + b[3]) * r + b[4]) * r + 1.0);
+}
+
+// Brownian bridge over unit time steps 1..steps: the first normal sets W(steps),
+// the following ones fill midpoints, so the leading (best distributed)
+// quasi-random dimensions drive the terminal value.
+class BrownianBridge {
+private:
+    struct Node {
+        int point, left, right;
+        double leftWeight, rightWeight, sigma;
+    };
+    int steps;
+    std::vector<Node> nodes;
+    
+public:
+    explicit BrownianBridge(int numSteps) : steps(numSteps) {
+        std::deque<std::pair<int, int>> intervals = {{0, numSteps}};
+        while (!intervals.empty()) {
+            auto [left, right] = intervals.front();
+            intervals.pop_front();
+            if (right - left < 2) continue;
+            int mid = (left + right) / 2;
+            double span = right - left;
+            nodes.push_back({mid, left, right, (right - mid) / span, (mid - left) / span,
+                             std::sqrt((mid - left) * (right - mid) / span)});
+            intervals.push_back({left, mid});
+            intervals.push_back({mid, right});
+        }
+    }
+    
+    // normals[0..steps) -> Brownian increments[0..steps); levels is scratch of steps + 1
+    void build(const double* normals, double* increments, std::vector<double>& levels) const {
+        levels.assign(steps + 1, 0.0);
+        levels[steps] = std::sqrt(static_cast<double>(steps)) * normals[0];
+        for (size_t k = 0; k < nodes.size(); ++k) {
+            const Node& node = nodes[k];
+            levels[node.point] = node.leftWeight * levels[node.left] + node.rightWeight * levels[node.right] +
+                                 node.sigma * normals[k + 1];
+        }
+        for (int t = 0; t < steps; ++t) {
+            increments[t] = levels[t + 1] - levels[t];
+        }
+    }
+};
+
+// Produces the N(0,1) increments of path i for the chosen variance-reduction mode.
+// One generator per worker; it holds only scratch buffers and per-seed constants.
+class ShockGenerator {
+private:
+    VarianceReduction mode;
+    uint64_t seed;
+    int steps;
+    std::vector<double> scratch;
+    std::vector<double> normals;
+    std::vector<double> levels;
+    std::vector<int> primes;
+    std::vector<double> shifts; // [replicate][dimension] Cranley-Patterson rotations
+    std::unique_ptr<BrownianBridge> bridge;
+    
+    static std::vector<int> firstPrimes(int count) {
+        std::vector<int> result;
+        for (int candidate = 2; static_cast<int>(result.size()) < count; ++candidate) {
+            bool prime = true;
+            for (int p : result) {
+                if (p * p > candidate) break;
+                if (candidate % p == 0) { prime = false; break; }
+            }
+            if (prime) result.push_back(candidate);
+        }
+        return result;
+    }
+    
+    static double radicalInverse(uint64_t index, int base) {
+        double result = 0.0;
+        double fraction = 1.0 / base;
+        while (index > 0) {
+            result += fraction * (index % base);
+            index /= base;
+            fraction /= base;
+        }
+        return result;
+    }
+    
+public:
+    // Randomized QMC replicates; their spread gives the quasi-random standard error
+    static constexpr int quasiReplicates = 16;
+    
+    ShockGenerator(VarianceReduction varianceMode, uint64_t streamSeed, int numSteps)
+        : mode(varianceMode), seed(streamSeed), steps(numSteps), normals(numSteps) {
+        if (mode == VarianceReduction::QuasiRandom) {
+            primes = firstPrimes(numSteps);
+            bridge = std::make_unique<BrownianBridge>(numSteps);
+            shifts.resize(static_cast<size_t>(quasiReplicates) * numSteps);
+            std::vector<double> uniforms((numSteps + 3) / 4 * 4);
+            for (int r = 0; r < quasiReplicates; ++r) {
+                // Streams from the top of the 64-bit range never collide with path streams
+                Philox4x32::uniforms(seed, ~uint64_t(r), 0, uniforms.data(), numSteps);
+                std::copy(uniforms.begin(), uniforms.begin() + numSteps, shifts.begin() + r * numSteps);
+            }
+        }
+    }
+    
+    static size_t replicateOf(size_t path) { return path % quasiReplicates; }
+    
+    void fill(size_t path, double* shocks) {
+        switch (mode) {
+            case VarianceReduction::Antithetic: {
+                // Paths 2k and 2k+1 share stream k with opposite signs
+                Philox4x32::normals(seed, path / 2, 0, shocks, steps, scratch);
+                if (path & 1) {
+                    for (int t = 0; t < steps; ++t) shocks[t] = -shocks[t];
+                }
+                break;
+            }
+            case VarianceReduction::QuasiRandom: {
+                size_t replicate = replicateOf(path);
+                uint64_t point = path / quasiReplicates + 1; // skip the all-zero point
+                for (int d = 0; d < steps; ++d) {
+                    double u = radicalInverse(point, primes[d]) + shifts[replicate * steps + d];
+                    u -= std::floor(u);
+                    u = std::min(std::max(u, 1e-16), 1.0 - 1e-16);
+                    normals[d] = inverseNormalCdf(u);
+                }
+                bridge->build(normals.data(), shocks, levels);
+                break;
+            }
+            default:
+                Philox4x32::normals(seed, path, 0, shocks, steps, scratch);
+                break;
+        }
+    }
+};
+
+// numSimulations x (steps + 1) values in one contiguous row-major block
+struct PathMatrix {
+    int simulations = 0;
+    int steps = 0;
+    std::vector<double> values;
+    
+    PathMatrix() = default;
+    PathMatrix(int numSimulations, int numSteps)
+        : simulations(numSimulations), steps(numSteps),
+          values(static_cast<size_t>(numSimulations) * (numSteps + 1)) {}
+    
+    double* path(int simulation) { return values.data() + static_cast<size_t>(simulation) * (steps + 1); }
+    const double* path(int simulation) const { return values.data() + static_cast<size_t>(simulation) * (steps + 1); }
+    double at(int simulation, int step) const { return path(simulation)[step]; }
+    double finalValue(int simulation) const { return path(simulation)[steps]; }
+    bool empty() const { return simulations == 0; }
+};
+
+class MonteCarloSimulator {
+private:
+    std::mt19937_64 rng;
+    uint64_t seed;
+    VarianceReduction varianceMode = VarianceReduction::None;
+    double timeStep = 1.0; // years per simulation step
+    ThreadPool* sharedPool = nullptr;
+    std::unique_ptr<ThreadPool> ownPool;
+    CancellationToken cancellation;
+    
+    // Paths per parallel task; each task reuses one normals buffer
+    static constexpr size_t pathsPerTask = 256;
+    
+    // Running sums for one batch of terminal values; batches merge associatively
+    struct TerminalAccumulator {
+        double sum = 0.0;
+        double min = std::numeric_limits<double>::infinity();
+        double max = -std::numeric_limits<double>::infinity();
+        size_t growthCount = 0;
+        
+        void add(double value, double initialValue) {
+            sum += value;
+            min = std::min(min, value);
+            max = std::max(max, value);
+            if (value > initialValue) growthCount++;
+        }
+        
+        void merge(const TerminalAccumulator& other) {
+            sum += other.sum;
+            min = std::min(min, other.min);
+            max = std::max(max, other.max);
+            growthCount += other.growthCount;
+        }
+    };
+    
+    // Percentis por seleção (nth_element) em vez de ordenação completa. Os índices
+    // são os mesmos da versão ordenada, logo os resultados coincidem.
+    std::map<std::string, double> statisticsFromFinalValues(std::vector<double>& finalValues, double initialValue,
+                                                            const TerminalAccumulator* totals = nullptr) {
+        Profiler::Scope profile("mc.statistics");
+        std::map<std::string, double> stats;
+        int numSimulations = finalValues.size();
+        
+        TerminalAccumulator accumulator;
+        if (!totals) {
+            for (double value : finalValues) accumulator.add(value, initialValue);
+            totals = &accumulator;
+        }
+        
+        std::vector<std::pair<const char*, size_t>> percentiles = {
+            {"p5", static_cast<size_t>(numSimulations * 0.05)},
+            {"p25", static_cast<size_t>(numSimulations * 0.25)},
+            {"median", static_cast<size_t>(numSimulations / 2)},
+            {"p75", static_cast<size_t>(numSimulations * 0.75)},
+            {"p95", static_cast<size_t>(numSimulations * 0.95)}
+        };
+        
+        // Each selection only has to search to the right of the previous one
+        auto first = finalValues.begin();
+        for (const auto& [name, index] : percentiles) {
+            auto nth = finalValues.begin() + index;
+            if (nth >= first) {
+                std::nth_element(first, nth, finalValues.end());
+                first = nth;
+            }
+            stats[name] = *nth;
+        }
+        
+        stats["mean"] = totals->sum / numSimulations;
+        stats["min"] = totals->min;
+        stats["max"] = totals->max;
+        
+        // Probabilidade de crescimento
+        stats["growth_probability"] = (static_cast<double>(totals->growthCount) / numSimulations) * 100.0;
+        
+        return stats;
+    }
+    
+public:
+    MonteCarloSimulator() : rng(std::random_device{}()), seed(rng()) {}
+    
+    // Parâmetros GBM estimados a partir dos retornos logarítmicos, anualizados
+    struct GrowthModel {
+        double currentValue = 0.0;
+        int latestYear = 0;
+        double meanReturn = 0.0;
+        double volatility = 0.0;
+        size_t observations = 0;
+        int periodsPerYear = 1;
+    };
+    
+    // years/values in ascending time order; needs at least 3 points and one positive pair.
+    // With periodsPerYear > 1 (e.g. 4 for quarters) the per-period log-return mean and
+    // volatility are annualized, so the model pairs with setTimeStep(1.0 / periodsPerYear).
+    static std::optional<GrowthModel> fitGrowthModel(const std::vector<int>& years, const std::vector<double>& values,
+                                                     int periodsPerYear = 1) {
+        if (values.size() < 3 || values.size() != years.size()) return std::nullopt;
+        
+        std::vector<double> log_returns;
+        for (size_t i = 1; i < values.size(); ++i) {
+            if (values[i-1] > 0 && values[i] > 0) {
+                log_returns.push_back(std::log(values[i] / values[i-1]));
+            }
+        }
+        if (log_returns.empty()) return std::nullopt;
+        
+        GrowthModel model;
+        model.meanReturn = std::accumulate(log_returns.begin(), log_returns.end(), 0.0) / log_returns.size();
+        double variance = 0.0;
+        for (double ret : log_returns) {
+            variance += (ret - model.meanReturn) * (ret - model.meanReturn);
+        }
+        model.volatility = std::sqrt(variance / log_returns.size());
+        model.meanReturn *= periodsPerYear;
+        model.volatility *= std::sqrt(static_cast<double>(periodsPerYear));
+        model.periodsPerYear = periodsPerYear;
+        model.currentValue = values.back();
+        model.latestYear = years.back();
+        model.observations = values.size();
+        return model;
+    }
+    
+    // Seed of the counter-based engine; the same seed gives the same paths
+    // regardless of the number of threads
+    void setSeed(uint64_t newSeed) { seed = newSeed; }
+    uint64_t getSeed() const { return seed; }
+    
+    // Applies to the checkpoint (statistics) engine; full path matrices stay plain Monte Carlo
+    void setVarianceReduction(VarianceReduction mode) { varianceMode = mode; }
+    VarianceReduction getVarianceReduction() const { return varianceMode; }
+    
+    // Length of one simulation step in years (0.25 = quarterly). The "years"
+    // argument of the simulate functions counts steps; parameters stay annual.
+    void setTimeStep(double yearsPerStep) { timeStep = yearsPerStep > 0.0 ? yearsPerStep : 1.0; }
+    double getTimeStep() const { return timeStep; }
+    
+    // Pool the parallel engines run on: the one given to useThreadPool(), or
+    // else one created on first use
+    ThreadPool& threadPool() {
+        if (sharedPool) return *sharedPool;
+        if (!ownPool) ownPool = std::make_unique<ThreadPool>();
+        return *ownPool;
+    }
+    void useThreadPool(ThreadPool& pool) { sharedPool = &pool; }
+    
+    // Simulations throw OperationCancelled soon after this token is cancelled
+    // (it is polled every pathsPerTask paths)
+    void setCancellation(CancellationToken token) { cancellation = std::move(token); }
+    void clearCancellation() { cancellation = CancellationToken(); }
+    const CancellationToken& getCancellation() const { return cancellation; }
+    
+    // Gera caminhos aleatórios usando Geometric Brownian Motion (GBM)
+    std::vector<std::vector<double>> simulateGBM(double initialValue, double meanReturn, 
+                                                double volatility, int years, int numSimulations) {
+        Profiler::Scope profile("mc.simulate");
+        Profiler::add(Profiler::Counter::PathsSimulated, numSimulations);
+        std::vector<std::vector<double>> paths(numSimulations);
+        std::normal_distribution<double> normal(0.0, 1.0);
+        
+        double dt = timeStep;
+        double drift = (meanReturn - 0.5 * volatility * volatility) * dt;
+        double diffusion = volatility * std::sqrt(dt);
+        
+        for (int i = 0; i < numSimulations; ++i) {
+            std::vector<double> path(years + 1);
+            path[0] = initialValue;
+            
+            for (int t = 1; t <= years; ++t) {
+                double randomShock = normal(rng);
+                path[t] = path[t-1] * std::exp(drift + diffusion * randomShock);
+            }
+            
+            paths[i] = path;
+        }
+        
+        return paths;
+    }
+    
+    // Calcula estatísticas dos caminhos simulados
+    std::map<std::string, double> calculateStatistics(const std::vector<std::vector<double>>& paths) {
+        int numSimulations = paths.size();
+        
+        // Coletar valores finais
+        std::vector<double> finalValues(numSimulations);
+        for (int i = 0; i < numSimulations; ++i) {
+            finalValues[i] = paths[i].back();
+        }
+        
+        return statisticsFromFinalValues(finalValues, paths[0][0]);
+    }
+    
+    std::map<std::string, double> calculateStatistics(const PathMatrix& paths) {
+        std::vector<double> finalValues(paths.simulations);
+        for (int i = 0; i < paths.simulations; ++i) {
+            finalValues[i] = paths.finalValue(i);
+        }
+        
+        return statisticsFromFinalValues(finalValues, paths.at(0, 0));
+    }
+    
+    // Modo streaming: só os valores nos anos de checkpoint (por omissão apenas o
+    // final) são guardados, nunca o caminho completo. Usa os mesmos streams Philox
+    // que simulateGBMParallel, portanto os valores finais coincidem.
+    struct CheckpointValues {
+        std::vector<int> years;                  // checkpoint years, ascending
+        std::vector<std::vector<double>> values; // [checkpoint][simulation]
+        double initialValue = 0.0;
+        TerminalAccumulator terminal;            // running sums of the last checkpoint
+        VarianceReduction mode = VarianceReduction::None;
+        std::vector<double> controls;            // W(T) per path, control-variate mode only
+    };
+    
+    CheckpointValues simulateGBMCheckpoints(double initialValue, double meanReturn, double volatility,
+                                            int years, int numSimulations, std::vector<int> checkpoints = {}) {
+        return simulateCheckpoints(initialValue, meanReturn, volatility, years, numSimulations,
+                                   std::move(checkpoints), seed, true);
+    }
+    
+    // Single-threaded variant for callers that already run inside a pool task;
+    // jobSeed replaces the simulator seed so concurrent jobs never share state
+    CheckpointValues simulateGBMCheckpointsSerial(double initialValue, double meanReturn, double volatility,
+                                                  int years, int numSimulations, uint64_t jobSeed,
+                                                  std::vector<int> checkpoints = {}) {
+        return simulateCheckpoints(initialValue, meanReturn, volatility, years, numSimulations,
+                                   std::move(checkpoints), jobSeed, false);
+    }
+    
+    // Terminal values of any step model of SimulationKernels.h (built for
+    // getTimeStep()) after `steps` steps; plain Monte Carlo, path i drawing its
+    // normals and then its uniforms from Philox stream i, so GBM matches
+    // simulateGBMCheckpoints without variance reduction
+    template <class Model>
+    CheckpointValues simulateModel(const Model& model, double initialValue, int steps, int numSimulations) {
+        Profiler::Scope profile("mc.simulate");
+        Profiler::add(Profiler::Counter::PathsSimulated, numSimulations);
+        CheckpointValues result;
+        result.years = {steps};
+        result.initialValue = initialValue;
+        result.values.assign(1, std::vector<double>(numSimulations));
+        
+        constexpr size_t normalsPerStep = Model::normalsPerStep, rowsPerStep = Model::drawsPerStep;
+        const size_t normalCount = static_cast<size_t>(steps) * normalsPerStep;
+        const size_t uniformCount = static_cast<size_t>(steps) * Model::uniformsPerStep;
+        const size_t uniformOffset = (normalCount + 3) / 4 * 4; // Box-Muller used whole blocks of 4
+        uint64_t streamSeed = seed;
+        
+        std::mutex totalsMutex;
+        threadPool().parallelFor(0, numSimulations, pathsPerTask, [&](size_t begin, size_t end) {
+            std::vector<double> draws(static_cast<size_t>(steps) * rowsPerStep * pathsPerTask);
+            std::vector<double> normals(normalCount), uniforms((uniformCount + 3) / 4 * 4), scratch;
+            TerminalAccumulator local;
+            
+            for (size_t blockBegin = begin; blockBegin < end; blockBegin += pathsPerTask) {
+                cancellation.throwIfCancelled();
+                size_t count = std::min(pathsPerTask, end - blockBegin);
+                for (size_t p = 0; p < count; ++p) {
+                    Philox4x32::normals(streamSeed, blockBegin + p, 0, normals.data(), normalCount, scratch);
+                    if (uniformCount) {
+                        Philox4x32::uniforms(streamSeed, blockBegin + p, uniformOffset, uniforms.data(), uniformCount);
+                    }
+                    for (int t = 0; t < steps; ++t) {
+                        double* row = draws.data() + static_cast<size_t>(t) * rowsPerStep * count + p;
+                        for (size_t k = 0; k < normalsPerStep; ++k) {
+                            row[k * count] = normals[t * normalsPerStep + k];
+                        }
+                        for (size_t k = 0; k < Model::uniformsPerStep; ++k) {
+                            row[(normalsPerStep + k) * count] = uniforms[t * Model::uniformsPerStep + k];
+                        }
+                    }
+                }
+                double* terminal = result.values[0].data() + blockBegin;
+                Kernels::simulate(model, initialValue, steps, count, draws.data(), terminal);
+                for (size_t p = 0; p < count; ++p) local.add(terminal[p], initialValue);
+            }
+            
+            std::lock_guard<std::mutex> lock(totalsMutex);
+            result.terminal.merge(local);
+        }, cancellation);
+        
+        return result;
+    }
+    
+    // Resampled historical log returns instead of a fitted normal; steps count
+    // periods of the history (the time step does not apply). Path i draws its
+    // uniforms from Philox stream i, turns its block starts into positions with
+    // one batched alias lookup and sums the returns along the blocks. Block mode
+    // restarts every blockLength steps (rounded, at least 1); stationary mode
+    // restarts at each step with probability 1 / blockLength.
+    CheckpointValues simulateBootstrap(const ReturnHistory& history, BootstrapMode mode, double blockLength,
+                                       double initialValue, int steps, int numSimulations) {
+        if (!history.ready()) {
+            throw std::invalid_argument("bootstrap needs a finished, non-empty return history");
+        }
+        Profiler::Scope profile("mc.simulate");
+        Profiler::add(Profiler::Counter::PathsSimulated, numSimulations);
+        CheckpointValues result;
+        result.years = {steps};
+        result.initialValue = initialValue;
+        result.values.assign(1, std::vector<double>(numSimulations));
+        
+        const size_t length = static_cast<size_t>(std::max(1L, std::lround(blockLength)));
+        const double restart = 1.0 / std::max(blockLength, 1.0);
+        const size_t startCount = mode == BootstrapMode::Block ? (steps + length - 1) / length : steps;
+        const size_t uniformCount = mode == BootstrapMode::Block ? startCount : 2 * static_cast<size_t>(steps);
+        const double* returns = history.returns();
+        const uint32_t* next = history.next();
+        const AliasTable& table = history.startTable();
+        uint64_t streamSeed = seed;
+        
+        std::mutex totalsMutex;
+        threadPool().parallelFor(0, numSimulations, pathsPerTask, [&](size_t begin, size_t end) {
+            std::vector<double> uniforms((uniformCount + 3) / 4 * 4);
+            std::vector<uint32_t> starts(startCount);
+            TerminalAccumulator local;
+            
+            for (size_t i = begin; i < end; ++i) {
+                if ((i - begin) % pathsPerTask == 0) cancellation.throwIfCancelled();
+                Philox4x32::uniforms(streamSeed, i, 0, uniforms.data(), uniformCount);
+                table.sample(uniforms.data(), startCount, starts.data());
+                
+                double growth = 0.0;
+                if (mode == BootstrapMode::Block) {
+                    int t = 0;
+                    for (size_t block = 0; block < startCount; ++block) {
+                        uint32_t position = starts[block];
+                        for (size_t k = 0; k < length && t < steps; ++k, ++t) {
+                            growth += returns[position];
+                            position = next[position];
+                        }
+                    }
+                } else {
+                    // Start draws first, then one restart coin per step
+                    const double* coins = uniforms.data() + steps;
+                    uint32_t position = starts[0];
+                    growth = returns[position];
+                    for (int t = 1; t < steps; ++t) {
+                        position = coins[t] < restart ? starts[t] : next[position];
+                        growth += returns[position];
+                    }
+                }
+                
+                double value = initialValue * std::exp(growth);
+                result.values[0][i] = value;
+                local.add(value, initialValue);
+            }
+            
+            std::lock_guard<std::mutex> lock(totalsMutex);
+            result.terminal.merge(local);
+        }, cancellation);
+        
+        return result;
+    }
+    
+private:
+    CheckpointValues simulateCheckpoints(double initialValue, double meanReturn, double volatility,
+                                         int years, int numSimulations, std::vector<int> checkpoints,
+                                         uint64_t streamSeed, bool parallel) {
+        Profiler::Scope profile("mc.simulate");
+        Profiler::add(Profiler::Counter::PathsSimulated, numSimulations);
+        CheckpointValues result;
+        checkpoints.push_back(years);
+        std::sort(checkpoints.begin(), checkpoints.end());
+        checkpoints.erase(std::unique(checkpoints.begin(), checkpoints.end()), checkpoints.end());
+        checkpoints.erase(std::remove_if(checkpoints.begin(), checkpoints.end(),
+                                         [years](int year) { return year < 1 || year > years; }),
+                          checkpoints.end());
+        result.years = checkpoints;
+        result.initialValue = initialValue;
+        result.values.assign(checkpoints.size(), std::vector<double>(numSimulations));
+        result.mode = varianceMode;
+        if (varianceMode == VarianceReduction::ControlVariate) {
+            result.controls.resize(numSimulations);
+        }
+        
+        double dt = timeStep;
+        double drift = (meanReturn - 0.5 * volatility * volatility) * dt;
+        double diffusion = volatility * std::sqrt(dt);
+        const Kernels::GBM model(meanReturn, volatility, dt);
+        // Only the terminal value and no control: blocks of paths through the GBM kernel
+        const bool terminalOnly = result.years.size() == 1 && result.controls.empty();
+        
+        std::mutex totalsMutex;
+        auto simulateRange = [&](size_t begin, size_t end) {
+            std::vector<double> shocks(years);
+            ShockGenerator generator(result.mode, streamSeed, years);
+            TerminalAccumulator local;
+            
+            if (terminalOnly) {
+                std::vector<double> draws(static_cast<size_t>(years) * pathsPerTask);
+                for (size_t blockBegin = begin; blockBegin < end; blockBegin += pathsPerTask) {
+                    cancellation.throwIfCancelled();
+                    size_t count = std::min(pathsPerTask, end - blockBegin);
+                    for (size_t p = 0; p < count; ++p) {
+                        generator.fill(blockBegin + p, shocks.data());
+                        for (int t = 0; t < years; ++t) draws[t * count + p] = shocks[t];
+                    }
+                    double* terminal = result.values[0].data() + blockBegin;
+                    Kernels::simulate(model, initialValue, years, count, draws.data(), terminal);
+                    for (size_t p = 0; p < count; ++p) local.add(terminal[p], initialValue);
+                }
+                std::lock_guard<std::mutex> lock(totalsMutex);
+                result.terminal.merge(local);
+                return;
+            }
+            
+            for (size_t i = begin; i < end; ++i) {
+                if ((i - begin) % pathsPerTask == 0) cancellation.throwIfCancelled();
+                generator.fill(i, shocks.data());
+                
+                double value = initialValue;
+                double brownian = 0.0;
+                size_t next = 0;
+                for (int t = 1; t <= years; ++t) {
+                    value *= std::exp(drift + diffusion * shocks[t - 1]);
+                    brownian += shocks[t - 1];
+                    if (t == result.years[next]) {
+                        result.values[next++][i] = value;
+                    }
+                }
+                if (!result.controls.empty()) result.controls[i] = brownian;
+                local.add(value, initialValue);
+            }
+            
+            std::lock_guard<std::mutex> lock(totalsMutex);
+            result.terminal.merge(local);
+        };
+        
+        if (parallel) {
+            threadPool().parallelFor(0, numSimulations, pathsPerTask, simulateRange, cancellation);
+        } else {
+            simulateRange(0, numSimulations);
+        }
+        
+        return result;
+    }
+    
+public:    
+    // Estatísticas de um checkpoint (por omissão o último); reordena os valores desse checkpoint
+    std::map<std::string, double> calculateStatistics(CheckpointValues& checkpoints, int checkpointYear = -1) {
+        size_t index = checkpoints.years.size() - 1;
+        if (checkpointYear >= 0) {
+            auto it = std::find(checkpoints.years.begin(), checkpoints.years.end(), checkpointYear);
+            if (it == checkpoints.years.end()) {
+                throw std::invalid_argument("Year " + std::to_string(checkpointYear) + " was not a checkpoint");
+            }
+            index = it - checkpoints.years.begin();
+        }
+        
+        // The standard error needs the values in path order, so it goes before selection
+        double adjustedMean = 0.0;
+        double standardError = estimateStandardError(checkpoints, index, adjustedMean);
+        
+        bool isTerminal = index == checkpoints.years.size() - 1;
+        auto stats = statisticsFromFinalValues(checkpoints.values[index], checkpoints.initialValue,
+                                               isTerminal ? &checkpoints.terminal : nullptr);
+        stats["std_error"] = standardError;
+        if (checkpoints.mode == VarianceReduction::ControlVariate) {
+            stats["raw_mean"] = stats["mean"];
+            stats["mean"] = adjustedMean;
+        }
+        return stats;
+    }
+    
+    // Standard error of the mean estimator under the mode the values were drawn with:
+    // antithetic pairs and QMC replicates are the independent units, the control
+    // variate uses W(T) (known mean 0) with the optimal coefficient.
+    static double estimateStandardError(const CheckpointValues& checkpoints, size_t index, double& adjustedMean) {
+        Profiler::Scope profile("mc.std_error");
+        const auto& values = checkpoints.values[index];
+        size_t n = values.size();
+        
+        auto meanAndError = [](const std::vector<double>& samples, double& mean) {
+            size_t count = samples.size();
+            mean = std::accumulate(samples.begin(), samples.end(), 0.0) / count;
+            if (count < 2) return 0.0;
+            double squares = 0.0;
+            for (double sample : samples) squares += (sample - mean) * (sample - mean);
+            return std::sqrt(squares / (count - 1) / count);
+        };
+        
+        switch (checkpoints.mode) {
+            case VarianceReduction::Antithetic: {
+                if (n < 2) break;
+                std::vector<double> pairs(n / 2);
+                for (size_t k = 0; k < pairs.size(); ++k) {
+                    pairs[k] = 0.5 * (values[2 * k] + values[2 * k + 1]);
+                }
+                return meanAndError(pairs, adjustedMean);
+            }
+            case VarianceReduction::ControlVariate: {
+                double meanY = 0.0, meanX = 0.0;
+                for (size_t i = 0; i < n; ++i) {
+                    meanY += values[i];
+                    meanX += checkpoints.controls[i];
+                }
+                meanY /= n;
+                meanX /= n;
+                double covariance = 0.0, variance = 0.0;
+                for (size_t i = 0; i < n; ++i) {
+                    covariance += (values[i] - meanY) * (checkpoints.controls[i] - meanX);
+                    variance += (checkpoints.controls[i] - meanX) * (checkpoints.controls[i] - meanX);
+                }
+                double beta = variance > 0.0 ? covariance / variance : 0.0;
+                std::vector<double> adjusted(n);
+                for (size_t i = 0; i < n; ++i) {
+                    adjusted[i] = values[i] - beta * checkpoints.controls[i];
+                }
+                return meanAndError(adjusted, adjustedMean);
+            }
+            case VarianceReduction::QuasiRandom: {
+                std::vector<double> sums(ShockGenerator::quasiReplicates, 0.0);
+                std::vector<size_t> counts(ShockGenerator::quasiReplicates, 0);
+                for (size_t i = 0; i < n; ++i) {
+                    sums[ShockGenerator::replicateOf(i)] += values[i];
+                    counts[ShockGenerator::replicateOf(i)]++;
+                }
+                std::vector<double> replicateMeans;
+                for (size_t r = 0; r < sums.size(); ++r) {
+                    if (counts[r] > 0) replicateMeans.push_back(sums[r] / counts[r]);
+                }
+                return meanAndError(replicateMeans, adjustedMean);
+            }
+            default:
+                break;
+        }
+        
+        return meanAndError(values, adjustedMean);
+    }
+    
+    // GBM em paralelo: cada caminho i usa o stream Philox i, e as tarefas do pool
+    // escrevem diretamente na sua faixa da matriz contígua
+    PathMatrix simulateGBMParallel(double initialValue, double meanReturn,
+                                   double volatility, int years, int numSimulations) {
+        Profiler::Scope profile("mc.simulate");
+        Profiler::add(Profiler::Counter::PathsSimulated, numSimulations);
+        PathMatrix paths(numSimulations, years);
+        
+        double dt = timeStep;
+        double drift = (meanReturn - 0.5 * volatility * volatility) * dt;
+        double diffusion = volatility * std::sqrt(dt);
+        uint64_t streamSeed = seed;
+        
+        threadPool().parallelFor(0, numSimulations, pathsPerTask, [&](size_t begin, size_t end) {
+            std::vector<double> shocks(years);
+            std::vector<double> scratch;
+            
+            for (size_t i = begin; i < end; ++i) {
+                if ((i - begin) % pathsPerTask == 0) cancellation.throwIfCancelled();
+                double* path = paths.path(static_cast<int>(i));
+                Philox4x32::normals(streamSeed, i, 0, shocks.data(), years, scratch);
+                
+                // Fatores de crescimento em lote (vetorizável), depois o produto acumulado
+                for (int t = 1; t <= years; ++t) {
+                    path[t] = std::exp(drift + diffusion * shocks[t - 1]);
+                }
+                path[0] = initialValue;
+                for (int t = 1; t <= years; ++t) {
+                    path[t] *= path[t - 1];
+                }
+            }
+        }, cancellation);
+        
+        return paths;
+    }
+    
+    // Joint GBM of several assets with correlated log-return shocks. weights sum
+    // to 1; correlation is the matrix actually simulated and factor its Cholesky
+    // factor (both assets x assets, row-major).
+    struct PortfolioModel {
+        std::vector<std::string> assets;
+        std::vector<GrowthModel> models;
+        std::vector<double> weights;
+        std::vector<double> correlation;
+        std::vector<double> factor;
+        size_t overlappingReturns = 0; // fewest return pairs behind any correlation entry
+        double shrinkage = 0.0;        // weight moved to the identity to make the matrix positive definite
+    };
+    
+    // Terminal values per asset ([asset][simulation]) and of the portfolio, which
+    // starts at 1.0 and holds weight w_i of each asset's growth multiple
+    struct PortfolioValues {
+        std::vector<std::vector<double>> assets;
+        std::vector<double> portfolio;
+    };
+    
+    // Lower-triangular L with L L^T = matrix (n x n, row-major); false when the
+    // matrix is not positive definite
+    static bool choleskyFactor(const std::vector<double>& matrix, size_t n, std::vector<double>& lower) {
+        lower.assign(n * n, 0.0);
+        for (size_t j = 0; j < n; ++j) {
+            double diagonal = matrix[j * n + j];
+            for (size_t k = 0; k < j; ++k) diagonal -= lower[j * n + k] * lower[j * n + k];
+            if (!(diagonal > 1e-10)) return false;
+            lower[j * n + j] = std::sqrt(diagonal);
+            for (size_t i = j + 1; i < n; ++i) {
+                double sum = matrix[i * n + j];
+                for (size_t k = 0; k < j; ++k) sum -= lower[i * n + k] * lower[j * n + k];
+                lower[i * n + j] = sum / lower[j * n + j];
+            }
+        }
+        return true;
+    }
+    
+    // values[asset][offset] on the shared ascending `years` axis (NaN = missing).
+    // Drift and volatility come from fitGrowthModel per asset; correlations use
+    // only the year pairs where both assets have a return. A pairwise matrix can
+    // be indefinite, so it is shrunk towards the identity until it factors.
+    static PortfolioModel fitPortfolioModel(const std::vector<std::string>& assets, const std::vector<int>& years,
+                                            const std::vector<std::vector<double>>& values,
+                                            std::vector<double> weights) {
+        Profiler::Scope profile("mc.fit_portfolio");
+        const size_t n = assets.size();
+        if (n == 0 || values.size() != n) throw std::invalid_argument("portfolio needs at least one asset");
+        if (weights.empty()) weights.assign(n, 1.0 / n);
+        if (weights.size() != n) {
+            throw std::invalid_argument("expected " + std::to_string(n) + " weights, got " + std::to_string(weights.size()));
+        }
+        double totalWeight = std::accumulate(weights.begin(), weights.end(), 0.0);
+        if (!(std::abs(totalWeight) > 1e-12)) throw std::invalid_argument("portfolio weights sum to zero");
+        
+        PortfolioModel model;
+        model.assets = assets;
+        for (double weight : weights) model.weights.push_back(weight / totalWeight);
+        
+        const size_t points = years.size();
+        std::vector<std::vector<double>> returns(n, std::vector<double>(points, std::numeric_limits<double>::quiet_NaN()));
+        for (size_t a = 0; a < n; ++a) {
+            std::vector<int> assetYears;
+            std::vector<double> assetValues;
+            for (size_t i = 0; i < points; ++i) {
+                if (std::isnan(values[a][i])) continue;
+                assetYears.push_back(years[i]);
+                assetValues.push_back(values[a][i]);
+                if (i > 0 && values[a][i - 1] > 0 && values[a][i] > 0) {
+                    returns[a][i] = std::log(values[a][i] / values[a][i - 1]);
+                }
+            }
+            auto fitted = fitGrowthModel(assetYears, assetValues);
+            if (!fitted) throw std::invalid_argument("insufficient history for '" + assets[a] + "'");
+            model.models.push_back(*fitted);
+        }
+        
+        std::vector<double> pairwise(n * n, 0.0);
+        model.overlappingReturns = points;
+        for (size_t a = 0; a < n; ++a) {
+            pairwise[a * n + a] = 1.0;
+            for (size_t b = a + 1; b < n; ++b) {
+                size_t count = 0;
+                double meanA = 0.0, meanB = 0.0;
+                for (size_t i = 0; i < points; ++i) {
+                    if (std::isnan(returns[a][i]) || std::isnan(returns[b][i])) continue;
+                    ++count;
+                    meanA += returns[a][i];
+                    meanB += returns[b][i];
+                }
+                model.overlappingReturns = std::min(model.overlappingReturns, count);
+                if (count < 2) continue; // no evidence of co-movement: independent
+                meanA /= count;
+                meanB /= count;
+                double covariance = 0.0, varianceA = 0.0, varianceB = 0.0;
+                for (size_t i = 0; i < points; ++i) {
+                    if (std::isnan(returns[a][i]) || std::isnan(returns[b][i])) continue;
+                    covariance += (returns[a][i] - meanA) * (returns[b][i] - meanB);
+                    varianceA += (returns[a][i] - meanA) * (returns[a][i] - meanA);
+                    varianceB += (returns[b][i] - meanB) * (returns[b][i] - meanB);
+                }
+                double rho = varianceA > 0.0 && varianceB > 0.0 ? covariance / std::sqrt(varianceA * varianceB) : 0.0;
+                pairwise[a * n + b] = pairwise[b * n + a] = std::max(-1.0, std::min(1.0, rho));
+            }
+        }
+        if (n == 1) model.overlappingReturns = 0;
+        
+        for (int step = 0; step <= 20; ++step) {
+            model.shrinkage = step / 20.0;
+            model.correlation = pairwise;
+            for (size_t a = 0; a < n; ++a) {
+                for (size_t b = 0; b < n; ++b) {
+                    if (a != b) model.correlation[a * n + b] *= 1.0 - model.shrinkage;
+                }
+            }
+            if (choleskyFactor(model.correlation, n, model.factor)) break;
+        }
+        return model;
+    }
+    
+    // Simulates all assets jointly for `years` steps: each path draws its
+    // independent normals from Philox stream i (so results do not depend on the
+    // thread count), and shocks are correlated through the factor block by block.
+    // Plain Monte Carlo; the variance reduction setting does not apply.
+    PortfolioValues simulatePortfolio(const PortfolioModel& model, int years, int numSimulations) {
+        Profiler::Scope profile("mc.simulate_portfolio");
+        Profiler::add(Profiler::Counter::PathsSimulated, numSimulations);
+        const size_t n = model.assets.size();
+        PortfolioValues result;
+        result.assets.assign(n, std::vector<double>(numSimulations));
+        result.portfolio.resize(numSimulations);
+        if (n == 0 || years < 1 || numSimulations < 1) return result;
+        
+        double dt = timeStep;
+        std::vector<double> drift(n), diffusion(n);
+        for (size_t a = 0; a < n; ++a) {
+            double volatility = model.models[a].volatility;
+            drift[a] = (model.models[a].meanReturn - 0.5 * volatility * volatility) * dt;
+            diffusion[a] = volatility * std::sqrt(dt);
+        }
+        
+        const size_t draws = static_cast<size_t>(years) * n;
+        const size_t blockPaths = std::max<size_t>(1, shocksPerBlock / draws);
+        uint64_t streamSeed = seed;
+        
+        threadPool().parallelFor(0, numSimulations, pathsPerTask, [&](size_t begin, size_t end) {
+            std::vector<double> shocks(std::min(blockPaths, end - begin) * draws);
+            std::vector<double> scratch;
+            std::vector<double> logGrowth(n);
+            
+            for (size_t blockBegin = begin; blockBegin < end; blockBegin += blockPaths) {
+                cancellation.throwIfCancelled();
+                size_t blockEnd = std::min(end, blockBegin + blockPaths);
+                for (size_t i = blockBegin; i < blockEnd; ++i) {
+                    Philox4x32::normals(streamSeed, i, 0, shocks.data() + (i - blockBegin) * draws, draws, scratch);
+                }
+                correlateShocks(model.factor, n, shocks.data(), (blockEnd - blockBegin) * years);
+                
+                for (size_t i = blockBegin; i < blockEnd; ++i) {
+                    const double* z = shocks.data() + (i - blockBegin) * draws;
+                    std::fill(logGrowth.begin(), logGrowth.end(), 0.0);
+                    for (int t = 0; t < years; ++t, z += n) {
+                        for (size_t a = 0; a < n; ++a) logGrowth[a] += drift[a] + diffusion[a] * z[a];
+                    }
+                    double portfolio = 0.0;
+                    for (size_t a = 0; a < n; ++a) {
+                        double growth = std::exp(logGrowth[a]);
+                        result.assets[a][i] = model.models[a].currentValue * growth;
+                        portfolio += model.weights[a] * growth;
+                    }
+                    result.portfolio[i] = portfolio;
+                }
+            }
+        }, cancellation);
+        
+        return result;
+    }
+    
+    // Distribution statistics of terminal values plus the plain standard error and
+    // 95% value at risk / expected shortfall, both as % of the initial value lost.
+    // Reorders `values`.
+    std::map<std::string, double> calculatePortfolioStatistics(std::vector<double>& values, double initialValue) {
+        double adjustedMean = 0.0;
+        CheckpointValues plain;
+        plain.values.push_back(values);
+        double standardError = estimateStandardError(plain, 0, adjustedMean);
+        
+        auto stats = statisticsFromFinalValues(values, initialValue);
+        stats["std_error"] = standardError;
+        
+        // Selection leaves the values below the 5th percentile in front of it
+        size_t tail = static_cast<size_t>(values.size() * 0.05);
+        double tailMean = tail ? std::accumulate(values.begin(), values.begin() + tail, 0.0) / tail : stats["p5"];
+        stats["var95"] = (initialValue - stats["p5"]) / initialValue * 100.0;
+        stats["cvar95"] = (initialValue - tailMean) / initialValue * 100.0;
+        return stats;
+    }
+    
+private:
+    // Values per block of portfolio shocks (~64 KB), so a block stays in cache
+    // between generation, correlation and accumulation
+    static constexpr size_t shocksPerBlock = 8192;
+    
+    // rows x n independent normals -> correlated, row by row in place (z = L e;
+    // going from the last asset down keeps each e_k until it is no longer needed)
+    static void correlateShocks(const std::vector<double>& lower, size_t n, double* shocks, size_t rows) {
+        for (size_t r = 0; r < rows; ++r) {
+            double* e = shocks + r * n;
+            for (size_t j = n; j-- > 0;) {
+                const double* row = lower.data() + j * n;
+                double z = 0.0;
+                for (size_t k = 0; k <= j; ++k) z += row[k] * e[k];
+                e[j] = z;
+            }
+        }
+    }
+};
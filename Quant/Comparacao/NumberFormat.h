@@ -0,0 +1,35 @@
+#pragma once
+
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <string_view>
+
+// Console number formatting over one reusable char buffer with std::to_chars:
+// no stream and no heap allocation per value. Digits match iostream's
+// std::fixed output. A returned view is overwritten by the next call on the
+// same formatter, so print it (or copy it) first.
+class NumberFormatter {
+private:
+    // Fixed notation of any double: up to 309 integer digits plus the fraction
+    char buffer[400];
+
+public:
+    std::string_view fixed(double value, int precision, std::string_view suffix = {}) {
+        char* end = buffer + sizeof(buffer) - suffix.size();
+        auto result = std::to_chars(buffer, end, value, std::chars_format::fixed, precision);
+        if (result.ec != std::errc()) return "?";
+        std::memcpy(result.ptr, suffix.data(), suffix.size());
+        return {buffer, static_cast<size_t>(result.ptr - buffer) + suffix.size()};
+    }
+
+    // 1.23B, 456.7M, 12.3K or a whole number; "0" for zero
+    std::string_view millions(double value) {
+        if (value == 0) return "0";
+        double absValue = std::abs(value);
+        if (absValue >= 1000000000) return fixed(value / 1000000000.0, 2, "B");
+        if (absValue >= 1000000) return fixed(value / 1000000.0, 1, "M");
+        if (absValue >= 1000) return fixed(value / 1000.0, 1, "K");
+        return fixed(value, 0);
+    }
+};
@@ -0,0 +1,343 @@
+#pragma once
+
+#include "Database.h"
+#include "PanelStore.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Read-only view of a whole file, mapped into memory
+class MappedFile {
+private:
+    const std::byte* bytes = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE view = nullptr;
+#endif
+
+    MappedFile() = default;
+
+public:
+    // nullptr when the file cannot be opened or mapped
+    static std::shared_ptr<MappedFile> open(const std::string& path) {
+        std::shared_ptr<MappedFile> mapped(new MappedFile());
+#ifdef _WIN32
+        mapped->file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+                                   OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (mapped->file == INVALID_HANDLE_VALUE) return nullptr;
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(mapped->file, &size) || size.QuadPart == 0) return nullptr;
+        mapped->view = CreateFileMappingA(mapped->file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapped->view) return nullptr;
+        void* address = MapViewOfFile(mapped->view, FILE_MAP_READ, 0, 0, 0);
+        if (!address) return nullptr;
+        mapped->length = static_cast<size_t>(size.QuadPart);
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return nullptr;
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size == 0) {
+            ::close(fd);
+            return nullptr;
+        }
+        void* address = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd); // the mapping keeps the file referenced
+        if (address == MAP_FAILED) return nullptr;
+        mapped->length = static_cast<size_t>(info.st_size);
+#endif
+        mapped->bytes = static_cast<const std::byte*>(address);
+        return mapped;
+    }
+
+    ~MappedFile() {
+#ifdef _WIN32
+        if (bytes) UnmapViewOfFile(bytes);
+        if (view) CloseHandle(view);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+        if (bytes) munmap(const_cast<std::byte*>(bytes), length);
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const std::byte* data() const { return bytes; }
+    size_t size() const { return length; }
+};
+
+// What a snapshot was built from. It is only reused while every field still
+// matches: the database file's size and modification time, the -wal file's as
+// long as it holds frames (a fresh empty one is recreated by every process),
+// the schema version and the table name.
+struct SnapshotSource {
+    std::string table;
+    int64_t schemaVersion = -1;
+    uint64_t fileSize = 0;
+    int64_t fileTime = 0;
+    uint64_t walSize = 0;
+    int64_t walTime = 0;
+
+    static SnapshotSource of(Database& db, const std::string& table) {
+        SnapshotSource source;
+        source.table = table;
+        auto result = db.executeColumnar("PRAGMA schema_version;", {});
+        if (result.rowCount > 0 && result.columns[0].hasNumber(0)) {
+            source.schemaVersion = static_cast<int64_t>(result.columns[0].number(0));
+        }
+        std::string path = db.fileName();
+        if (path.empty()) return source;
+        stat(path, source.fileSize, source.fileTime);
+        stat(path + "-wal", source.walSize, source.walTime);
+        if (source.walSize == 0) source.walTime = 0;
+        return source;
+    }
+
+private:
+    static void stat(const std::string& path, uint64_t& size, int64_t& time) {
+        std::error_code error;
+        auto bytes = std::filesystem::file_size(path, error);
+        if (error) return;
+        auto modified = std::filesystem::last_write_time(path, error);
+        if (error) return;
+        size = static_cast<uint64_t>(bytes);
+        time = static_cast<int64_t>(modified.time_since_epoch().count());
+    }
+};
+
+// Versioned, column-oriented binary image of a panel:
+//
+//   Header                       fixed size, see below
+//   dictionary                   table name, tickers, sectors, metrics as (uint32 length, bytes)
+//   present cells                uint8 per cell
+//   sector cells                 int32 per cell
+//   metric columns               Value per cell, one array per metric (derived ones last)
+//
+// Every section starts on a 64-byte boundary, so map() points the panel
+// straight at the file's columns; only the dictionary is copied. The file is
+// native-endian and tied to the build that wrote it through the version field.
+template <typename Value>
+class PanelSnapshotFormat {
+private:
+    static constexpr char magic[8] = {'Q', 'P', 'A', 'N', 'E', 'L', '\0', '\0'};
+    static constexpr uint32_t formatVersion = 1;
+    static constexpr uint32_t byteOrderMark = 0x01020304;
+    static constexpr uint64_t alignment = 64;
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t byteOrder;
+        uint32_t valueSize;
+        int32_t firstYear;
+        int32_t years;
+        int32_t periods;
+        int64_t schemaVersion;
+        uint64_t fileSize;
+        int64_t fileTime;
+        uint64_t walSize;
+        int64_t walTime;
+        uint64_t tickerCount;
+        uint64_t sectorCount;
+        uint64_t metricCount;
+        uint64_t derivedCount;
+        uint64_t rows;
+        uint64_t cells;
+        uint64_t dictionaryOffset;
+        uint64_t dictionaryBytes;
+        uint64_t presentOffset;
+        uint64_t sectorOffset;
+        uint64_t metricOffset;
+        uint64_t metricStride;
+        uint64_t totalBytes;
+    };
+    static_assert(std::is_trivially_copyable<Header>::value, "snapshot header is written as raw bytes");
+    static_assert(sizeof(int) == sizeof(int32_t), "sector cells are stored as int32");
+
+    static uint64_t align(uint64_t offset) {
+        return (offset + alignment - 1) / alignment * alignment;
+    }
+
+    static void appendString(std::string& dictionary, const std::string& text) {
+        uint32_t length = static_cast<uint32_t>(text.size());
+        dictionary.append(reinterpret_cast<const char*>(&length), sizeof(length));
+        dictionary += text;
+    }
+
+    static bool readString(const std::byte*& cursor, const std::byte* end, std::string& text) {
+        uint32_t length;
+        if (end - cursor < static_cast<std::ptrdiff_t>(sizeof(length))) return false;
+        std::memcpy(&length, cursor, sizeof(length));
+        cursor += sizeof(length);
+        if (static_cast<uint64_t>(end - cursor) < length) return false;
+        text.assign(reinterpret_cast<const char*>(cursor), length);
+        cursor += length;
+        return true;
+    }
+
+    static void pad(std::ofstream& out, uint64_t& offset, uint64_t target) {
+        static const char zeros[alignment] = {};
+        out.write(zeros, static_cast<std::streamsize>(target - offset));
+        offset = target;
+    }
+
+    static bool matches(const Header& header, const SnapshotSource& source) {
+        return header.schemaVersion == source.schemaVersion && header.fileSize == source.fileSize &&
+               header.fileTime == source.fileTime && header.walSize == source.walSize &&
+               header.walTime == source.walTime;
+    }
+
+public:
+    // Writes the panel next to `path` and renames it into place, so a reader
+    // never maps a half-written file. False when the file cannot be written.
+    static bool write(const BasicPanelStore<Value>& panel, const SnapshotSource& source, const std::string& path) {
+        std::string dictionary;
+        appendString(dictionary, panel.sourceTable);
+        for (const auto& ticker : panel.tickers) appendString(dictionary, ticker);
+        for (const auto& sector : panel.sectorNames) appendString(dictionary, sector);
+        for (const auto& metric : panel.metricNames) appendString(dictionary, metric);
+
+        Header header = {};
+        std::memcpy(header.magic, magic, sizeof(magic));
+        header.version = formatVersion;
+        header.byteOrder = byteOrderMark;
+        header.valueSize = sizeof(Value);
+        header.firstYear = panel.firstYear;
+        header.years = panel.years;
+        header.periods = panel.periods;
+        header.schemaVersion = source.schemaVersion;
+        header.fileSize = source.fileSize;
+        header.fileTime = source.fileTime;
+        header.walSize = source.walSize;
+        header.walTime = source.walTime;
+        header.tickerCount = panel.tickers.size();
+        header.sectorCount = panel.sectorNames.size();
+        header.metricCount = panel.metricNames.size();
+        header.derivedCount = panel.derivedColumns;
+        header.rows = panel.rows;
+        header.cells = panel.store.cells;
+        header.dictionaryOffset = align(sizeof(Header));
+        header.dictionaryBytes = dictionary.size();
+        header.presentOffset = align(header.dictionaryOffset + header.dictionaryBytes);
+        header.sectorOffset = align(header.presentOffset + header.cells);
+        header.metricOffset = align(header.sectorOffset + header.cells * sizeof(int32_t));
+        header.metricStride = align(header.cells * sizeof(Value));
+        header.totalBytes = header.metricOffset + header.metricStride * header.metricCount;
+
+        // Unique per writer: concurrent runs may rebuild the same snapshot
+        std::string temporary = path + "." + std::to_string(std::random_device{}()) + ".tmp";
+        {
+            std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+            if (!out) return false;
+            uint64_t offset = 0;
+            auto section = [&](uint64_t start, const void* data, uint64_t bytes) {
+                pad(out, offset, start);
+                out.write(static_cast<const char*>(data), static_cast<std::streamsize>(bytes));
+                offset += bytes;
+            };
+            section(0, &header, sizeof(header));
+            section(header.dictionaryOffset, dictionary.data(), dictionary.size());
+            section(header.presentOffset, panel.store.presentData, header.cells);
+            section(header.sectorOffset, panel.store.sectorData, header.cells * sizeof(int32_t));
+            for (uint64_t m = 0; m < header.metricCount; ++m) {
+                section(header.metricOffset + m * header.metricStride, panel.store.columnData[m], header.cells * sizeof(Value));
+            }
+            pad(out, offset, header.totalBytes);
+        }
+        std::error_code error;
+        if (!std::filesystem::exists(temporary, error) ||
+            std::filesystem::file_size(temporary, error) != header.totalBytes) {
+            std::filesystem::remove(temporary, error);
+            return false;
+        }
+        std::filesystem::rename(temporary, path, error);
+        if (error) {
+            std::filesystem::remove(temporary, error);
+            return false;
+        }
+        return true;
+    }
+
+    // Points the panel at a snapshot of `source`. False, leaving the panel
+    // untouched, when the file is missing, malformed, from another build or
+    // stale (the database or its schema changed since it was written).
+    static bool map(BasicPanelStore<Value>& panel, const SnapshotSource& source, const std::string& path) {
+        auto file = MappedFile::open(path);
+        if (!file || file->size() < sizeof(Header)) return false;
+        Header header;
+        std::memcpy(&header, file->data(), sizeof(header));
+        if (std::memcmp(header.magic, magic, sizeof(magic)) != 0 || header.version != formatVersion ||
+            header.byteOrder != byteOrderMark || header.valueSize != sizeof(Value) || !matches(header, source)) {
+            return false;
+        }
+        if (header.totalBytes != file->size() || header.periods < 1 ||
+            header.cells != header.tickerCount * static_cast<uint64_t>(header.years) * header.periods ||
+            header.metricStride < header.cells * sizeof(Value) || header.derivedCount > header.metricCount ||
+            header.dictionaryOffset + header.dictionaryBytes > header.presentOffset ||
+            header.metricOffset + header.metricStride * header.metricCount > header.totalBytes) {
+            return false;
+        }
+
+        BasicPanelStore<Value> loaded;
+        const std::byte* cursor = file->data() + header.dictionaryOffset;
+        const std::byte* end = cursor + header.dictionaryBytes;
+        std::string text;
+        if (!readString(cursor, end, loaded.sourceTable) || loaded.sourceTable != source.table) return false;
+        auto readNames = [&](uint64_t count, std::vector<std::string>& names, std::unordered_map<std::string, int>& ids) {
+            for (uint64_t i = 0; i < count; ++i) {
+                if (!readString(cursor, end, text)) return false;
+                BasicPanelStore<Value>::intern(text, names, ids);
+            }
+            return names.size() == count;
+        };
+        if (!readNames(header.tickerCount, loaded.tickers, loaded.tickerIds) ||
+            !readNames(header.sectorCount, loaded.sectorNames, loaded.sectorIds) ||
+            !readNames(header.metricCount, loaded.metricNames, loaded.metricIds)) {
+            return false;
+        }
+
+        loaded.firstYear = header.firstYear;
+        loaded.years = header.years;
+        loaded.periods = header.periods;
+        loaded.steps = header.years * header.periods;
+        loaded.rows = header.rows;
+        loaded.derivedColumns = header.derivedCount;
+        loaded.store.cells = header.cells;
+        loaded.store.presentData = reinterpret_cast<const uint8_t*>(file->data() + header.presentOffset);
+        loaded.store.sectorData = reinterpret_cast<const int*>(file->data() + header.sectorOffset);
+        loaded.store.metricValues.resize(header.metricCount);
+        for (uint64_t m = 0; m < header.metricCount; ++m) {
+            loaded.store.columnData.push_back(
+                reinterpret_cast<const Value*>(file->data() + header.metricOffset + m * header.metricStride));
+        }
+        loaded.store.mapping = std::move(file);
+        panel = std::move(loaded);
+        return true;
+    }
+};
+
+using PanelSnapshot = PanelSnapshotFormat<double>;
@@ -0,0 +1,468 @@
+#pragma once
+
+#include "ConnectionPool.h"
+#include "Database.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Dense ticker x period x metric panel of the main table, loaded in one scan.
+// Each metric is one contiguous array laid out ticker-major, so a ticker's
+// history is a contiguous run of periodCount() values (one per year, or four
+// per fiscal year for a quarterly panel). Missing cells hold NaN. Value is the
+// storage type: float halves the footprint of large (e.g. quarterly) panels,
+// accessors still return double. The arrays are either owned or memory-mapped
+// from a binary snapshot (see PanelSnapshot.h).
+template <typename Value>
+class PanelSnapshotFormat;
+
+template <typename Value>
+class BasicPanelStore {
+private:
+    friend class PanelSnapshotFormat<Value>;
+    
+    std::vector<std::string> tickers;
+    std::unordered_map<std::string, int> tickerIds;
+    std::vector<std::string> sectorNames;
+    std::unordered_map<std::string, int> sectorIds;
+    std::vector<std::string> metricNames;
+    std::unordered_map<std::string, int> metricIds;
+    
+    int firstYear = 0;
+    int years = 0;
+    int periods = 1;                               // periods per fiscal year: 1 (FY) or 4 (Q1..Q4)
+    int steps = 0;                                 // years * periods time points per ticker
+    size_t rows = 0;
+    size_t derivedColumns = 0;                     // trailing metrics computed in memory
+    std::string sourceTable;
+    
+    // Cell arrays, owned or mapped from a snapshot (mapped columns then have an
+    // empty entry in metricValues). The accessors read through the views; a
+    // copy owns copies of the owned arrays and shares the mapping.
+    struct CellArrays {
+        std::vector<std::vector<Value>> metricValues;  // [metric][ticker * steps + yearOffset * periods + period]
+        std::vector<int> cellSectors;                  // sector id per cell, -1 when unknown
+        std::vector<uint8_t> cellPresent;              // 1 when the table has a row for the cell
+        std::vector<const Value*> columnData;
+        const int* sectorData = nullptr;
+        const uint8_t* presentData = nullptr;
+        size_t cells = 0;
+        std::shared_ptr<const void> mapping;           // keeps a mapped snapshot alive
+        
+        CellArrays() = default;
+        CellArrays(CellArrays&&) = default;
+        CellArrays& operator=(CellArrays&&) = default;
+        
+        CellArrays(const CellArrays& other)
+            : metricValues(other.metricValues), cellSectors(other.cellSectors), cellPresent(other.cellPresent),
+              columnData(other.columnData), sectorData(other.sectorData), presentData(other.presentData),
+              cells(other.cells), mapping(other.mapping) {
+            for (size_t m = 0; m < columnData.size(); ++m) {
+                if (other.columnData[m] == other.metricValues[m].data()) columnData[m] = metricValues[m].data();
+            }
+            if (other.sectorData == other.cellSectors.data()) sectorData = cellSectors.data();
+            if (other.presentData == other.cellPresent.data()) presentData = cellPresent.data();
+        }
+        
+        CellArrays& operator=(const CellArrays& other) {
+            CellArrays copy(other);
+            return *this = std::move(copy);
+        }
+    };
+    CellArrays store;
+    
+    size_t cell(int tickerId, int year, int period = 0) const {
+        return static_cast<size_t>(tickerId) * steps + (year - firstYear) * periods + period;
+    }
+    
+    // Sizes the dense arrays once the tickers, year range and resolution are known
+    void allocate(int lastYear, size_t metricCount) {
+        years = lastYear - firstYear + 1;
+        steps = years * periods;
+        size_t cells = tickers.size() * static_cast<size_t>(steps);
+        store.cells = cells;
+        store.cellSectors.assign(cells, -1);
+        store.cellPresent.assign(cells, 0);
+        store.metricValues.assign(metricCount, std::vector<Value>(cells, missing));
+        
+        // Filled in place from here on, so the views stay valid
+        store.columnData.clear();
+        for (const auto& values : store.metricValues) store.columnData.push_back(values.data());
+        store.sectorData = store.cellSectors.data();
+        store.presentData = store.cellPresent.data();
+    }
+    
+    static int intern(const std::string& name, std::vector<std::string>& names,
+                      std::unordered_map<std::string, int>& ids) {
+        auto it = ids.find(name);
+        if (it != ids.end()) return it->second;
+        int id = static_cast<int>(names.size());
+        names.push_back(name);
+        ids.emplace(name, id);
+        return id;
+    }
+    
+    static constexpr uint64_t rowsPerRange = 65536; // smallest rowid range worth its own connection
+    
+    // withRange adds "rowid >= ? AND rowid < ?", which keeps rowid order like the full scan
+    static std::string loadQuery(const std::string& table, const std::vector<std::string>& metrics,
+                                 bool withSector, bool withRange) {
+        std::string query = "SELECT ticker, year";
+        if (withSector) query += ", sector";
+        for (const auto& metric : metrics) query += ", " + Database::quoteIdentifier(metric);
+        query += " FROM " + Database::quoteIdentifier(table) + " WHERE ";
+        if (withRange) query += "rowid >= ? AND rowid < ? AND ";
+        return query + "ticker IS NOT NULL AND year IS NOT NULL;";
+    }
+    
+    // Builds the panel from the load query's result, given in row order as one or more parts
+    void build(const std::vector<ColumnarResult>& parts, const std::string& table,
+               const std::vector<std::string>& metrics, bool withSector) {
+        clear();
+        
+        // First pass: intern tickers and find the year range
+        std::vector<std::vector<int>> rowTickers(parts.size());
+        int lastYear = 0;
+        bool anyYear = false;
+        for (size_t p = 0; p < parts.size(); ++p) {
+            const ColumnarResult& result = parts[p];
+            const auto& tickerColumn = result.at("ticker");
+            const auto& yearColumn = result.at("year");
+            rowTickers[p].assign(result.rowCount, -1);
+            for (size_t i = 0; i < result.rowCount; ++i) {
+                if (tickerColumn.isNull(i) || !yearColumn.hasNumber(i) || tickerColumn.type != ColumnarResult::Type::Text) continue;
+                rowTickers[p][i] = intern(tickerColumn.texts[i], tickers, tickerIds);
+                int year = static_cast<int>(yearColumn.number(i));
+                if (!anyYear) {
+                    firstYear = lastYear = year;
+                    anyYear = true;
+                }
+                firstYear = std::min(firstYear, year);
+                lastYear = std::max(lastYear, year);
+            }
+        }
+        
+        sourceTable = table;
+        if (!anyYear) return;
+        
+        allocate(lastYear, metrics.size());
+        for (const auto& metric : metrics) intern(metric, metricNames, metricIds);
+        
+        // Second pass: scatter each column into the dense arrays
+        for (size_t p = 0; p < parts.size(); ++p) {
+            const ColumnarResult& result = parts[p];
+            const auto& yearColumn = result.at("year");
+            const ColumnarResult::Column* sectorColumn = withSector ? &result.at("sector") : nullptr;
+            for (size_t i = 0; i < result.rowCount; ++i) {
+                if (rowTickers[p][i] < 0) continue;
+                size_t index = cell(rowTickers[p][i], static_cast<int>(yearColumn.number(i)));
+                if (!store.cellPresent[index]) rows++;
+                store.cellPresent[index] = 1;
+                if (sectorColumn && sectorColumn->type == ColumnarResult::Type::Text && !sectorColumn->isNull(i)) {
+                    store.cellSectors[index] = intern(sectorColumn->texts[i], sectorNames, sectorIds);
+                }
+            }
+            
+            for (size_t m = 0; m < metrics.size(); ++m) {
+                const auto& column = result.columns[(withSector ? 3 : 2) + m];
+                auto& values = store.metricValues[m];
+                for (size_t i = 0; i < result.rowCount; ++i) {
+                    if (rowTickers[p][i] < 0 || !column.hasNumber(i)) continue;
+                    values[cell(rowTickers[p][i], static_cast<int>(yearColumn.number(i)))] = static_cast<Value>(column.number(i));
+                }
+            }
+        }
+    }
+    
+    // XBRL tags ingested by GET/Get.py and the wide-table metric names they map to
+    static const std::vector<std::pair<std::string, std::string>>& metricAliases() {
+        static const std::vector<std::pair<std::string, std::string>> aliases = {
+            {"RevenueFromContractWithCustomerExcludingAssessedTax", "revenue"},
+            {"GrossProfit", "gross_profit"},
+            {"OperatingIncomeLoss", "operating_income"},
+            {"NetIncomeLoss", "net_income"},
+            {"EarningsPerShareBasic", "eps"},
+            {"Assets", "total_assets"},
+            {"AssetsCurrent", "current_assets"},
+            {"Liabilities", "total_liabilities"},
+            {"LiabilitiesCurrent", "current_liabilities"},
+            {"StockholdersEquity", "shareholders_equity"},
+            {"CashAndCashEquivalentsAtCarryingValue", "cash"},
+            {"LongTermDebtNoncurrent", "long_term_debt"},
+            {"PaymentsToAcquirePropertyPlantAndEquipment", "capex"},
+            {"NetCashProvidedByUsedInOperatingActivities", "operating_cash_flow"}
+        };
+        return aliases;
+    }
+    
+    static std::string standardMetricName(const std::string& tag) {
+        for (const auto& alias : metricAliases()) {
+            if (alias.first == tag) return alias.second;
+        }
+        return tag;
+    }
+    
+public:
+    static constexpr Value missing = std::numeric_limits<Value>::quiet_NaN();
+    
+    enum class Resolution { Annual, Quarterly };
+    
+    void clear() {
+        *this = BasicPanelStore();
+    }
+    
+    // Bulk-loads ticker, year, optional sector and the given metric columns of a table
+    void load(Database& db, const std::string& table, const std::vector<std::string>& metrics,
+              bool withSector) {
+        std::vector<ColumnarResult> parts;
+        parts.push_back(db.executeColumnar(loadQuery(table, metrics, withSector, false), {}));
+        build(parts, table, metrics, withSector);
+    }
+    
+    // The same panel with the table split into rowid ranges that pool workers
+    // read concurrently, each through its own read-only connection. Small
+    // tables (and WITHOUT ROWID ones) are read in one piece. Every range is
+    // its own read transaction, so a writer committing mid-load can leave the
+    // panel mixing rows from before and after the commit.
+    void load(ConnectionPool& readers, ThreadPool& pool, const std::string& table,
+              const std::vector<std::string>& metrics, bool withSector) {
+        int64_t firstRowid = 0, lastRowid = -1;
+        bool hasRowid = true;
+        {
+            auto reader = readers.acquire();
+            try {
+                auto bounds = reader->executeColumnar(
+                    "SELECT MIN(rowid) AS first, MAX(rowid) AS last FROM " + Database::quoteIdentifier(table) + ";", {});
+                if (bounds.rowCount > 0 && bounds.columns[0].hasNumber(0) && bounds.columns[1].hasNumber(0)) {
+                    firstRowid = static_cast<int64_t>(bounds.columns[0].number(0));
+                    lastRowid = static_cast<int64_t>(bounds.columns[1].number(0));
+                }
+            } catch (const std::exception&) {
+                hasRowid = false;
+            }
+        }
+        
+        uint64_t span = lastRowid >= firstRowid ? static_cast<uint64_t>(lastRowid - firstRowid) + 1 : 0;
+        size_t ranges = std::min<size_t>(std::min<size_t>(readers.maxConnections(), pool.size()),
+                                         static_cast<size_t>(span / rowsPerRange));
+        std::vector<ColumnarResult> parts(std::max<size_t>(ranges, 1));
+        if (!hasRowid || ranges <= 1) {
+            parts[0] = readers.acquire()->executeColumnar(loadQuery(table, metrics, withSector, false), {});
+        } else {
+            const std::string query = loadQuery(table, metrics, withSector, true);
+            pool.parallelFor(0, ranges, 1, [&](size_t begin, size_t end) {
+                auto reader = readers.acquire();
+                for (size_t r = begin; r < end; ++r) {
+                    int64_t from = firstRowid + static_cast<int64_t>(span * r / ranges);
+                    int64_t to = firstRowid + static_cast<int64_t>(span * (r + 1) / ranges);
+                    parts[r] = reader->executeColumnar(query, {from, to});
+                }
+            });
+        }
+        build(parts, table, metrics, withSector);
+    }
+    
+    // Long/EAV layout written by GET/Get.py: one row per (cik, fiscal_year,
+    // fiscal_period, metric_tag, value). Facts of the requested resolution (FY
+    // rows, or Q1..Q4 rows) are pivoted in one ordered scan into the same dense
+    // layout as load(); the cik is the ticker key, known XBRL tags get the
+    // wide-table metric names and, when a fact was stored more than once, the
+    // latest filing wins. Quarterly values are the de-accumulated ones
+    // (value_type 'Quarterly'); Get.py's extra YTD rows are skipped.
+    void loadLongFormat(Database& db, const std::string& table, bool hasFiledDate,
+                        Resolution resolution = Resolution::Annual, bool hasValueType = false) {
+        clear();
+        const bool quarterly = resolution == Resolution::Quarterly;
+        periods = quarterly ? 4 : 1;
+        
+        struct Fact {
+            int tickerId;
+            int year;
+            int period;
+            int metric;
+            double value;
+        };
+        std::vector<Fact> facts;
+        std::vector<std::string> tagNames;
+        std::unordered_map<std::string, int> tagIds;
+        std::string lastCik;
+        int lastTicker = -1;
+        
+        std::string query = "SELECT cik, fiscal_year, metric_tag, value, fiscal_period FROM " +
+            Database::quoteIdentifier(table) +
+            (quarterly ? std::string(" WHERE fiscal_period IN ('Q1', 'Q2', 'Q3', 'Q4')") +
+                             (hasValueType ? " AND value_type = 'Quarterly'" : "")
+                       : std::string(" WHERE fiscal_period = 'FY'")) +
+            " AND cik IS NOT NULL AND fiscal_year IS NOT NULL"
+            " AND metric_tag IS NOT NULL AND value IS NOT NULL"
+            " ORDER BY cik, fiscal_year, metric_tag" + std::string(quarterly ? ", fiscal_period" : "") +
+            std::string(hasFiledDate ? ", filed_date" : "") + ", rowid;";
+        
+        db.forEachRow(query, {}, [&](sqlite3_stmt* stmt) {
+            int valueType = sqlite3_column_type(stmt, 3);
+            if (valueType != SQLITE_INTEGER && valueType != SQLITE_FLOAT) return;
+            
+            const char* cik = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+            if (lastTicker < 0 || lastCik != cik) {
+                lastCik = cik;
+                lastTicker = intern(lastCik, tickers, tickerIds);
+            }
+            const char* tag = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
+            const char* fiscalPeriod = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4));
+            int period = quarterly ? fiscalPeriod[1] - '1' : 0;
+            int metric = intern(standardMetricName(tag), tagNames, tagIds);
+            facts.push_back({lastTicker, sqlite3_column_int(stmt, 1), period, metric, sqlite3_column_double(stmt, 3)});
+        });
+        
+        sourceTable = table;
+        if (facts.empty()) return;
+        
+        // Known metrics first, in wide-table order, then the remaining tags
+        std::vector<int> remap(tagNames.size(), -1);
+        for (const auto& alias : metricAliases()) {
+            auto it = tagIds.find(alias.second);
+            if (it != tagIds.end() && remap[it->second] < 0) {
+                remap[it->second] = intern(alias.second, metricNames, metricIds);
+            }
+        }
+        for (size_t m = 0; m < tagNames.size(); ++m) {
+            if (remap[m] < 0) remap[m] = intern(tagNames[m], metricNames, metricIds);
+        }
+        
+        auto range = std::minmax_element(facts.begin(), facts.end(),
+                                         [](const Fact& a, const Fact& b) { return a.year < b.year; });
+        firstYear = range.first->year;
+        allocate(range.second->year, metricNames.size());
+        
+        for (const auto& fact : facts) {
+            size_t index = cell(fact.tickerId, fact.year, fact.period);
+            if (!store.cellPresent[index]) rows++;
+            store.cellPresent[index] = 1;
+            store.metricValues[remap[fact.metric]][index] = static_cast<Value>(fact.value);
+        }
+    }
+    
+    bool loaded() const { return !sourceTable.empty(); }
+    const std::string& table() const { return sourceTable; }
+    size_t rowCount() const { return rows; }
+    size_t tickerCount() const { return tickers.size(); }
+    size_t metricCount() const { return metricNames.size(); }
+    int yearCount() const { return years; }
+    int minYear() const { return firstYear; }
+    int maxYear() const { return firstYear + years - 1; }
+    int periodsPerYear() const { return periods; }
+    int periodCount() const { return steps; }
+    
+    const std::vector<std::string>& tickerNames() const { return tickers; }
+    const std::vector<std::string>& sectors() const { return sectorNames; }
+    const std::vector<std::string>& metrics() const { return metricNames; }
+    const std::string& tickerName(int tickerId) const { return tickers[tickerId]; }
+    
+    int tickerId(const std::string& ticker) const {
+        auto it = tickerIds.find(ticker);
+        return it == tickerIds.end() ? -1 : it->second;
+    }
+    
+    int sectorId(const std::string& sector) const {
+        auto it = sectorIds.find(sector);
+        return it == sectorIds.end() ? -1 : it->second;
+    }
+    
+    int metricId(const std::string& metric) const {
+        auto it = metricIds.find(metric);
+        return it == metricIds.end() ? -1 : it->second;
+    }
+    
+    bool inRange(int year) const {
+        return years > 0 && year >= firstYear && year < firstYear + years;
+    }
+    
+    // period is the 0-based quarter on a quarterly panel and always 0 on an annual one
+    bool hasRow(int tickerId, int year, int period = 0) const {
+        return tickerId >= 0 && inRange(year) && store.presentData[cell(tickerId, year, period)];
+    }
+    
+    int sectorOf(int tickerId, int year, int period = 0) const {
+        return tickerId >= 0 && inRange(year) ? store.sectorData[cell(tickerId, year, period)] : -1;
+    }
+    
+    double value(int metricId, int tickerId, int year, int period = 0) const {
+        if (metricId < 0 || tickerId < 0 || !inRange(year)) return missing;
+        return store.columnData[metricId][cell(tickerId, year, period)];
+    }
+    
+    // Raw cell arrays for column-at-a-time kernels;
+    // cell = tickerId * periodCount() + (year - minYear()) * periodsPerYear() + period
+    size_t cellCount() const { return store.cells; }
+    const Value* column(int metricId) const { return store.columnData[metricId]; }
+    const uint8_t* presentCells() const { return store.presentData; }
+    const int* sectorCells() const { return store.sectorData; }
+    int cellTicker(size_t index) const { return static_cast<int>(index / steps); }
+    int cellYear(size_t index) const { return firstYear + static_cast<int>(index % steps) / periods; }
+    int cellPeriod(size_t index) const { return static_cast<int>(index % steps) % periods; }
+    
+    // "FY" on an annual panel, "Q1".."Q4" on a quarterly one
+    std::string periodLabel(int period) const {
+        return periods == 1 ? "FY" : "Q" + std::to_string(period + 1);
+    }
+    
+    // Stores a column computed from the loaded ones (e.g. a ratio) as another metric,
+    // listed after the loaded metrics; replaces an earlier derived column of that name
+    int addDerivedColumn(const std::string& name, std::vector<Value> values) {
+        if (values.size() != cellCount()) {
+            throw std::invalid_argument("derived column '" + name + "' has the wrong size");
+        }
+        int id = metricId(name);
+        if (id >= 0) {
+            if (!isDerived(id)) throw std::invalid_argument("column '" + name + "' is already loaded");
+            store.metricValues[id] = std::move(values);
+            store.columnData[id] = store.metricValues[id].data();
+            return id;
+        }
+        id = intern(name, metricNames, metricIds);
+        store.metricValues.push_back(std::move(values));
+        store.columnData.push_back(store.metricValues.back().data());
+        derivedColumns++;
+        return id;
+    }
+    
+    bool isDerived(int metricId) const {
+        return metricId >= static_cast<int>(metricNames.size() - derivedColumns);
+    }
+    
+    size_t derivedCount() const { return derivedColumns; }
+    
+    // True when the cells are read from a memory-mapped snapshot
+    bool mapped() const { return store.mapping != nullptr; }
+    
+    // periodCount() contiguous values for one ticker, starting at minYear()'s first period
+    const Value* series(int metricId, int tickerId) const {
+        return store.columnData[metricId] + static_cast<size_t>(tickerId) * steps;
+    }
+    
+    // Years with a row for the ticker (in any period), newest first, at most limit of them
+    std::vector<int> recentYears(int tickerId, int limit) const {
+        std::vector<int> result;
+        if (tickerId < 0) return result;
+        for (int year = maxYear(); year >= firstYear && static_cast<int>(result.size()) < limit; --year) {
+            for (int period = 0; period < periods; ++period) {
+                if (store.presentData[cell(tickerId, year, period)]) {
+                    result.push_back(year);
+                    break;
+                }
+            }
+        }
+        return result;
+    }
+};
+
+using PanelStore = BasicPanelStore<double>;
+using CompactPanelStore = BasicPanelStore<float>; // float32 cells, e.g. for quarterly history
@@ -0,0 +1,232 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Opt-in instrumentation of the hot paths: scoped timers per named stage and
+// process-wide counters. While disabled (the default) a Scope costs one relaxed
+// atomic load and add() is a no-op. Timings are kept per thread, so pool
+// workers never contend; report() and writeChromeTrace() merge them and are
+// meant to run once the work is done. Stage names must be string literals.
+class Profiler {
+public:
+    enum class Counter { RowsRead, BytesConverted, PathsSimulated, ValuesFormatted };
+
+private:
+    static constexpr size_t counterCount = 4;
+    static constexpr size_t maxEventsPerThread = 1 << 20; // trace events kept per thread
+
+    struct Totals {
+        uint64_t calls = 0;
+        int64_t totalNs = 0;
+        int64_t selfNs = 0; // total minus time spent in nested stages
+        int64_t maxNs = 0;
+    };
+
+    struct Event {
+        const char* name;
+        int64_t startNs;
+        int64_t durationNs;
+    };
+
+    struct ThreadBuffer {
+        uint32_t threadId = 0;
+        std::mutex lock;
+        std::map<const char*, Totals> totals; // keyed by literal address
+        std::vector<Event> events;
+        std::vector<int64_t> childNs;         // open scopes: time spent in their children
+        uint64_t droppedEvents = 0;
+    };
+
+    struct State {
+        std::atomic<bool> enabled{false};
+        std::atomic<bool> tracing{false};
+        std::atomic<uint64_t> counters[counterCount] = {};
+        std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+        std::mutex lock;
+        std::vector<std::shared_ptr<ThreadBuffer>> threads;
+    };
+
+    static State& state() {
+        static State instance;
+        return instance;
+    }
+
+    // Registered on first use; the registry keeps it alive after the thread exits
+    static ThreadBuffer& local() {
+        thread_local std::shared_ptr<ThreadBuffer> buffer;
+        if (!buffer) {
+            buffer = std::make_shared<ThreadBuffer>();
+            std::lock_guard<std::mutex> guard(state().lock);
+            buffer->threadId = static_cast<uint32_t>(state().threads.size());
+            state().threads.push_back(buffer);
+        }
+        return *buffer;
+    }
+
+    static int64_t now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - state().epoch).count();
+    }
+
+    static const char* counterName(size_t counter) {
+        static const char* const names[counterCount] = {"rows read", "bytes converted", "paths simulated",
+                                                         "values formatted"};
+        return names[counter];
+    }
+
+    // Per-stage totals of every thread, merged by stage name
+    static std::vector<std::pair<std::string, Totals>> mergedTotals() {
+        std::map<std::string, Totals> merged;
+        std::lock_guard<std::mutex> guard(state().lock);
+        for (const auto& thread : state().threads) {
+            std::lock_guard<std::mutex> threadGuard(thread->lock);
+            for (const auto& [name, totals] : thread->totals) {
+                Totals& target = merged[name];
+                target.calls += totals.calls;
+                target.totalNs += totals.totalNs;
+                target.selfNs += totals.selfNs;
+                target.maxNs = std::max(target.maxNs, totals.maxNs);
+            }
+        }
+        std::vector<std::pair<std::string, Totals>> stages(merged.begin(), merged.end());
+        std::sort(stages.begin(), stages.end(),
+                  [](const auto& a, const auto& b) { return a.second.selfNs > b.second.selfNs; });
+        return stages;
+    }
+
+    static void jsonString(std::ostream& out, const char* text) {
+        out << '"';
+        for (; *text; ++text) {
+            if (*text == '"' || *text == '\\') out << '\\';
+            out << *text;
+        }
+        out << '"';
+    }
+
+public:
+    // Times one stage from construction to destruction
+    class Scope {
+    private:
+        const char* name;
+        int64_t start = -1;
+
+    public:
+        explicit Scope(const char* stageName) : name(stageName) {
+            if (!enabled()) return;
+            local().childNs.push_back(0);
+            start = now();
+        }
+
+        ~Scope() {
+            if (start < 0) return;
+            int64_t duration = now() - start;
+            ThreadBuffer& buffer = local();
+            std::lock_guard<std::mutex> guard(buffer.lock);
+            int64_t children = buffer.childNs.back();
+            buffer.childNs.pop_back();
+            if (!buffer.childNs.empty()) buffer.childNs.back() += duration;
+
+            Totals& totals = buffer.totals[name];
+            totals.calls++;
+            totals.totalNs += duration;
+            totals.selfNs += duration - children;
+            totals.maxNs = std::max(totals.maxNs, duration);
+            if (state().tracing.load(std::memory_order_relaxed)) {
+                if (buffer.events.size() < maxEventsPerThread) {
+                    buffer.events.push_back({name, start, duration});
+                } else {
+                    buffer.droppedEvents++;
+                }
+            }
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    };
+
+    // trace = also keep every scope as an event for writeChromeTrace()
+    static void enable(bool trace = false) {
+        state().tracing.store(trace, std::memory_order_relaxed);
+        state().enabled.store(true, std::memory_order_relaxed);
+    }
+
+    static bool enabled() { return state().enabled.load(std::memory_order_relaxed); }
+
+    static void add(Counter counter, uint64_t amount) {
+        if (!enabled()) return;
+        state().counters[static_cast<size_t>(counter)].fetch_add(amount, std::memory_order_relaxed);
+    }
+
+    // Per-stage breakdown, largest self time first, then the counters
+    static void report(std::ostream& out) {
+        auto stages = mergedTotals();
+        double wallMs = now() / 1e6;
+        std::ios saved(nullptr);
+        saved.copyfmt(out);
+
+        out << "\n=== PROFILE (" << std::fixed << std::setprecision(1) << wallMs << " ms since start) ===\n";
+        out << std::left << std::setw(28) << "Stage" << std::right << std::setw(10) << "Calls" << std::setw(12)
+            << "Total ms" << std::setw(12) << "Self ms" << std::setw(8) << "Self%" << std::setw(12) << "Mean us"
+            << std::setw(12) << "Max us" << "\n";
+        for (const auto& [name, totals] : stages) {
+            out << std::left << std::setw(28) << name << std::right << std::setw(10) << totals.calls
+                << std::setprecision(2) << std::setw(12) << totals.totalNs / 1e6 << std::setw(12) << totals.selfNs / 1e6
+                << std::setprecision(1) << std::setw(7) << (wallMs > 0 ? totals.selfNs / 1e6 / wallMs * 100 : 0.0) << "%"
+                << std::setw(12) << totals.totalNs / 1e3 / static_cast<double>(totals.calls)
+                << std::setw(12) << totals.maxNs / 1e3 << "\n";
+        }
+        out << "Counters:";
+        for (size_t c = 0; c < counterCount; ++c) {
+            out << (c ? ", " : " ") << counterName(c) << " = "
+                << state().counters[c].load(std::memory_order_relaxed);
+        }
+        out << "\n";
+        out.copyfmt(saved);
+    }
+
+    // Chrome trace event format ("X" events, microseconds), for chrome://tracing
+    // or Perfetto. Returns false when the file cannot be written.
+    static bool writeChromeTrace(const std::string& path) {
+        std::ofstream out(path);
+        if (!out) return false;
+        out << "{\"traceEvents\":[";
+        bool first = true;
+        uint64_t dropped = 0;
+        {
+            std::lock_guard<std::mutex> guard(state().lock);
+            for (const auto& thread : state().threads) {
+                std::lock_guard<std::mutex> threadGuard(thread->lock);
+                dropped += thread->droppedEvents;
+                for (const auto& event : thread->events) {
+                    out << (first ? "\n" : ",\n") << "{\"name\":";
+                    jsonString(out, event.name);
+                    out << ",\"cat\":";
+                    std::string category(event.name, std::strcspn(event.name, "."));
+                    jsonString(out, category.c_str());
+                    out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread->threadId << std::fixed << std::setprecision(3)
+                        << ",\"ts\":" << event.startNs / 1e3 << ",\"dur\":" << event.durationNs / 1e3 << "}";
+                    first = false;
+                }
+            }
+        }
+        out << "\n],\"displayTimeUnit\":\"ms\",\"otherData\":{";
+        for (size_t c = 0; c < counterCount; ++c) {
+            out << (c ? "," : "") << "\"" << counterName(c) << "\":" << state().counters[c].load(std::memory_order_relaxed);
+        }
+        out << ",\"dropped events\":" << dropped << "}}\n";
+        return static_cast<bool>(out);
+    }
+};
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "PanelStore.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <string>
+#include <vector>
+
+// numerator / denominator * scale; undefined (NaN) when an input is missing or
+// the denominator is zero
+struct RatioDefinition {
+    const char* name;
+    const char* numerator;
+    const char* denominator;
+    double scale;
+};
+
+// Computes the standard ratio set for every ticker-year of a panel at once and
+// stores each ratio as a derived panel column, so the screener, sector
+// aggregates and ranking can use "net_margin" like any loaded metric.
+class RatioEngine {
+private:
+    static constexpr size_t cellsPerTask = 16384;
+
+    // Branch-free: the division runs for every cell and invalid cells are masked afterwards
+    static void ratioKernel(const double* numerator, const double* denominator, double scale,
+                            double* out, size_t begin, size_t end) {
+        const double undefined = std::numeric_limits<double>::quiet_NaN();
+        for (size_t i = begin; i < end; ++i) {
+            double ratio = numerator[i] / denominator[i] * scale;
+            out[i] = denominator[i] != 0.0 ? ratio : undefined;
+        }
+    }
+
+public:
+    static const std::vector<RatioDefinition>& definitions() {
+        static const std::vector<RatioDefinition> ratios = {
+            {"gross_margin", "gross_profit", "revenue", 100.0},
+            {"operating_margin", "operating_income", "revenue", 100.0},
+            {"ebitda_margin", "ebitda", "revenue", 100.0},
+            {"net_margin", "net_income", "revenue", 100.0},
+            {"fcf_margin", "free_cash_flow", "revenue", 100.0},
+            {"current_ratio", "current_assets", "current_liabilities", 1.0},
+            {"debt_ratio", "total_liabilities", "total_assets", 100.0},
+            {"debt_to_equity", "total_liabilities", "shareholders_equity", 1.0},
+            {"debt_to_ebitda", "long_term_debt", "ebitda", 1.0},
+            {"roe", "net_income", "shareholders_equity", 100.0},
+            {"roa", "operating_income", "total_assets", 100.0}, // operating ROA, as the ratio report always showed
+        };
+        return ratios;
+    }
+
+    // Adds every ratio whose inputs the panel has; work is split into
+    // (ratio, cell chunk) tasks on the pool. Returns the ratios computed.
+    static std::vector<std::string> computeAll(PanelStore& panel, ThreadPool& pool) {
+        struct Job {
+            const RatioDefinition* definition;
+            const double* numerator;
+            const double* denominator;
+            std::vector<double> values;
+        };
+
+        std::vector<Job> jobs;
+        for (const auto& definition : definitions()) {
+            int numerator = panel.metricId(definition.numerator);
+            int denominator = panel.metricId(definition.denominator);
+            int existing = panel.metricId(definition.name);
+            if (numerator < 0 || denominator < 0 || (existing >= 0 && !panel.isDerived(existing))) continue;
+            jobs.push_back({&definition, panel.column(numerator), panel.column(denominator),
+                            std::vector<double>(panel.cellCount())});
+        }
+
+        const size_t cells = panel.cellCount();
+        if (cells > 0) {
+            pool.parallelFor(0, jobs.size() * cells, cellsPerTask, [&](size_t begin, size_t end) {
+                while (begin < end) {
+                    size_t job = begin / cells;
+                    size_t offset = begin % cells;
+                    size_t stop = std::min(end, (job + 1) * cells);
+                    Job& target = jobs[job];
+                    ratioKernel(target.numerator, target.denominator, target.definition->scale,
+                                target.values.data(), offset, offset + (stop - begin));
+                    begin = stop;
+                }
+            });
+        }
+
+        std::vector<std::string> computed;
+        for (auto& job : jobs) {
+            panel.addDerivedColumn(job.definition->name, std::move(job.values));
+            computed.push_back(job.definition->name);
+        }
+        return computed;
+    }
+};
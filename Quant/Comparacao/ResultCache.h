@@ -0,0 +1,197 @@
+#pragma once
+
+#include "Database.h"
+#include <charconv>
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
+#include <iomanip>
+#include <list>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+// Named results (statistics) of repeated feature runs, keyed by a canonical
+// request string. Keys carry everything a result depends on (feature, ticker,
+// metric, parameters, seed) plus a fingerprint of the input rows, so a result
+// computed before an ingestion that changed those rows can never be returned.
+// In memory it is an LRU bounded by an estimate of its size in bytes; with
+// persistTo() misses fall back to (and stores write through to) the
+// result_cache table of a separate database file, so later runs of the same
+// request are served as well while the analyzed database (and any panel
+// snapshot validated against it) is never written.
+// Not thread-safe: use it from the analyzer thread only.
+class ResultCache {
+public:
+    using Values = std::map<std::string, double>;
+
+private:
+    struct Entry {
+        std::string key;
+        Values values;
+        size_t bytes;
+    };
+
+    std::list<Entry> entries; // most recently used first
+    std::unordered_map<std::string, std::list<Entry>::iterator> index;
+    size_t capacityBytes;
+    size_t usedBytes = 0;
+    size_t hitCount = 0;
+    size_t missCount = 0;
+    std::unique_ptr<Database> backing; // file holding the result_cache table, when persistent
+
+    // Rough heap footprint: key twice (list + index) and one map node per value
+    static size_t entryBytes(const std::string& key, const Values& values) {
+        size_t bytes = sizeof(Entry) + 2 * key.size() + 64;
+        for (const auto& [name, value] : values) bytes += name.size() + sizeof(value) + 48;
+        return bytes;
+    }
+
+    void remember(const std::string& key, Values values) {
+        auto found = index.find(key);
+        if (found != index.end()) {
+            usedBytes -= found->second->bytes;
+            entries.erase(found->second);
+            index.erase(found);
+        }
+        size_t bytes = entryBytes(key, values);
+        if (bytes > capacityBytes) return;
+        entries.push_front(Entry{key, std::move(values), bytes});
+        index.emplace(key, entries.begin());
+        usedBytes += bytes;
+        while (usedBytes > capacityBytes) {
+            usedBytes -= entries.back().bytes;
+            index.erase(entries.back().key);
+            entries.pop_back();
+        }
+    }
+
+    // "name=value;..." with shortest round-trip numbers
+    static std::string encode(const Values& values) {
+        std::string text;
+        char number[32];
+        for (const auto& [name, value] : values) {
+            auto result = std::to_chars(number, number + sizeof(number), value);
+            text += name;
+            text += '=';
+            text.append(number, result.ptr);
+            text += ';';
+        }
+        return text;
+    }
+
+    static Values decode(const std::string& text) {
+        Values values;
+        size_t start = 0;
+        while (start < text.size()) {
+            size_t equals = text.find('=', start);
+            size_t end = text.find(';', start);
+            if (equals == std::string::npos || end == std::string::npos || equals > end) break;
+            values[text.substr(start, equals - start)] = std::strtod(text.c_str() + equals + 1, nullptr);
+            start = end + 1;
+        }
+        return values;
+    }
+
+public:
+    explicit ResultCache(size_t maxBytes = 8u << 20) : capacityBytes(maxBytes) {}
+
+    // "part|part|..." with numbers written at full precision
+    template <typename... Parts>
+    static std::string makeKey(const Parts&... parts) {
+        std::ostringstream key;
+        key << std::setprecision(17);
+        ((key << parts << '|'), ...);
+        std::string text = key.str();
+        text.pop_back();
+        return text;
+    }
+
+    // FNV-1a over raw bytes; chain calls through `hash` to cover several arrays
+    static uint64_t fingerprint(const void* data, size_t bytes, uint64_t hash = 1469598103934665603ull) {
+        const unsigned char* byte = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < bytes; ++i) {
+            hash = (hash ^ byte[i]) * 1099511628211ull;
+        }
+        return hash;
+    }
+
+    // Backs the cache with the result_cache table of the database file at `path`
+    // (created if needed; empty = memory only) and drops all but the maxRows most
+    // recently stored rows. False when the file or table cannot be created; the
+    // cache then stays in memory.
+    bool persistTo(const std::string& path, size_t maxRows = 100000) {
+        backing.reset();
+        if (path.empty()) return true;
+        try {
+            auto database = std::make_unique<Database>(path);
+            database->execute(
+                "CREATE TABLE IF NOT EXISTS result_cache ("
+                "cache_key TEXT PRIMARY KEY, "
+                "result TEXT NOT NULL, "
+                "used_at INTEGER NOT NULL) WITHOUT ROWID;");
+            database->executeUpdate(
+                "DELETE FROM result_cache WHERE cache_key NOT IN "
+                "(SELECT cache_key FROM result_cache ORDER BY used_at DESC LIMIT ?);",
+                {static_cast<int64_t>(maxRows)});
+            backing = std::move(database);
+        } catch (const std::exception&) {
+            return false;
+        }
+        return true;
+    }
+
+    bool persistent() const { return backing != nullptr; }
+
+    // The cache file, for a Database::Transaction around many store() calls; nullptr when in memory
+    Database* database() const { return backing.get(); }
+
+    // Cached values for key, or nullptr; valid until the next store() or clear()
+    const Values* find(const std::string& key) {
+        auto found = index.find(key);
+        if (found != index.end()) {
+            entries.splice(entries.begin(), entries, found->second);
+            hitCount++;
+            return &found->second->values;
+        }
+
+        if (backing) {
+            auto rows = backing->executeColumnar("SELECT result FROM result_cache WHERE cache_key = ?;", {key});
+            if (rows.rowCount == 1) {
+                remember(key, decode(rows.columns[0].texts[0]));
+                found = index.find(key);
+                if (found != index.end()) {
+                    hitCount++;
+                    return &found->second->values;
+                }
+            }
+        }
+        missCount++;
+        return nullptr;
+    }
+
+    // Callers storing many results should wrap the calls in one Database::Transaction on database()
+    void store(const std::string& key, Values values) {
+        if (backing) {
+            backing->executeUpdate(
+                "INSERT OR REPLACE INTO result_cache (cache_key, result, used_at) VALUES (?, ?, ?);",
+                {key, encode(values), static_cast<int64_t>(std::time(nullptr))});
+        }
+        remember(key, std::move(values));
+    }
+
+    // Forgets the in-memory entries; persisted rows stay
+    void clear() {
+        entries.clear();
+        index.clear();
+        usedBytes = 0;
+    }
+
+    size_t size() const { return entries.size(); }
+    size_t bytes() const { return usedBytes; }
+    size_t hits() const { return hitCount; }
+    size_t misses() const { return missCount; }
+};
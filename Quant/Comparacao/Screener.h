@@ -0,0 +1,542 @@
+#pragma once
+
+#include "Database.h"
+#include "PanelStore.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+// One matching ticker-year; rankValue is the ORDER BY metric (NaN without ranking)
+struct ScreenMatch {
+    int tickerId;
+    int year;
+    double rankValue;
+};
+
+// Compiles screening conditions such as
+//   revenue > 1000 AND (net_income > 500 OR sector = 'Technology') ORDER BY revenue DESC LIMIT 10
+// into a small AST bound to PanelStore columns, and evaluates it one column at a
+// time: every comparison is a tight loop over a contiguous double array that
+// packs its results into 64-cell mask words, and AND/OR/NOT combine whole words.
+// Missing values follow SQL's three-valued logic (a NULL comparison is neither
+// true nor false, so NOT does not select it). The condition never reaches SQLite.
+class Screener {
+public:
+    enum class CompareOp { Less, LessEqual, Greater, GreaterEqual, Equal, NotEqual };
+
+    struct Operand {
+        const double* column = nullptr; // nullptr for a constant
+        double constant = 0.0;
+    };
+
+    struct Node {
+        enum class Kind { Compare, TextMatch, Constant, And, Or, Not };
+        Kind kind = Kind::Constant;
+        CompareOp op = CompareOp::Equal;
+        Operand left, right;            // Compare
+        const int* ids = nullptr;       // TextMatch: per-cell ticker or sector id (-1 = unknown)
+        int textId = -1;                // TextMatch: id of the literal, -1 when absent from the panel
+        bool value = false;             // Constant
+        std::unique_ptr<Node> first, second;
+    };
+
+    struct Query {
+        std::unique_ptr<Node> condition; // nullptr selects every row
+        int rankMetric = -1;
+        bool descending = false;
+        size_t limit = 0;                // 0 = all matches
+    };
+
+private:
+    // Cells where a comparison is true / false; cells in neither are unknown (NULL)
+    struct Truth {
+        std::vector<uint64_t> yes;
+        std::vector<uint64_t> no;
+    };
+
+    struct Token {
+        enum class Type { Identifier, Number, String, Symbol, End };
+        Type type;
+        std::string text;
+        size_t position;
+    };
+
+    const PanelStore& panel;
+    std::unordered_set<std::string> tableColumns; // copied: catalog schemas are freed on refresh
+    std::vector<double> yearCells;
+    std::vector<int> tickerCells;
+    std::vector<int> tickerRank;        // position of each ticker in name order
+    size_t words = 0;
+
+    // ---- parsing -----------------------------------------------------------
+
+    static std::vector<Token> tokenize(const std::string& text) {
+        std::vector<Token> tokens;
+        size_t i = 0;
+        while (i < text.size()) {
+            char c = text[i];
+            if (std::isspace(static_cast<unsigned char>(c))) {
+                ++i;
+            } else if (std::isalpha(static_cast<unsigned char>(c)) || c == '_') {
+                size_t start = i;
+                while (i < text.size() && (std::isalnum(static_cast<unsigned char>(text[i])) || text[i] == '_')) ++i;
+                tokens.push_back({Token::Type::Identifier, text.substr(start, i - start), start});
+            } else if (std::isdigit(static_cast<unsigned char>(c)) || (c == '.' && i + 1 < text.size() &&
+                                                                    std::isdigit(static_cast<unsigned char>(text[i + 1])))) {
+                size_t start = i;
+                char* end = nullptr;
+                std::strtod(text.c_str() + i, &end);
+                i = static_cast<size_t>(end - text.c_str());
+                tokens.push_back({Token::Type::Number, text.substr(start, i - start), start});
+            } else if (c == '\'' || c == '"') {
+                // 'text' is a string literal, "name" a quoted identifier; doubled quotes escape
+                size_t start = i++;
+                std::string value;
+                for (;;) {
+                    if (i >= text.size()) throw std::invalid_argument("unterminated quote at position " + std::to_string(start));
+                    if (text[i] == c) {
+                        if (i + 1 < text.size() && text[i + 1] == c) {
+                            value += c;
+                            i += 2;
+                            continue;
+                        }
+                        ++i;
+                        break;
+                    }
+                    value += text[i++];
+                }
+                tokens.push_back({c == '\'' ? Token::Type::String : Token::Type::Identifier, value, start});
+            } else {
+                static const char* symbols[] = {">=", "<=", "<>", "!=", "==", ">", "<", "=", "(", ")", "-"};
+                bool matched = false;
+                for (const char* symbol : symbols) {
+                    size_t length = std::char_traits<char>::length(symbol);
+                    if (text.compare(i, length, symbol) == 0) {
+                        tokens.push_back({Token::Type::Symbol, symbol, i});
+                        i += length;
+                        matched = true;
+                        break;
+                    }
+                }
+                if (!matched) {
+                    throw std::invalid_argument("unexpected character '" + std::string(1, c) +
+                                                "' at position " + std::to_string(i));
+                }
+            }
+        }
+        tokens.push_back({Token::Type::End, "", text.size()});
+        return tokens;
+    }
+
+    static bool isKeyword(const Token& token, const char* keyword) {
+        if (token.type != Token::Type::Identifier) return false;
+        std::string upper = token.text;
+        std::transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
+        return upper == keyword;
+    }
+
+    // A parsed comparison operand before it is folded into a Node
+    struct Term {
+        enum class Type { Column, Constant, Text, TextField } type = Type::Constant;
+        Operand operand;
+        std::string text;          // Text literal
+        const int* ids = nullptr;  // TextField
+        bool sector = false;       // TextField: sector (true) or ticker (false)
+        std::string name;
+    };
+
+    class Parser {
+    private:
+        const Screener& screener;
+        std::vector<Token> tokens;
+        size_t next = 0;
+
+        const Token& peek() const { return tokens[next]; }
+        const Token& take() { return tokens[next++]; }
+
+        [[noreturn]] void fail(const std::string& message) const {
+            throw std::invalid_argument(message + " at position " + std::to_string(peek().position));
+        }
+
+        bool acceptSymbol(const char* symbol) {
+            if (peek().type == Token::Type::Symbol && peek().text == symbol) {
+                ++next;
+                return true;
+            }
+            return false;
+        }
+
+        bool acceptKeyword(const char* keyword) {
+            if (isKeyword(peek(), keyword)) {
+                ++next;
+                return true;
+            }
+            return false;
+        }
+
+        bool atClauseEnd() const {
+            return peek().type == Token::Type::End || isKeyword(peek(), "ORDER") || isKeyword(peek(), "LIMIT");
+        }
+
+        static std::unique_ptr<Node> combine(Node::Kind kind, std::unique_ptr<Node> first, std::unique_ptr<Node> second) {
+            auto node = std::make_unique<Node>();
+            node->kind = kind;
+            node->first = std::move(first);
+            node->second = std::move(second);
+            return node;
+        }
+
+        std::unique_ptr<Node> parseOr() {
+            auto node = parseAnd();
+            while (acceptKeyword("OR")) node = combine(Node::Kind::Or, std::move(node), parseAnd());
+            return node;
+        }
+
+        std::unique_ptr<Node> parseAnd() {
+            auto node = parseNot();
+            while (acceptKeyword("AND")) node = combine(Node::Kind::And, std::move(node), parseNot());
+            return node;
+        }
+
+        std::unique_ptr<Node> parseNot() {
+            if (acceptKeyword("NOT")) return combine(Node::Kind::Not, parseNot(), nullptr);
+            if (acceptSymbol("(")) {
+                auto node = parseOr();
+                if (!acceptSymbol(")")) fail("expected ')'");
+                return node;
+            }
+            return parseComparison();
+        }
+
+        Term parseTerm() {
+            Term term;
+            const Token& token = peek();
+            if (acceptSymbol("-")) {
+                if (peek().type != Token::Type::Number) fail("expected a number after '-'");
+                term.type = Term::Type::Constant;
+                term.operand.constant = -std::strtod(take().text.c_str(), nullptr);
+            } else if (token.type == Token::Type::Number) {
+                term.type = Term::Type::Constant;
+                term.operand.constant = std::strtod(take().text.c_str(), nullptr);
+            } else if (token.type == Token::Type::String) {
+                term.type = Term::Type::Text;
+                term.text = take().text;
+            } else if (token.type == Token::Type::Identifier && !isKeyword(token, "AND") &&
+                       !isKeyword(token, "OR") && !isKeyword(token, "NOT")) {
+                term = screener.resolveColumn(take());
+            } else {
+                fail("expected a column or value");
+            }
+            return term;
+        }
+
+        std::unique_ptr<Node> parseComparison() {
+            Term left = parseTerm();
+            const Token& symbol = peek();
+            CompareOp op;
+            if (symbol.type != Token::Type::Symbol) fail("expected a comparison operator");
+            if (symbol.text == "<") op = CompareOp::Less;
+            else if (symbol.text == "<=") op = CompareOp::LessEqual;
+            else if (symbol.text == ">") op = CompareOp::Greater;
+            else if (symbol.text == ">=") op = CompareOp::GreaterEqual;
+            else if (symbol.text == "=" || symbol.text == "==") op = CompareOp::Equal;
+            else if (symbol.text == "!=" || symbol.text == "<>") op = CompareOp::NotEqual;
+            else fail("expected a comparison operator");
+            ++next;
+            Term right = parseTerm();
+
+            auto node = std::make_unique<Node>();
+            node->op = op;
+            bool leftText = left.type == Term::Type::Text || left.type == Term::Type::TextField;
+            bool rightText = right.type == Term::Type::Text || right.type == Term::Type::TextField;
+            if (leftText || rightText) {
+                if (left.type == Term::Type::Text) std::swap(left, right);
+                if (left.type != Term::Type::TextField || right.type != Term::Type::Text) {
+                    fail("text can only be compared as ticker/sector = 'value'");
+                }
+                if (op != CompareOp::Equal && op != CompareOp::NotEqual) fail("text supports only = and !=");
+                node->kind = Node::Kind::TextMatch;
+                node->ids = left.ids;
+                node->textId = left.sector ? screener.panel.sectorId(right.text) : screener.panel.tickerId(right.text);
+                return node;
+            }
+
+            if (left.type == Term::Type::Constant && right.type == Term::Type::Constant) {
+                node->kind = Node::Kind::Constant;
+                node->value = compare(op, left.operand.constant, right.operand.constant);
+                return node;
+            }
+            if (left.type == Term::Type::Constant) {
+                // 1000 < revenue  ->  revenue > 1000
+                std::swap(left, right);
+                node->op = flip(op);
+            }
+            node->kind = Node::Kind::Compare;
+            node->left = left.operand;
+            node->right = right.operand;
+            return node;
+        }
+
+    public:
+        Parser(const Screener& owner, const std::string& text) : screener(owner), tokens(tokenize(text)) {}
+
+        Query parse() {
+            Query query;
+            if (!atClauseEnd()) query.condition = parseOr();
+
+            if (acceptKeyword("ORDER")) {
+                if (!acceptKeyword("BY")) fail("expected BY");
+                Term term = peek().type == Token::Type::Identifier ? screener.resolveColumn(take()) : Term();
+                if (term.type != Term::Type::Column || term.operand.column == screener.yearCells.data()) {
+                    fail("ORDER BY needs a metric");
+                }
+                query.rankMetric = screener.panel.metricId(term.name);
+                if (acceptKeyword("DESC")) query.descending = true;
+                else acceptKeyword("ASC");
+            }
+            if (acceptKeyword("LIMIT")) {
+                if (peek().type != Token::Type::Number) fail("expected a row count");
+                double limit = std::strtod(take().text.c_str(), nullptr);
+                if (limit < 1 || limit != std::floor(limit)) fail("LIMIT needs a positive integer");
+                query.limit = static_cast<size_t>(limit);
+            }
+            if (peek().type != Token::Type::End) fail("unexpected '" + peek().text + "'");
+            return query;
+        }
+    };
+
+    // Maps an identifier to a panel column; unknown and non-numeric columns are
+    // reported against the catalog's view of the table
+    Term resolveColumn(const Token& token) const {
+        Term term;
+        std::string lower = token.text;
+        std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+
+        if (lower == "year") {
+            term.type = Term::Type::Column;
+            term.operand.column = yearCells.data();
+            term.name = "year";
+            return term;
+        }
+        if (lower == "ticker" || lower == "sector") {
+            term.type = Term::Type::TextField;
+            term.sector = lower == "sector";
+            term.ids = term.sector ? panel.sectorCells() : tickerCells.data();
+            term.name = lower;
+            return term;
+        }
+
+        int id = panel.metricId(token.text);
+        for (size_t m = 0; id < 0 && m < panel.metricCount(); ++m) {
+            std::string candidate = panel.metrics()[m];
+            std::transform(candidate.begin(), candidate.end(), candidate.begin(), ::tolower);
+            if (candidate == lower) id = static_cast<int>(m);
+        }
+        if (id >= 0) {
+            term.type = Term::Type::Column;
+            term.operand.column = panel.column(id);
+            term.name = panel.metrics()[id];
+            return term;
+        }
+
+        std::string at = " at position " + std::to_string(token.position);
+        if (tableColumns.count(token.text)) {
+            throw std::invalid_argument("column '" + token.text + "' is not a numeric metric" + at);
+        }
+        throw std::invalid_argument("unknown column '" + token.text + "'" + at);
+    }
+
+    // ---- evaluation --------------------------------------------------------
+
+    static bool compare(CompareOp op, double a, double b) {
+        switch (op) {
+            case CompareOp::Less: return a < b;
+            case CompareOp::LessEqual: return a <= b;
+            case CompareOp::Greater: return a > b;
+            case CompareOp::GreaterEqual: return a >= b;
+            case CompareOp::Equal: return a == b;
+            case CompareOp::NotEqual: return a != b;
+        }
+        return false;
+    }
+
+    static CompareOp flip(CompareOp op) {
+        switch (op) {
+            case CompareOp::Less: return CompareOp::Greater;
+            case CompareOp::LessEqual: return CompareOp::GreaterEqual;
+            case CompareOp::Greater: return CompareOp::Less;
+            case CompareOp::GreaterEqual: return CompareOp::LessEqual;
+            default: return op;
+        }
+    }
+
+    // Compare-and-mask kernel: 64 cells per output word, branch-free inner loop
+    // so the compiler can keep it in vector registers
+    template <typename Cmp, typename Right>
+    void compareKernel(const double* left, Right right, Cmp cmp, Truth& out) const {
+        size_t cells = panel.cellCount();
+        for (size_t w = 0; w < words; ++w) {
+            size_t base = w * 64;
+            size_t count = std::min<size_t>(64, cells - base);
+            uint64_t hit = 0, valid = 0;
+            for (size_t j = 0; j < count; ++j) {
+                double a = left[base + j];
+                double b = right(base + j);
+                hit |= static_cast<uint64_t>(cmp(a, b)) << j;
+                valid |= static_cast<uint64_t>(a == a && b == b) << j;
+            }
+            out.yes[w] = hit & valid;
+            out.no[w] = ~hit & valid;
+        }
+    }
+
+    template <typename Cmp>
+    void compareOperands(const Node& node, Cmp cmp, Truth& out) const {
+        if (node.right.column) {
+            const double* right = node.right.column;
+            compareKernel(node.left.column, [right](size_t i) { return right[i]; }, cmp, out);
+        } else {
+            double constant = node.right.constant;
+            compareKernel(node.left.column, [constant](size_t) { return constant; }, cmp, out);
+        }
+    }
+
+    void textKernel(const Node& node, Truth& out) const {
+        size_t cells = panel.cellCount();
+        bool equal = node.op == CompareOp::Equal;
+        for (size_t w = 0; w < words; ++w) {
+            size_t base = w * 64;
+            size_t count = std::min<size_t>(64, cells - base);
+            uint64_t hit = 0, valid = 0;
+            for (size_t j = 0; j < count; ++j) {
+                int id = node.ids[base + j];
+                hit |= static_cast<uint64_t>(id == node.textId) << j;
+                valid |= static_cast<uint64_t>(id >= 0) << j;
+            }
+            out.yes[w] = (equal ? hit : ~hit) & valid;
+            out.no[w] = (equal ? ~hit : hit) & valid;
+        }
+    }
+
+    Truth evaluate(const Node& node) const {
+        Truth out{std::vector<uint64_t>(words), std::vector<uint64_t>(words)};
+        switch (node.kind) {
+            case Node::Kind::Compare:
+                switch (node.op) {
+                    case CompareOp::Less: compareOperands(node, std::less<double>(), out); break;
+                    case CompareOp::LessEqual: compareOperands(node, std::less_equal<double>(), out); break;
+                    case CompareOp::Greater: compareOperands(node, std::greater<double>(), out); break;
+                    case CompareOp::GreaterEqual: compareOperands(node, std::greater_equal<double>(), out); break;
+                    case CompareOp::Equal: compareOperands(node, std::equal_to<double>(), out); break;
+                    case CompareOp::NotEqual: compareOperands(node, std::not_equal_to<double>(), out); break;
+                }
+                break;
+            case Node::Kind::TextMatch:
+                textKernel(node, out);
+                break;
+            case Node::Kind::Constant:
+                std::fill(node.value ? out.yes.begin() : out.no.begin(),
+                          node.value ? out.yes.end() : out.no.end(), ~uint64_t(0));
+                break;
+            case Node::Kind::Not: {
+                Truth inner = evaluate(*node.first);
+                out.yes.swap(inner.no);
+                out.no.swap(inner.yes);
+                break;
+            }
+            case Node::Kind::And:
+            case Node::Kind::Or: {
+                Truth a = evaluate(*node.first);
+                Truth b = evaluate(*node.second);
+                bool conjunction = node.kind == Node::Kind::And;
+                for (size_t w = 0; w < words; ++w) {
+                    out.yes[w] = conjunction ? (a.yes[w] & b.yes[w]) : (a.yes[w] | b.yes[w]);
+                    out.no[w] = conjunction ? (a.no[w] | b.no[w]) : (a.no[w] & b.no[w]);
+                }
+                break;
+            }
+        }
+        return out;
+    }
+
+public:
+    // schema (optional) is only used to tell non-numeric columns from unknown ones
+    explicit Screener(const PanelStore& source, const TableSchema* schema = nullptr)
+        : panel(source) {
+        if (schema) {
+            for (const auto& name : schema->columnNames()) tableColumns.insert(name);
+        }
+        size_t cells = panel.cellCount();
+        words = (cells + 63) / 64;
+        yearCells.resize(cells);
+        tickerCells.resize(cells);
+        for (size_t i = 0; i < cells; ++i) {
+            yearCells[i] = panel.cellYear(i);
+            tickerCells[i] = panel.cellTicker(i);
+        }
+
+        std::vector<int> order(panel.tickerCount());
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&](int a, int b) { return panel.tickerName(a) < panel.tickerName(b); });
+        tickerRank.resize(order.size());
+        for (size_t r = 0; r < order.size(); ++r) tickerRank[order[r]] = static_cast<int>(r);
+    }
+
+    // Throws std::invalid_argument with the position of the offending token
+    Query compile(const std::string& text) const {
+        return Parser(*this, text).parse();
+    }
+
+    // Matches ordered by ticker and year, or by the ORDER BY metric (missing values last)
+    std::vector<ScreenMatch> run(const Query& query) const {
+        std::vector<uint64_t> selected(words, ~uint64_t(0));
+        if (query.condition) selected = evaluate(*query.condition).yes;
+
+        const uint8_t* present = panel.presentCells();
+        const double* rank = query.rankMetric >= 0 ? panel.column(query.rankMetric) : nullptr;
+        std::vector<ScreenMatch> matches;
+        for (size_t w = 0; w < words; ++w) {
+            for (uint64_t bits = selected[w]; bits; bits &= bits - 1) {
+                size_t cell = w * 64 + static_cast<size_t>(__builtin_ctzll(bits));
+                if (cell >= panel.cellCount() || !present[cell]) continue;
+                matches.push_back({panel.cellTicker(cell), panel.cellYear(cell),
+                                   rank ? rank[cell] : PanelStore::missing});
+            }
+        }
+
+        auto byTicker = [&](const ScreenMatch& a, const ScreenMatch& b) {
+            int ra = tickerRank[a.tickerId], rb = tickerRank[b.tickerId];
+            return ra != rb ? ra < rb : a.year < b.year;
+        };
+        auto byRank = [&](const ScreenMatch& a, const ScreenMatch& b) {
+            bool aMissing = std::isnan(a.rankValue), bMissing = std::isnan(b.rankValue);
+            if (aMissing != bMissing) return bMissing;
+            if (!aMissing && a.rankValue != b.rankValue) {
+                return query.descending ? a.rankValue > b.rankValue : a.rankValue < b.rankValue;
+            }
+            return byTicker(a, b);
+        };
+
+        size_t keep = query.limit ? std::min(query.limit, matches.size()) : matches.size();
+        if (rank) {
+            std::partial_sort(matches.begin(), matches.begin() + keep, matches.end(), byRank);
+        } else {
+            std::partial_sort(matches.begin(), matches.begin() + keep, matches.end(), byTicker);
+        }
+        matches.resize(keep);
+        return matches;
+    }
+
+    std::vector<ScreenMatch> run(const std::string& text) const {
+        return run(compile(text));
+    }
+};
@@ -0,0 +1,285 @@
+#pragma once
+
+#include "PanelStore.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <functional>
+#include <limits>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+// Bounded quantile summary. Up to `capacity` values it keeps every value sorted,
+// so ranks are exact; beyond that neighbouring centroids are merged pairwise
+// (weighted means) and ranks become approximate while memory stays bounded.
+class QuantileSketch {
+private:
+    std::vector<std::pair<double, double>> centroids; // (mean, weight), sorted by mean
+    double total = 0.0;
+    size_t capacity;
+
+    void compress() {
+        std::vector<std::pair<double, double>> merged;
+        merged.reserve(centroids.size() / 2 + 1);
+        for (size_t i = 0; i < centroids.size(); i += 2) {
+            if (i + 1 == centroids.size()) {
+                merged.push_back(centroids[i]);
+                break;
+            }
+            double weight = centroids[i].second + centroids[i + 1].second;
+            double mean = (centroids[i].first * centroids[i].second +
+                           centroids[i + 1].first * centroids[i + 1].second) / weight;
+            merged.push_back({mean, weight});
+        }
+        centroids.swap(merged);
+    }
+
+public:
+    explicit QuantileSketch(size_t capacity = 256) : capacity(std::max<size_t>(capacity, 2)) {}
+
+    void add(double value) {
+        auto position = std::upper_bound(centroids.begin(), centroids.end(), value,
+            [](double v, const std::pair<double, double>& c) { return v < c.first; });
+        centroids.insert(position, {value, 1.0});
+        total += 1.0;
+        if (centroids.size() > capacity) compress();
+    }
+
+    bool exact() const { return static_cast<double>(centroids.size()) == total; }
+
+    // Value of the rank-th smallest element (0-based)
+    double atRank(size_t rank) const {
+        if (centroids.empty()) return std::numeric_limits<double>::quiet_NaN();
+        double cumulative = 0.0;
+        for (const auto& centroid : centroids) {
+            cumulative += centroid.second;
+            if (static_cast<double>(rank) < cumulative) return centroid.first;
+        }
+        return centroids.back().first;
+    }
+};
+
+// Count, Welford mean/M2, sum, min/max and a quantile sketch of one
+// (sector, year, metric) group, maintained one value at a time
+struct SectorAggregate {
+    size_t count = 0;
+    double sum = 0.0;
+    double mean = 0.0;
+    double m2 = 0.0;
+    double min = std::numeric_limits<double>::infinity();
+    double max = -std::numeric_limits<double>::infinity();
+    QuantileSketch sketch;
+
+    void add(double value) {
+        ++count;
+        sum += value;
+        double delta = value - mean;
+        mean += delta / static_cast<double>(count);
+        m2 += delta * (value - mean);
+        min = std::min(min, value);
+        max = std::max(max, value);
+        sketch.add(value);
+    }
+
+    // Population variance, as sectorAnalysis() always reported it
+    double variance() const { return count ? m2 / static_cast<double>(count) : 0.0; }
+    double stdDev() const { return std::sqrt(variance()); }
+
+    double median() const {
+        if (count == 0) return std::numeric_limits<double>::quiet_NaN();
+        return count % 2 == 0 ? (sketch.atRank(count / 2 - 1) + sketch.atRank(count / 2)) / 2.0
+                              : sketch.atRank(count / 2);
+    }
+
+    // Nearest-rank percentile: the element at index floor(q * count) of the sorted values
+    double percentile(double q) const {
+        size_t rank = static_cast<size_t>(q * static_cast<double>(count));
+        return sketch.atRank(std::min(rank, count ? count - 1 : 0));
+    }
+};
+
+// Materialized sector aggregates of a PanelStore keyed by (sector, year, metric).
+// build() fills every group in one pass over the panel; update() folds a reloaded
+// panel in by adding only the new cells and recomputing just the groups whose
+// existing values changed. Lookups are a single hash probe.
+class SectorAggregateCache {
+private:
+    struct Key {
+        std::string sector;
+        int year;
+        std::string metric;
+
+        bool operator==(const Key& other) const {
+            return year == other.year && sector == other.sector && metric == other.metric;
+        }
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const {
+            size_t hash = std::hash<std::string>()(key.sector);
+            hash ^= std::hash<int>()(key.year) + 0x9E3779B97F4A7C15ull + (hash << 6) + (hash >> 2);
+            hash ^= std::hash<std::string>()(key.metric) + 0x9E3779B97F4A7C15ull + (hash << 6) + (hash >> 2);
+            return hash;
+        }
+    };
+
+    std::unordered_map<Key, SectorAggregate, KeyHash> groups;
+    std::string sourceTable;
+    bool ready = false;
+
+    // Exact rebuild of one group from the panel
+    void recompute(const PanelStore& panel, const Key& key) {
+        groups.erase(key);
+        int sectorId = panel.sectorId(key.sector);
+        int metricId = panel.metricId(key.metric);
+        if (sectorId < 0 || metricId < 0) return;
+
+        SectorAggregate aggregate;
+        for (size_t t = 0; t < panel.tickerCount(); ++t) {
+            int tickerId = static_cast<int>(t);
+            if (panel.sectorOf(tickerId, key.year) != sectorId) continue;
+            double value = panel.value(metricId, tickerId, key.year);
+            if (!std::isnan(value)) aggregate.add(value);
+        }
+        if (aggregate.count) groups.emplace(key, std::move(aggregate));
+    }
+
+public:
+    bool built() const { return ready; }
+    const std::string& table() const { return sourceTable; }
+    size_t size() const { return groups.size(); }
+
+    void clear() {
+        groups.clear();
+        sourceTable.clear();
+        ready = false;
+    }
+
+    // With a pool the metrics are scanned in parallel, each into its own dense
+    // table, and merged afterwards; every group still sees its values in cell order.
+    void build(const PanelStore& panel, ThreadPool* pool = nullptr) {
+        clear();
+        sourceTable = panel.table();
+        ready = panel.loaded();
+        if (!ready) return;
+
+        const int years = static_cast<int>(panel.yearCount());
+        const size_t sectors = panel.sectors().size();
+        const int* sectorCells = panel.sectorCells();
+
+        // Dense (sector, year) table per metric so the scan never hashes
+        std::vector<std::vector<SectorAggregate>> dense(panel.metricCount());
+        auto scanMetrics = [&](size_t begin, size_t end) {
+            for (size_t m = begin; m < end; ++m) {
+                std::vector<SectorAggregate>& slots = dense[m];
+                slots.resize(sectors * static_cast<size_t>(years));
+                const double* column = panel.column(static_cast<int>(m));
+                for (size_t cell = 0; cell < panel.cellCount(); ++cell) {
+                    int sectorId = sectorCells[cell];
+                    double value = column[cell];
+                    if (sectorId < 0 || std::isnan(value)) continue;
+                    slots[static_cast<size_t>(sectorId) * years + (panel.cellYear(cell) - panel.minYear())].add(value);
+                }
+            }
+        };
+        if (pool) {
+            pool->parallelFor(0, dense.size(), 1, scanMetrics);
+        } else {
+            scanMetrics(0, dense.size());
+        }
+
+        for (size_t m = 0; m < dense.size(); ++m) {
+            for (size_t slot = 0; slot < dense[m].size(); ++slot) {
+                if (!dense[m][slot].count) continue;
+                int year = panel.minYear() + static_cast<int>(slot % years);
+                groups.emplace(Key{panel.sectors()[slot / years], year, panel.metrics()[m]}, std::move(dense[m][slot]));
+            }
+            std::vector<SectorAggregate>().swap(dense[m]);
+        }
+    }
+
+    // Brings the cache from `before` to `after` (the same table reloaded). Cells
+    // that appeared are added in place; groups with a changed, removed or
+    // re-sectored value are recomputed, including values of tickers and years
+    // the reloaded panel no longer has. Falls back to build() when the metric set
+    // changed or the cache did not describe `before`.
+    void update(const PanelStore& before, const PanelStore& after) {
+        if (!ready || !before.loaded() || !after.loaded() || before.table() != after.table() ||
+            sourceTable != before.table() || before.metrics() != after.metrics()) {
+            build(after);
+            return;
+        }
+
+        std::vector<int> oldTicker(after.tickerCount());
+        for (size_t t = 0; t < after.tickerCount(); ++t) {
+            oldTicker[t] = before.tickerId(after.tickerName(static_cast<int>(t)));
+        }
+        std::vector<int> oldSector(after.sectors().size());
+        for (size_t s = 0; s < after.sectors().size(); ++s) {
+            oldSector[s] = before.sectorId(after.sectors()[s]);
+        }
+
+        std::unordered_set<Key, KeyHash> dirty;
+        std::vector<std::pair<Key, double>> added;
+        for (size_t m = 0; m < after.metricCount(); ++m) {
+            int metricId = static_cast<int>(m);
+            const std::string& metric = after.metrics()[m];
+            for (size_t cell = 0; cell < after.cellCount(); ++cell) {
+                int tickerId = after.cellTicker(cell);
+                int year = after.cellYear(cell);
+                int previous = oldTicker[tickerId];
+
+                int newSectorId = after.sectorCells()[cell];
+                int oldSectorId = previous >= 0 ? before.sectorOf(previous, year) : -1;
+                double newValue = after.column(metricId)[cell];
+                double oldValue = previous >= 0 ? before.value(metricId, previous, year) : PanelStore::missing;
+
+                bool hadValue = oldSectorId >= 0 && !std::isnan(oldValue);
+                bool hasValue = newSectorId >= 0 && !std::isnan(newValue);
+                bool sameSector = newSectorId >= 0 && oldSector[newSectorId] == oldSectorId;
+                if (hadValue == hasValue && (!hasValue || (oldValue == newValue && sameSector))) {
+                    continue;
+                }
+                if (!hadValue) {
+                    added.push_back({Key{after.sectors()[newSectorId], year, metric}, newValue});
+                } else {
+                    dirty.insert(Key{before.sectors()[oldSectorId], year, metric});
+                    if (hasValue) dirty.insert(Key{after.sectors()[newSectorId], year, metric});
+                }
+            }
+        }
+
+        // Cells of `before` outside the grid of `after`: tickers that are gone and
+        // years outside its range
+        std::vector<bool> kept(before.tickerCount());
+        for (size_t t = 0; t < after.tickerCount(); ++t) {
+            if (oldTicker[t] >= 0) kept[oldTicker[t]] = true;
+        }
+        for (size_t m = 0; m < before.metricCount(); ++m) {
+            const std::string& metric = before.metrics()[m];
+            const double* column = before.column(static_cast<int>(m));
+            for (size_t cell = 0; cell < before.cellCount(); ++cell) {
+                int year = before.cellYear(cell);
+                if (kept[before.cellTicker(cell)] && after.inRange(year)) continue;
+                int oldSectorId = before.sectorCells()[cell];
+                if (oldSectorId < 0 || std::isnan(column[cell])) continue;
+                dirty.insert(Key{before.sectors()[oldSectorId], year, metric});
+            }
+        }
+
+        for (const auto& key : dirty) recompute(after, key);
+        for (const auto& [key, value] : added) {
+            if (!dirty.count(key)) groups[key].add(value);
+        }
+    }
+
+    // nullptr when the group has no values
+    const SectorAggregate* find(const std::string& sector, int year, const std::string& metric) const {
+        auto it = groups.find(Key{sector, year, metric});
+        return it == groups.end() ? nullptr : &it->second;
+    }
+};
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#include <utility>
+
+// Path kernels for the Monte Carlo engines: one step model per process and
+// simulate<Model, Horizon>, which runs a block of paths over a whole horizon.
+//
+// Random draws come in step-major rows of `paths` doubles: step t owns rows
+// t * drawsPerStep .. t * drawsPerStep + drawsPerStep - 1, normals first and
+// then uniforms. A model's step() reads its k-th draw of a path at
+// draws[k * stride], so every row is read contiguously across paths.
+//
+// Models keep a log-space state; the per-step constants are computed once in
+// the constructor for a step of dt years (parameters are annual).
+namespace Kernels {
+
+// Geometric Brownian motion: log growth with drift (mu - sigma^2 / 2) dt
+struct GBM {
+    static constexpr size_t normalsPerStep = 1;
+    static constexpr size_t uniformsPerStep = 0;
+    static constexpr size_t drawsPerStep = normalsPerStep + uniformsPerStep;
+
+    double drift;
+    double diffusion;
+
+    GBM(double meanReturn, double volatility, double dt)
+        : drift((meanReturn - 0.5 * volatility * volatility) * dt), diffusion(volatility * std::sqrt(dt)) {}
+
+    double initialState(double) const { return 0.0; }
+    double step(double state, const double* draws, size_t) const { return state + drift + diffusion * draws[0]; }
+    double value(double state, double initialValue) const { return initialValue * std::exp(state); }
+};
+
+// Merton jump diffusion: GBM plus Poisson(intensity dt) jumps per step with
+// normal log sizes. The drift is compensated so E[value] matches GBM with the
+// same meanReturn. Jump counts are drawn by inverting a CDF table with
+// branch-free compares, capped at maxJumps per step.
+struct JumpDiffusion {
+    static constexpr size_t normalsPerStep = 2; // diffusion, jump size
+    static constexpr size_t uniformsPerStep = 1; // jump count
+    static constexpr size_t drawsPerStep = normalsPerStep + uniformsPerStep;
+    static constexpr int maxJumps = 8;
+
+    double drift;
+    double diffusion;
+    double jumpMean;
+    double jumpVolatility;
+    double countCdf[maxJumps]; // P(N <= k)
+
+    JumpDiffusion(double meanReturn, double volatility, double intensity, double meanJump, double jumpStdDev,
+                  double dt)
+        : diffusion(volatility * std::sqrt(dt)), jumpMean(meanJump), jumpVolatility(jumpStdDev) {
+        if (intensity < 0.0 || jumpStdDev < 0.0) {
+            throw std::invalid_argument("jump intensity and size volatility must not be negative");
+        }
+        double compensator = intensity * (std::exp(meanJump + 0.5 * jumpStdDev * jumpStdDev) - 1.0);
+        drift = (meanReturn - 0.5 * volatility * volatility - compensator) * dt;
+
+        double rate = intensity * dt;
+        double probability = std::exp(-rate);
+        double cumulative = probability;
+        for (int k = 0; k < maxJumps; ++k) {
+            countCdf[k] = cumulative;
+            probability *= rate / (k + 1);
+            cumulative += probability;
+        }
+    }
+
+    double initialState(double) const { return 0.0; }
+
+    double step(double state, const double* draws, size_t stride) const {
+        double jumps = 0.0;
+        for (int k = 0; k < maxJumps; ++k) jumps += draws[2 * stride] > countCdf[k] ? 1.0 : 0.0;
+        return state + drift + diffusion * draws[0] + jumps * jumpMean +
+               std::sqrt(jumps) * jumpVolatility * draws[stride];
+    }
+
+    double value(double state, double initialValue) const { return initialValue * std::exp(state); }
+};
+
+// Exponential Ornstein-Uhlenbeck: the log value reverts to log(longRunValue)
+// at `speed` per year, with the exact discretization of the OU step. Values
+// must be positive.
+struct MeanReverting {
+    static constexpr size_t normalsPerStep = 1;
+    static constexpr size_t uniformsPerStep = 0;
+    static constexpr size_t drawsPerStep = normalsPerStep + uniformsPerStep;
+
+    double level;
+    double decay;
+    double diffusion;
+
+    MeanReverting(double longRunValue, double speed, double volatility, double dt) {
+        if (longRunValue <= 0.0 || speed < 0.0) {
+            throw std::invalid_argument("mean reversion needs a positive long-run value and a non-negative speed");
+        }
+        level = std::log(longRunValue);
+        decay = std::exp(-speed * dt);
+        diffusion = speed > 0.0 ? volatility * std::sqrt((1.0 - decay * decay) / (2.0 * speed))
+                                : volatility * std::sqrt(dt);
+    }
+
+    double initialState(double initialValue) const {
+        if (initialValue <= 0.0) throw std::invalid_argument("mean reversion needs a positive initial value");
+        return std::log(initialValue);
+    }
+    double step(double state, const double* draws, size_t) const {
+        return level + (state - level) * decay + diffusion * draws[0];
+    }
+    double value(double state, double) const { return std::exp(state); }
+};
+
+// Horizon argument of simulate<> for a step count only known at run time
+constexpr int dynamicHorizon = 0;
+
+namespace detail {
+
+// One pass over the paths with all steps of the horizon unrolled by the fold;
+// the loads of every step are contiguous in p, so the path loop vectorizes
+template <class Model, size_t... Steps>
+void unrolledPaths(const Model& model, size_t paths, const double* draws, double* state,
+                   std::index_sequence<Steps...>) {
+    constexpr size_t rowsPerStep = Model::drawsPerStep;
+    for (size_t p = 0; p < paths; ++p) {
+        double x = state[p];
+        ((x = model.step(x, draws + Steps * rowsPerStep * paths + p, paths)), ...);
+        state[p] = x;
+    }
+}
+
+} // namespace detail
+
+// Terminal values of `paths` paths after the horizon: Horizon steps, or `steps`
+// with dynamicHorizon. draws holds steps * Model::drawsPerStep rows of `paths`
+// doubles (see above); terminal receives `paths` values.
+template <class Model, int Horizon>
+void simulate(const Model& model, double initialValue, int steps, size_t paths, const double* draws,
+              double* terminal) {
+    const double start = model.initialState(initialValue);
+    for (size_t p = 0; p < paths; ++p) terminal[p] = start;
+
+    if constexpr (Horizon == dynamicHorizon) {
+        // Step by step, each step one vectorizable pass over the paths
+        const size_t rowsPerStep = Model::drawsPerStep;
+        for (int t = 0; t < steps; ++t) {
+            const double* row = draws + static_cast<size_t>(t) * rowsPerStep * paths;
+            for (size_t p = 0; p < paths; ++p) terminal[p] = model.step(terminal[p], row + p, paths);
+        }
+    } else {
+        static_assert(Horizon > 0, "Horizon must be positive or dynamicHorizon");
+        detail::unrolledPaths(model, paths, draws, terminal, std::make_index_sequence<Horizon>());
+    }
+
+    for (size_t p = 0; p < paths; ++p) terminal[p] = model.value(terminal[p], initialValue);
+}
+
+// Dispatches common horizons (1, 3, 5 and 10 annual or quarterly steps) to
+// their compile-time kernels and everything else to the dynamic one
+template <class Model>
+void simulate(const Model& model, double initialValue, int steps, size_t paths, const double* draws,
+              double* terminal) {
+    switch (steps) {
+        case 1: return simulate<Model, 1>(model, initialValue, steps, paths, draws, terminal);
+        case 3: return simulate<Model, 3>(model, initialValue, steps, paths, draws, terminal);
+        case 4: return simulate<Model, 4>(model, initialValue, steps, paths, draws, terminal);
+        case 5: return simulate<Model, 5>(model, initialValue, steps, paths, draws, terminal);
+        case 10: return simulate<Model, 10>(model, initialValue, steps, paths, draws, terminal);
+        case 12: return simulate<Model, 12>(model, initialValue, steps, paths, draws, terminal);
+        case 20: return simulate<Model, 20>(model, initialValue, steps, paths, draws, terminal);
+        case 40: return simulate<Model, 40>(model, initialValue, steps, paths, draws, terminal);
+        default: return simulate<Model, dynamicHorizon>(model, initialValue, steps, paths, draws, terminal);
+    }
+}
+
+} // namespace Kernels
@@ -0,0 +1,233 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Thrown by parallelFor (and by work that polls its token) once cancelled
+class OperationCancelled : public std::runtime_error {
+public:
+    OperationCancelled() : std::runtime_error("operation cancelled") {}
+};
+
+// Cooperative cancellation flag; copies share it. Work checks it between
+// chunks, so cancelling stops a running job at the next chunk boundary.
+class CancellationToken {
+private:
+    std::shared_ptr<std::atomic<bool>> flag = std::make_shared<std::atomic<bool>>(false);
+
+public:
+    void cancel() const { flag->store(true, std::memory_order_relaxed); }
+    bool cancelled() const { return flag->load(std::memory_order_relaxed); }
+
+    void throwIfCancelled() const {
+        if (cancelled()) throw OperationCancelled();
+    }
+};
+
+// Work-stealing pool of worker threads. Every worker owns a deque: tasks it
+// submits go on its own deque and run newest-first, idle workers steal the
+// oldest task of another deque, and submissions from outside the pool are
+// spread round-robin. Threads that wait in parallelFor() or wait() run queued
+// tasks meanwhile, so pool tasks may themselves use the pool.
+class ThreadPool {
+private:
+    using Task = std::function<void()>;
+
+    struct WorkerQueue {
+        std::mutex lock;
+        std::deque<Task> tasks;
+    };
+
+    // Which pool (if any) the calling thread works for
+    struct WorkerIdentity {
+        const ThreadPool* pool = nullptr;
+        size_t index = 0;
+    };
+
+    std::vector<std::unique_ptr<WorkerQueue>> queues; // one per worker
+    std::vector<std::thread> workers;
+    std::atomic<size_t> queued{0};
+    std::atomic<size_t> nextQueue{0};
+    std::mutex sleepLock;
+    std::condition_variable wake;
+    bool stopping = false; // guarded by sleepLock
+
+    static WorkerIdentity& identity() {
+        thread_local WorkerIdentity self;
+        return self;
+    }
+
+    size_t homeQueue() const {
+        const WorkerIdentity& self = identity();
+        return self.pool == this ? self.index : 0;
+    }
+
+    void push(Task task) {
+        const WorkerIdentity& self = identity();
+        size_t target = self.pool == this ? self.index
+                                          : nextQueue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+        {
+            std::lock_guard<std::mutex> lock(queues[target]->lock);
+            queues[target]->tasks.push_back(std::move(task));
+        }
+        queued.fetch_add(1, std::memory_order_release);
+        {
+            std::lock_guard<std::mutex> lock(sleepLock);
+        }
+        wake.notify_one();
+    }
+
+    // Runs one task: the newest of the home queue, else the oldest of another
+    bool tryRunOne(size_t home) {
+        Task task;
+        for (size_t k = 0; k < queues.size() && !task; ++k) {
+            WorkerQueue& queue = *queues[(home + k) % queues.size()];
+            std::lock_guard<std::mutex> lock(queue.lock);
+            if (queue.tasks.empty()) continue;
+            if (k == 0) {
+                task = std::move(queue.tasks.back());
+                queue.tasks.pop_back();
+            } else {
+                task = std::move(queue.tasks.front());
+                queue.tasks.pop_front();
+            }
+        }
+        if (!task) return false;
+        queued.fetch_sub(1, std::memory_order_relaxed);
+        task();
+        return true;
+    }
+
+    void workerLoop(size_t index) {
+        identity() = {this, index};
+        for (;;) {
+            if (tryRunOne(index)) continue;
+            std::unique_lock<std::mutex> lock(sleepLock);
+            wake.wait(lock, [this] { return stopping || queued.load(std::memory_order_acquire) > 0; });
+            if (stopping && queued.load(std::memory_order_acquire) == 0) return;
+        }
+    }
+
+public:
+    explicit ThreadPool(unsigned threadCount = std::thread::hardware_concurrency()) {
+        if (threadCount == 0) threadCount = 1;
+        for (unsigned i = 0; i < threadCount; ++i) {
+            queues.push_back(std::make_unique<WorkerQueue>());
+        }
+        workers.reserve(threadCount);
+        for (unsigned i = 0; i < threadCount; ++i) {
+            workers.emplace_back([this, i] { workerLoop(i); });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(sleepLock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& worker : workers) worker.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned size() const { return static_cast<unsigned>(workers.size()); }
+
+    template <typename F>
+    std::future<std::invoke_result_t<F>> submit(F&& function) {
+        using Result = std::invoke_result_t<F>;
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(function));
+        std::future<Result> result = task->get_future();
+        push([task] { (*task)(); });
+        return result;
+    }
+
+    // Result of a submitted task; runs queued tasks while it is pending, so a
+    // pool task can wait for another one without tying up its worker
+    template <typename T>
+    T wait(std::future<T>& future) {
+        size_t home = homeQueue();
+        while (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            if (!tryRunOne(home)) future.wait_for(std::chrono::microseconds(200));
+        }
+        return future.get();
+    }
+
+    // Runs body(chunkBegin, chunkEnd) over [begin, end) in chunks of at least grain
+    // items and waits for all of them; the first exception thrown is rethrown here.
+    void parallelFor(size_t begin, size_t end, size_t grain,
+                     const std::function<void(size_t, size_t)>& body) {
+        static const CancellationToken never;
+        parallelFor(begin, end, grain, body, never);
+    }
+
+    // As above; chunks not yet started are skipped once the token is cancelled,
+    // and OperationCancelled is thrown when it was
+    void parallelFor(size_t begin, size_t end, size_t grain,
+                     const std::function<void(size_t, size_t)>& body, const CancellationToken& token) {
+        if (begin >= end) return;
+        token.throwIfCancelled();
+        size_t count = end - begin;
+        size_t chunks = std::min<size_t>(size() * 4, (count + grain - 1) / std::max<size_t>(grain, 1));
+        if (chunks <= 1) {
+            body(begin, end);
+            token.throwIfCancelled();
+            return;
+        }
+
+        struct Group {
+            std::atomic<size_t> remaining{0};
+            std::atomic<bool> failed{false};
+            std::exception_ptr error;
+            std::mutex lock;
+            std::condition_variable done;
+        } group;
+
+        size_t chunkSize = (count + chunks - 1) / chunks;
+        group.remaining = (count + chunkSize - 1) / chunkSize;
+        for (size_t chunkBegin = begin; chunkBegin < end; chunkBegin += chunkSize) {
+            size_t chunkEnd = std::min(end, chunkBegin + chunkSize);
+            push([&group, &body, &token, chunkBegin, chunkEnd] {
+                if (!token.cancelled() && !group.failed.load(std::memory_order_relaxed)) {
+                    try {
+                        body(chunkBegin, chunkEnd);
+                    } catch (...) {
+                        std::lock_guard<std::mutex> lock(group.lock);
+                        if (!group.error) group.error = std::current_exception();
+                        group.failed = true;
+                    }
+                }
+                // Decremented under the lock so the waiter cannot return (and
+                // destroy the group) before this task is done with it
+                std::lock_guard<std::mutex> lock(group.lock);
+                if (--group.remaining == 0) group.done.notify_all();
+            });
+        }
+
+        size_t home = homeQueue();
+        while (group.remaining.load(std::memory_order_acquire) > 0) {
+            if (tryRunOne(home)) continue;
+            std::unique_lock<std::mutex> lock(group.lock);
+            group.done.wait_for(lock, std::chrono::microseconds(200), [&group] { return group.remaining == 0; });
+        }
+        {
+            std::unique_lock<std::mutex> lock(group.lock);
+            group.done.wait(lock, [&group] { return group.remaining == 0; });
+        }
+        if (group.error) std::rethrow_exception(group.error);
+        token.throwIfCancelled();
+    }
+};
@@ -0,0 +1,146 @@
+#pragma once
+
+#include "PanelStore.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+// Streaming kernels over evenly spaced series (oldest first, NaN = missing), plus
+// a driver that runs them over every ticker of a panel. Inputs may be double or
+// float (compact panels); outputs are always double. Each kernel is one O(n)
+// pass writing one output per input position; positions without enough data
+// get NaN. Windows count positions, so a gap year shrinks the window's sample
+// instead of pulling in an older value.
+class TimeSeries {
+private:
+    static constexpr double undefined = std::numeric_limits<double>::quiet_NaN();
+
+public:
+    // Rolling mean and population standard deviation over the last `window`
+    // positions, reported once at least minPeriods of them have values.
+    // Welford updates with removal keep it O(n) and numerically stable.
+    template <typename T>
+    static void rollingStats(const T* x, size_t n, size_t window, size_t minPeriods,
+                             double* mean, double* stdDev) {
+        size_t count = 0;
+        double runningMean = 0.0, m2 = 0.0;
+        minPeriods = std::max<size_t>(minPeriods, 1);
+        for (size_t i = 0; i < n; ++i) {
+            if (!std::isnan(x[i])) {
+                ++count;
+                double delta = x[i] - runningMean;
+                runningMean += delta / static_cast<double>(count);
+                m2 += delta * (x[i] - runningMean);
+            }
+            if (i >= window && !std::isnan(x[i - window])) {
+                double leaving = x[i - window];
+                if (--count == 0) {
+                    runningMean = m2 = 0.0;
+                } else {
+                    double delta = leaving - runningMean;
+                    runningMean -= delta / static_cast<double>(count);
+                    m2 -= delta * (leaving - runningMean);
+                }
+            }
+            bool ready = count >= minPeriods;
+            if (mean) mean[i] = ready ? runningMean : undefined;
+            if (stdDev) stdDev[i] = ready ? std::sqrt(std::max(m2, 0.0) / static_cast<double>(count)) : undefined;
+        }
+    }
+
+    // Standard score of each value given the rollingStats output for the series
+    template <typename T>
+    static void zScore(const T* x, size_t n, const double* mean, const double* stdDev, double* out) {
+        for (size_t i = 0; i < n; ++i) {
+            out[i] = stdDev[i] > 0.0 ? (x[i] - mean[i]) / stdDev[i] : undefined;
+        }
+    }
+
+    // Standard score of each value against its trailing window (which includes it)
+    template <typename T>
+    static void zScore(const T* x, size_t n, size_t window, size_t minPeriods, double* out) {
+        std::vector<double> mean(n), stdDev(n);
+        rollingStats(x, n, window, minPeriods, mean.data(), stdDev.data());
+        zScore(x, n, mean.data(), stdDev.data(), out);
+    }
+
+    // Growth over `lag` positions: YoY on an annual series, QoQ with lag 1 on a
+    // quarterly one. A zero or negative base has no meaningful growth and gives NaN.
+    template <typename T>
+    static void growth(const T* x, size_t n, size_t lag, double* out) {
+        for (size_t i = 0; i < n; ++i) {
+            double previous = i >= lag ? static_cast<double>(x[i - lag]) : undefined;
+            out[i] = previous > 0.0 ? (x[i] - previous) / previous : undefined;
+        }
+    }
+
+    // Compound annual growth rate between two values `years` apart
+    static double cagr(double start, double end, double years) {
+        if (!(years > 0.0) || !(start != 0.0)) return undefined;
+        double ratio = end / start;
+        return ratio > 0.0 ? std::pow(ratio, 1.0 / years) - 1.0 : undefined;
+    }
+
+    // CAGR over the trailing `periods` positions, periodsPerYear positions per year
+    template <typename T>
+    static void rollingCagr(const T* x, size_t n, size_t periods, double periodsPerYear, double* out) {
+        double years = static_cast<double>(periods) / periodsPerYear;
+        for (size_t i = 0; i < n; ++i) {
+            out[i] = i >= periods ? cagr(x[i - periods], x[i], years) : undefined;
+        }
+    }
+
+    // Largest peak-to-trough decline so far, as a fraction of the peak (0 = none)
+    template <typename T>
+    static void maxDrawdown(const T* x, size_t n, double* out) {
+        double peak = undefined, worst = undefined;
+        for (size_t i = 0; i < n; ++i) {
+            if (!std::isnan(x[i])) {
+                if (std::isnan(peak) || x[i] > peak) peak = x[i];
+                if (peak > 0.0) {
+                    double drawdown = (peak - x[i]) / peak;
+                    worst = std::isnan(worst) ? drawdown : std::max(worst, drawdown);
+                }
+            }
+            out[i] = worst;
+        }
+    }
+
+    // Runs kernel(series, periodCount, out) on every ticker's contiguous run of a
+    // metric, tickers spread over the pool; the result is laid out like a panel column
+    template <typename Value, typename Kernel>
+    static std::vector<double> acrossTickers(const BasicPanelStore<Value>& panel, int metricId, ThreadPool& pool,
+                                             Kernel kernel) {
+        std::vector<double> out(panel.cellCount(), undefined);
+        const size_t points = static_cast<size_t>(panel.periodCount());
+        pool.parallelFor(0, panel.tickerCount(), 512, [&](size_t begin, size_t end) {
+            for (size_t t = begin; t < end; ++t) {
+                kernel(panel.series(metricId, static_cast<int>(t)), points, out.data() + t * points);
+            }
+        });
+        return out;
+    }
+
+    // rollingStats and zScore of every ticker in one pass per series, laid out
+    // like panel columns
+    template <typename Value>
+    static void rollingStatsAcrossTickers(const BasicPanelStore<Value>& panel, int metricId, ThreadPool& pool,
+                                          size_t window, size_t minPeriods, std::vector<double>& mean,
+                                          std::vector<double>& stdDev, std::vector<double>& zScores) {
+        mean.assign(panel.cellCount(), undefined);
+        stdDev.assign(panel.cellCount(), undefined);
+        zScores.assign(panel.cellCount(), undefined);
+        const size_t points = static_cast<size_t>(panel.periodCount());
+        pool.parallelFor(0, panel.tickerCount(), 512, [&](size_t begin, size_t end) {
+            for (size_t t = begin; t < end; ++t) {
+                const Value* x = panel.series(metricId, static_cast<int>(t));
+                size_t offset = t * points;
+                rollingStats(x, points, window, minPeriods, mean.data() + offset, stdDev.data() + offset);
+                zScore(x, points, mean.data() + offset, stdDev.data() + offset, zScores.data() + offset);
+            }
+        });
+    }
+};
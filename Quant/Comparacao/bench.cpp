@@ -0,0 +1,613 @@
+// Google Benchmark suite for the simulation engine and the storage/query paths
+// behind every menu feature. The Monte Carlo cases run on fixed parameters;
+// the rest run against a synthetic wide financial_statements table (same
+// columns as the shipped database) that is generated on first use and reused
+// while its size matches.
+//
+// bench [--bench-db bench_synthetic.db] [--tickers 2000] [--years 10] [benchmark flags]
+//
+// Results go to stdout as JSON unless --benchmark_format is given. Cases that
+// use the thread pool report wall-clock time. E.g.
+// --benchmark_filter=Feature runs only the feature queries and
+// --benchmark_out=run.json keeps a copy for tools/compare.py. Before any case
+// runs, executeColumnar is checked against the text path on mixed-type values
+// (see verifyColumnarTypes); a mismatch exits with status 1.
+#include "ConnectionPool.h"
+#include "Database.h"
+#include "MonteCarlo.h"
+#include "PanelStore.h"
+#include "RatioEngine.h"
+#include "Screener.h"
+#include "SectorAggregates.h"
+#include "ThreadPool.h"
+#include "TimeSeries.h"
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct BenchOptions {
+    std::string dbPath = "bench_synthetic.db";
+    int tickers = 2000;
+    int years = 10;
+};
+
+BenchOptions options;
+
+const std::vector<std::string> metricNames = {
+    "revenue", "gross_profit", "ebitda", "net_income", "total_assets", "total_liabilities",
+    "total_debt", "capex", "free_cash_flow", "operating_cash_flow"
+};
+
+const std::vector<std::string> sectorNames = {
+    "Technology", "Healthcare", "Financial Services", "Consumer Cyclical", "Industrials", "Energy",
+    "Utilities", "Real Estate", "Basic Materials", "Communication Services", "Consumer Defensive"
+};
+
+const int firstYear = 2015;
+
+std::string syntheticTicker(int index) { return "T" + std::to_string(index); }
+
+// Revenue follows a per-ticker GBM; the other metrics are noisy fractions of it.
+// About 3% of the metric values are NULL, as in real filings.
+void createSyntheticDatabase(Database& db) {
+    db.execute("DROP TABLE IF EXISTS financial_statements;");
+    db.execute(
+        "CREATE TABLE financial_statements ("
+        "id INTEGER PRIMARY KEY AUTOINCREMENT, ticker TEXT NOT NULL, year INTEGER NOT NULL, sector TEXT, "
+        "revenue REAL, gross_profit REAL, ebitda REAL, net_income REAL, total_assets REAL, "
+        "total_liabilities REAL, total_debt REAL, capex REAL, free_cash_flow REAL, operating_cash_flow REAL, "
+        "UNIQUE(ticker, year));");
+
+    std::mt19937_64 rng(42);
+    std::normal_distribution<double> normal(0.0, 1.0);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    const std::vector<double> shares = {1.0, 0.45, 0.25, 0.12, 2.0, 1.1, 0.5, 0.06, 0.1, 0.2};
+
+    std::string insert = "INSERT INTO financial_statements (ticker, year, sector";
+    std::string placeholders = "?, ?, ?";
+    for (const auto& metric : metricNames) {
+        insert += ", " + metric;
+        placeholders += ", ?";
+    }
+    insert += ") VALUES (" + placeholders + ");";
+
+    Database::Transaction transaction(db);
+    for (int t = 0; t < options.tickers; ++t) {
+        std::string ticker = syntheticTicker(t);
+        std::string sector = sectorNames[t % sectorNames.size()];
+        double revenue = 1e8 * std::exp(3.0 * uniform(rng));
+        double drift = 0.02 + 0.08 * uniform(rng), volatility = 0.05 + 0.25 * uniform(rng);
+        for (int y = 0; y < options.years; ++y) {
+            revenue *= std::exp(drift - 0.5 * volatility * volatility + volatility * normal(rng));
+            std::vector<SqlParam> row = {ticker, firstYear + y, sector};
+            for (double share : shares) {
+                if (uniform(rng) < 0.03) {
+                    row.emplace_back(nullptr);
+                } else {
+                    row.emplace_back(revenue * share * (1.0 + 0.1 * normal(rng)));
+                }
+            }
+            db.executeUpdate(insert, row);
+        }
+    }
+    transaction.commit();
+    db.execute("ANALYZE;");
+}
+
+// Synthetic database and its panel, built once per process
+struct BenchData {
+    Database db;
+    PanelStore panel;
+    ThreadPool pool;
+    ConnectionPool readers;
+
+    BenchData() : db(options.dbPath), readers(options.dbPath, pool.size()) {
+        int64_t expected = static_cast<int64_t>(options.tickers) * options.years;
+        int64_t existing = -1;
+        if (db.tableExists("financial_statements")) {
+            existing = static_cast<int64_t>(
+                db.executeColumnar("SELECT COUNT(*) AS n FROM financial_statements;", {}).columns[0].number(0));
+        }
+        if (existing != expected) createSyntheticDatabase(db);
+        panel.load(db, "financial_statements", metricNames, true);
+        RatioEngine::computeAll(panel, pool);
+    }
+};
+
+BenchData& data() {
+    static BenchData instance;
+    return instance;
+}
+
+// executeColumnar must read the same numbers as the text path (std::stod of
+// executeQuery) when declared types and stored values disagree: REAL values in
+// INTEGER columns, and expression columns whose first value is an integer.
+// Prints the first difference and returns false.
+bool verifyColumnarTypes() {
+    Database db(":memory:");
+    db.execute("CREATE TABLE mixed (ticker TEXT, year INTEGER, revenue INTEGER, net_income INTEGER);");
+    db.execute("INSERT INTO mixed VALUES ('AAA', 2023, 1000, 10), ('BBB', 2023, 1500.75, 20.5), "
+               "('CCC', 2023, NULL, 7), ('DDD', 2024, 3, 0.25);");
+    const std::string query = "SELECT ticker, year, revenue, net_income, net_income + 0 AS expression FROM mixed;";
+    auto columnar = db.executeColumnar(query, {});
+    auto rows = db.executeQuery(query);
+    for (const std::string name : {"year", "revenue", "net_income", "expression"}) {
+        const auto& column = columnar.at(name);
+        for (size_t row = 0; row < rows.size(); ++row) {
+            const std::string& text = rows[row].at(name);
+            double expected = text == "N/A" ? std::nan("") : std::stod(text);
+            double actual = column.number(row);
+            if (std::isnan(expected) ? !std::isnan(actual) : actual != expected) {
+                std::cerr << "executeColumnar mismatch in " << name << ", row " << row << ": " << actual
+                          << " (text path: " << text << ")\n";
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// --- Monte Carlo engine -----------------------------------------------------
+
+void BM_SimulateGBM(benchmark::State& state) {
+    MonteCarloSimulator simulator;
+    int paths = static_cast<int>(state.range(0)), years = static_cast<int>(state.range(1));
+    for (auto _ : state) {
+        auto result = simulator.simulateGBM(1000.0, 0.08, 0.2, years, paths);
+        benchmark::DoNotOptimize(result.data());
+    }
+    state.SetItemsProcessed(state.iterations() * paths * years);
+}
+BENCHMARK(BM_SimulateGBM)->ArgsProduct({{1000, 10000, 100000}, {1, 5, 10}})->Unit(benchmark::kMillisecond);
+
+void BM_SimulateGBMParallel(benchmark::State& state) {
+    MonteCarloSimulator simulator;
+    simulator.setSeed(1);
+    int paths = static_cast<int>(state.range(0)), years = static_cast<int>(state.range(1));
+    for (auto _ : state) {
+        auto result = simulator.simulateGBMParallel(1000.0, 0.08, 0.2, years, paths);
+        benchmark::DoNotOptimize(result.values.data());
+    }
+    state.SetItemsProcessed(state.iterations() * paths * years);
+}
+BENCHMARK(BM_SimulateGBMParallel)->ArgsProduct({{1000, 10000, 100000}, {1, 5, 10}})->Unit(benchmark::kMillisecond)->UseRealTime();
+
+void BM_SimulateGBMCheckpoints(benchmark::State& state) {
+    MonteCarloSimulator simulator;
+    simulator.setSeed(1);
+    int paths = static_cast<int>(state.range(0)), years = static_cast<int>(state.range(1));
+    for (auto _ : state) {
+        auto result = simulator.simulateGBMCheckpoints(1000.0, 0.08, 0.2, years, paths);
+        benchmark::DoNotOptimize(result.values.data());
+    }
+    state.SetItemsProcessed(state.iterations() * paths * years);
+}
+BENCHMARK(BM_SimulateGBMCheckpoints)->ArgsProduct({{1000, 10000, 100000}, {1, 5, 10}})->Unit(benchmark::kMillisecond)->UseRealTime();
+
+void BM_CalculateStatistics(benchmark::State& state) {
+    MonteCarloSimulator simulator;
+    int paths = static_cast<int>(state.range(0)), years = static_cast<int>(state.range(1));
+    auto simulated = simulator.simulateGBM(1000.0, 0.08, 0.2, years, paths);
+    for (auto _ : state) {
+        auto stats = simulator.calculateStatistics(simulated);
+        benchmark::DoNotOptimize(stats);
+    }
+    state.SetItemsProcessed(state.iterations() * paths);
+}
+BENCHMARK(BM_CalculateStatistics)->ArgsProduct({{1000, 10000, 100000}, {1, 5, 10}})->Unit(benchmark::kMicrosecond);
+
+void BM_CalculateStatisticsCheckpoints(benchmark::State& state) {
+    MonteCarloSimulator simulator;
+    simulator.setSeed(1);
+    int paths = static_cast<int>(state.range(0));
+    auto simulated = simulator.simulateGBMCheckpoints(1000.0, 0.08, 0.2, 5, paths);
+    for (auto _ : state) {
+        state.PauseTiming();
+        auto checkpoints = simulated; // statistics reorder the values
+        state.ResumeTiming();
+        auto stats = simulator.calculateStatistics(checkpoints);
+        benchmark::DoNotOptimize(stats);
+    }
+    state.SetItemsProcessed(state.iterations() * paths);
+}
+BENCHMARK(BM_CalculateStatisticsCheckpoints)->Arg(1000)->Arg(10000)->Arg(100000)->Unit(benchmark::kMicrosecond);
+
+// --- Step kernels -----------------------------------------------------------
+
+template <class Model> Model benchModel();
+template <> Kernels::GBM benchModel() { return {0.08, 0.2, 1.0}; }
+template <> Kernels::JumpDiffusion benchModel() { return {0.08, 0.2, 0.5, -0.1, 0.15, 1.0}; }
+template <> Kernels::MeanReverting benchModel() { return {1000.0, 0.7, 0.2, 1.0}; }
+
+// Kernel only, over one block of prepared draws: compile-time horizon vs the dynamic loop
+template <class Model, int Horizon>
+void BM_SimulationKernel(benchmark::State& state) {
+    const Model model = benchModel<Model>();
+    const int steps = static_cast<int>(state.range(0));
+    const size_t paths = 256;
+    std::vector<double> draws((static_cast<size_t>(steps) * Model::drawsPerStep * paths + 3) / 4 * 4), scratch;
+    Philox4x32::normals(1, 0, 0, draws.data(), draws.size(), scratch);
+    for (size_t t = 0; t < static_cast<size_t>(steps); ++t) {
+        for (size_t k = Model::normalsPerStep; k < Model::drawsPerStep; ++k) {
+            double* row = draws.data() + (t * Model::drawsPerStep + k) * paths;
+            Philox4x32::uniforms(1, 1 + t * Model::drawsPerStep + k, 0, row, paths);
+        }
+    }
+    std::vector<double> terminal(paths);
+    for (auto _ : state) {
+        Kernels::simulate<Model, Horizon>(model, 1000.0, steps, paths, draws.data(), terminal.data());
+        benchmark::DoNotOptimize(terminal.data());
+    }
+    state.SetItemsProcessed(state.iterations() * paths * steps);
+}
+BENCHMARK_TEMPLATE(BM_SimulationKernel, Kernels::GBM, 5)->Arg(5);
+BENCHMARK_TEMPLATE(BM_SimulationKernel, Kernels::GBM, Kernels::dynamicHorizon)->Arg(5);
+BENCHMARK_TEMPLATE(BM_SimulationKernel, Kernels::GBM, 10)->Arg(10);
+BENCHMARK_TEMPLATE(BM_SimulationKernel, Kernels::GBM, Kernels::dynamicHorizon)->Arg(10);
+BENCHMARK_TEMPLATE(BM_SimulationKernel, Kernels::JumpDiffusion, 10)->Arg(10);
+BENCHMARK_TEMPLATE(BM_SimulationKernel, Kernels::JumpDiffusion, Kernels::dynamicHorizon)->Arg(10);
+BENCHMARK_TEMPLATE(BM_SimulationKernel, Kernels::MeanReverting, 10)->Arg(10);
+BENCHMARK_TEMPLATE(BM_SimulationKernel, Kernels::MeanReverting, Kernels::dynamicHorizon)->Arg(10);
+
+// Whole engine (draws, kernel, terminal sums) per model
+template <class Model>
+void BM_SimulateModel(benchmark::State& state) {
+    MonteCarloSimulator simulator;
+    simulator.setSeed(1);
+    const Model model = benchModel<Model>();
+    int paths = static_cast<int>(state.range(0)), years = static_cast<int>(state.range(1));
+    for (auto _ : state) {
+        auto result = simulator.simulateModel(model, 1000.0, years, paths);
+        benchmark::DoNotOptimize(result.values.data());
+    }
+    state.SetItemsProcessed(state.iterations() * paths * years);
+}
+BENCHMARK_TEMPLATE(BM_SimulateModel, Kernels::GBM)->Args({100000, 10})->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_SimulateModel, Kernels::JumpDiffusion)->Args({100000, 10})->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_SimulateModel, Kernels::MeanReverting)->Args({100000, 10})->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// Resampling engines over the pooled revenue history of the whole synthetic panel
+void BM_SimulateBootstrap(benchmark::State& state) {
+    auto& bench = data();
+    ReturnHistory history;
+    int revenue = bench.panel.metricId("revenue");
+    for (size_t t = 0; t < bench.panel.tickerCount(); ++t) {
+        history.addSeries(bench.panel.series(revenue, static_cast<int>(t)), bench.panel.periodCount());
+    }
+    history.finish();
+    
+    MonteCarloSimulator simulator;
+    simulator.useThreadPool(bench.pool);
+    simulator.setSeed(1);
+    auto mode = state.range(0) ? BootstrapMode::Stationary : BootstrapMode::Block;
+    int paths = static_cast<int>(state.range(1)), years = static_cast<int>(state.range(2));
+    for (auto _ : state) {
+        auto result = simulator.simulateBootstrap(history, mode, 2.0, 1000.0, years, paths);
+        benchmark::DoNotOptimize(result.values.data());
+    }
+    state.SetItemsProcessed(state.iterations() * paths * years);
+}
+BENCHMARK(BM_SimulateBootstrap)->ArgsProduct({{0, 1}, {100000}, {5, 10}})->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// --- Row materialization ----------------------------------------------------
+
+void BM_ExecuteQuery(benchmark::State& state) {
+    auto& bench = data();
+    std::string query = "SELECT * FROM financial_statements LIMIT " + std::to_string(state.range(0)) + ";";
+    for (auto _ : state) {
+        auto rows = bench.db.executeQuery(query);
+        benchmark::DoNotOptimize(rows.data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ExecuteQuery)->Arg(100)->Arg(1000)->Arg(10000)->Unit(benchmark::kMicrosecond);
+
+void BM_ExecuteRows(benchmark::State& state) {
+    auto& bench = data();
+    for (auto _ : state) {
+        const RowSet& rows = bench.db.executeRows("SELECT * FROM financial_statements LIMIT ?;",
+                                                  {static_cast<int64_t>(state.range(0))});
+        benchmark::DoNotOptimize(rows.cells.data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ExecuteRows)->Arg(100)->Arg(1000)->Arg(10000)->Unit(benchmark::kMicrosecond);
+
+void BM_ExecuteColumnar(benchmark::State& state) {
+    auto& bench = data();
+    for (auto _ : state) {
+        auto result = bench.db.executeColumnar("SELECT * FROM financial_statements LIMIT ?;",
+                                               {static_cast<int64_t>(state.range(0))});
+        benchmark::DoNotOptimize(result.rowCount);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ExecuteColumnar)->Arg(100)->Arg(1000)->Arg(10000)->Unit(benchmark::kMicrosecond);
+
+void BM_ForEachRow(benchmark::State& state) {
+    auto& bench = data();
+    for (auto _ : state) {
+        double sum = 0.0;
+        bench.db.forEachRow("SELECT revenue FROM financial_statements LIMIT ?;",
+                            {static_cast<int64_t>(state.range(0))},
+                            [&](sqlite3_stmt* stmt) { sum += sqlite3_column_double(stmt, 0); });
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ForEachRow)->Arg(100)->Arg(1000)->Arg(10000)->Unit(benchmark::kMicrosecond);
+
+// --- Feature queries --------------------------------------------------------
+
+// Every feature starts from the in-memory panel (Reload Data / first use)
+void BM_FeaturePanelLoad(benchmark::State& state) {
+    auto& bench = data();
+    for (auto _ : state) {
+        PanelStore panel;
+        panel.load(bench.db, "financial_statements", metricNames, true);
+        RatioEngine::computeAll(panel, bench.pool);
+        benchmark::DoNotOptimize(panel.cellCount());
+    }
+    state.SetItemsProcessed(state.iterations() * bench.panel.rowCount());
+}
+BENCHMARK(BM_FeaturePanelLoad)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// The same load split into rowid ranges over the read-only connection pool
+void BM_FeaturePanelLoadPooled(benchmark::State& state) {
+    auto& bench = data();
+    for (auto _ : state) {
+        PanelStore panel;
+        panel.load(bench.readers, bench.pool, "financial_statements", metricNames, true);
+        RatioEngine::computeAll(panel, bench.pool);
+        benchmark::DoNotOptimize(panel.cellCount());
+    }
+    state.SetItemsProcessed(state.iterations() * bench.panel.rowCount());
+}
+BENCHMARK(BM_FeaturePanelLoadPooled)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// 1. Stock comparison: every metric of two tickers in one year
+void BM_FeatureCompare(benchmark::State& state) {
+    auto& bench = data();
+    const auto& panel = bench.panel;
+    int year = panel.maxYear();
+    int first = panel.tickerId(syntheticTicker(0)), second = panel.tickerId(syntheticTicker(1));
+    for (auto _ : state) {
+        double sum = 0.0;
+        for (size_t m = 0; m < panel.metricCount(); ++m) {
+            sum += panel.value(static_cast<int>(m), first, year) - panel.value(static_cast<int>(m), second, year);
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+}
+BENCHMARK(BM_FeatureCompare);
+
+void BM_SqlCompare(benchmark::State& state) {
+    auto& bench = data();
+    int year = firstYear + options.years - 1;
+    for (auto _ : state) {
+        auto rows = bench.db.executeQuery("SELECT * FROM financial_statements WHERE ticker IN (?, ?) AND year = ?;",
+                                          {syntheticTicker(0), syntheticTicker(1), year});
+        benchmark::DoNotOptimize(rows.data());
+    }
+}
+BENCHMARK(BM_SqlCompare)->Unit(benchmark::kMicrosecond);
+
+// 2. Sector analysis: build the aggregate cache, then one lookup per metric
+void BM_FeatureSector(benchmark::State& state) {
+    auto& bench = data();
+    int year = bench.panel.maxYear();
+    for (auto _ : state) {
+        SectorAggregateCache cache;
+        cache.build(bench.panel, &bench.pool);
+        for (const auto& metric : metricNames) {
+            benchmark::DoNotOptimize(cache.find(sectorNames[0], year, metric));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * bench.panel.cellCount() * bench.panel.metricCount());
+}
+BENCHMARK(BM_FeatureSector)->Unit(benchmark::kMillisecond);
+
+void BM_SqlSector(benchmark::State& state) {
+    auto& bench = data();
+    int year = firstYear + options.years - 1;
+    for (auto _ : state) {
+        auto result = bench.db.executeColumnar(
+            "SELECT COUNT(revenue), AVG(revenue), MIN(revenue), MAX(revenue) FROM financial_statements "
+            "WHERE sector = ? AND year = ?;", {sectorNames[0], year});
+        benchmark::DoNotOptimize(result.rowCount);
+    }
+}
+BENCHMARK(BM_SqlSector)->Unit(benchmark::kMicrosecond);
+
+// 3. Portfolio screener: compile and run a ranked condition over every ticker-year
+void BM_FeatureScreener(benchmark::State& state) {
+    auto& bench = data();
+    Screener screener(bench.panel);
+    for (auto _ : state) {
+        auto matches = screener.run("revenue > 500000000 AND net_margin > 10 ORDER BY revenue DESC LIMIT 50");
+        benchmark::DoNotOptimize(matches.data());
+    }
+    state.SetItemsProcessed(state.iterations() * bench.panel.cellCount());
+}
+BENCHMARK(BM_FeatureScreener)->Unit(benchmark::kMicrosecond);
+
+void BM_SqlScreener(benchmark::State& state) {
+    auto& bench = data();
+    for (auto _ : state) {
+        auto result = bench.db.executeColumnar(
+            "SELECT ticker, year FROM financial_statements WHERE revenue > 500000000 "
+            "AND net_income * 100.0 / revenue > 10 ORDER BY revenue DESC LIMIT 50;", {});
+        benchmark::DoNotOptimize(result.rowCount);
+    }
+}
+BENCHMARK(BM_SqlScreener)->Unit(benchmark::kMicrosecond);
+
+// 4. Financial ratios: the whole ratio set as derived columns
+void BM_FeatureRatios(benchmark::State& state) {
+    auto& bench = data();
+    for (auto _ : state) {
+        state.PauseTiming();
+        PanelStore panel = bench.panel;
+        state.ResumeTiming();
+        auto computed = RatioEngine::computeAll(panel, bench.pool);
+        benchmark::DoNotOptimize(computed.data());
+    }
+    state.SetItemsProcessed(state.iterations() * bench.panel.cellCount());
+}
+BENCHMARK(BM_FeatureRatios)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// 5./7. Time series and risk: growth, rolling statistics and drawdown for every ticker
+void BM_FeatureSeries(benchmark::State& state) {
+    auto& bench = data();
+    int revenue = bench.panel.metricId("revenue");
+    for (auto _ : state) {
+        auto growth = TimeSeries::acrossTickers(bench.panel, revenue, bench.pool, [](const double* x, size_t n, double* o) {
+            TimeSeries::growth(x, n, 1, o);
+        });
+        auto mean = TimeSeries::acrossTickers(bench.panel, revenue, bench.pool, [](const double* x, size_t n, double* o) {
+            TimeSeries::rollingStats(x, n, 5, 2, o, nullptr);
+        });
+        auto drawdown = TimeSeries::acrossTickers(bench.panel, revenue, bench.pool, [](const double* x, size_t n, double* o) {
+            TimeSeries::maxDrawdown(x, n, o);
+        });
+        benchmark::DoNotOptimize(growth.data());
+        benchmark::DoNotOptimize(mean.data());
+        benchmark::DoNotOptimize(drawdown.data());
+    }
+    state.SetItemsProcessed(state.iterations() * bench.panel.cellCount());
+}
+BENCHMARK(BM_FeatureSeries)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// 6. Monte Carlo of one ticker: fit from the panel, simulate, summarize
+void BM_FeatureMonteCarlo(benchmark::State& state) {
+    auto& bench = data();
+    MonteCarloSimulator simulator;
+    simulator.setSeed(1);
+    const auto& panel = bench.panel;
+    const double* series = panel.series(panel.metricId("revenue"), panel.tickerId(syntheticTicker(0)));
+    for (auto _ : state) {
+        std::vector<int> years;
+        std::vector<double> values;
+        for (int offset = 0; offset < panel.yearCount(); ++offset) {
+            if (std::isnan(series[offset])) continue;
+            years.push_back(panel.minYear() + offset);
+            values.push_back(series[offset]);
+        }
+        auto model = MonteCarloSimulator::fitGrowthModel(years, values);
+        if (!model) {
+            state.SkipWithError("ticker has too little history");
+            break;
+        }
+        auto terminal = simulator.simulateGBMCheckpoints(model->currentValue, model->meanReturn, model->volatility,
+                                                         5, static_cast<int>(state.range(0)));
+        auto stats = simulator.calculateStatistics(terminal);
+        benchmark::DoNotOptimize(stats);
+    }
+}
+BENCHMARK(BM_FeatureMonteCarlo)->Arg(1000)->Arg(10000)->Unit(benchmark::kMicrosecond)->UseRealTime();
+
+// 10. Batch Monte Carlo: one serial simulation per ticker, tickers spread over the pool
+void BM_FeatureBatchMonteCarlo(benchmark::State& state) {
+    auto& bench = data();
+    MonteCarloSimulator simulator;
+    const auto& panel = bench.panel;
+    int revenue = panel.metricId("revenue");
+    size_t jobs = std::min<size_t>(static_cast<size_t>(state.range(0)), panel.tickerCount());
+    for (auto _ : state) {
+        bench.pool.parallelFor(0, jobs, 1, [&](size_t begin, size_t end) {
+            std::vector<int> years;
+            std::vector<double> values;
+            for (size_t t = begin; t < end; ++t) {
+                years.clear();
+                values.clear();
+                const double* series = panel.series(revenue, static_cast<int>(t));
+                for (int offset = 0; offset < panel.yearCount(); ++offset) {
+                    if (std::isnan(series[offset])) continue;
+                    years.push_back(panel.minYear() + offset);
+                    values.push_back(series[offset]);
+                }
+                auto model = MonteCarloSimulator::fitGrowthModel(years, values);
+                if (!model) continue;
+                auto terminal = simulator.simulateGBMCheckpointsSerial(model->currentValue, model->meanReturn,
+                                                                       model->volatility, 5, 1000, t + 1);
+                benchmark::DoNotOptimize(simulator.calculateStatistics(terminal));
+            }
+        });
+    }
+    state.SetItemsProcessed(state.iterations() * jobs);
+}
+BENCHMARK(BM_FeatureBatchMonteCarlo)->Arg(100)->Arg(1000)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// 13. Portfolio Monte Carlo: correlated simulation of `assets` tickers
+void BM_FeaturePortfolio(benchmark::State& state) {
+    auto& bench = data();
+    MonteCarloSimulator simulator;
+    simulator.setSeed(1);
+    const auto& panel = bench.panel;
+    int revenue = panel.metricId("revenue");
+    std::vector<std::string> assets;
+    std::vector<int> years;
+    std::vector<std::vector<double>> values;
+    for (int offset = 0; offset < panel.yearCount(); ++offset) years.push_back(panel.minYear() + offset);
+    for (int t = 0; static_cast<int>(assets.size()) < state.range(0) && t < static_cast<int>(panel.tickerCount()); ++t) {
+        const double* series = panel.series(revenue, t);
+        assets.push_back(panel.tickerName(t));
+        values.emplace_back(series, series + panel.yearCount());
+    }
+    for (auto _ : state) {
+        try {
+            auto model = MonteCarloSimulator::fitPortfolioModel(assets, years, values, {});
+            auto simulated = simulator.simulatePortfolio(model, 5, 10000);
+            benchmark::DoNotOptimize(simulator.calculatePortfolioStatistics(simulated.portfolio, 1.0));
+        } catch (const std::exception& e) {
+            state.SkipWithError(e.what());
+            break;
+        }
+    }
+}
+BENCHMARK(BM_FeaturePortfolio)->Arg(5)->Arg(20)->Arg(50)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+} // namespace
+
+// Strips this tool's own flags, defaults the format to JSON, then hands the
+// rest to Google Benchmark
+int main(int argc, char* argv[]) {
+    std::vector<char*> args = {argv[0]};
+    bool formatGiven = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if ((arg == "--bench-db" || arg == "--tickers" || arg == "--years") && i + 1 < argc) {
+            std::string value = argv[++i];
+            if (arg == "--bench-db") {
+                options.dbPath = value;
+            } else if (arg == "--tickers") {
+                options.tickers = std::max(1, std::stoi(value));
+            } else {
+                options.years = std::max(2, std::stoi(value));
+            }
+            continue;
+        }
+        if (arg.rfind("--benchmark_format", 0) == 0) formatGiven = true;
+        args.push_back(argv[i]);
+    }
+    static char jsonFormat[] = "--benchmark_format=json";
+    if (!formatGiven) args.push_back(jsonFormat);
+
+    int count = static_cast<int>(args.size());
+    benchmark::Initialize(&count, args.data());
+    if (benchmark::ReportUnrecognizedArguments(count, args.data())) return 1;
+    if (!verifyColumnarTypes()) return 1;
+    benchmark::AddCustomContext("bench_db", options.dbPath);
+    benchmark::AddCustomContext("synthetic_tickers", std::to_string(options.tickers));
+    benchmark::AddCustomContext("synthetic_years", std::to_string(options.years));
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,817 @@
+// Native ingestion of SEC company facts into the long-format schema of
+// GET/Get.py. Companies are fetched concurrently by a bounded worker pool that
+// shares one rate limiter (SEC asks for at most 10 requests per second), the
+// JSON is parsed as it arrives, and a single writer thread stores each batch of
+// companies with cached prepared INSERTs inside one transaction, in WAL mode.
+//
+// ingest [--db path] [--ciks CIK.txt] [--workers 8] [--rate 10] [--quarters 8]
+//        [--user-agent "Name email"] [--from-dir dir] [--incremental]
+//
+// --from-dir reads CIK##########.json files (e.g. the SEC companyfacts.zip bulk
+// download) instead of calling the API. Rows are upserted on their natural key;
+// --incremental also skips documents not modified since the last run
+// (If-Modified-Since / file mtime) and writes only facts filed on or after the
+// CIK's filed_date watermark.
+#include "Database.h"
+#include "JsonStream.h"
+#include "ThreadPool.h"
+#include <curl/curl.h>
+#include <sys/stat.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <ctime>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Métricas por demonstração financeira (as mesmas de GET/Get.py)
+struct MetricSpec {
+    const char* statement;
+    const char* tag;
+    const char* label;
+    const char* units;
+};
+
+static const MetricSpec metricSpecs[] = {
+    {"Income Statement", "RevenueFromContractWithCustomerExcludingAssessedTax", "Revenue", "USD"},
+    {"Income Statement", "CostOfGoodsAndServicesSold", "Cost of Goods and Services Sold", "USD"},
+    {"Income Statement", "GrossProfit", "Gross Profit", "USD"},
+    {"Income Statement", "ResearchAndDevelopmentExpense", "Research and Development", "USD"},
+    {"Income Statement", "SellingGeneralAndAdministrativeExpense", "SG&A Expense", "USD"},
+    {"Income Statement", "OperatingExpenses", "Operating Expenses", "USD"},
+    {"Income Statement", "OperatingIncomeLoss", "Operating Income", "USD"},
+    {"Income Statement", "NonoperatingIncomeExpense", "Nonoperating Income", "USD"},
+    {"Income Statement", "IncomeLossFromContinuingOperationsBeforeIncomeTaxesExtraordinaryItemsNoncontrollingInterest", "Pretax Income", "USD"},
+    {"Income Statement", "IncomeTaxExpenseBenefit", "Income Tax Expense", "USD"},
+    {"Income Statement", "NetIncomeLoss", "Net Income", "USD"},
+    {"Income Statement", "EarningsPerShareBasic", "EPS Basic", "USD/shares"},
+    {"Balance Sheet", "CashAndCashEquivalentsAtCarryingValue", "Cash and Cash Equivalents", "USD"},
+    {"Balance Sheet", "MarketableSecuritiesCurrent", "Marketable Securities - Current", "USD"},
+    {"Balance Sheet", "AccountsReceivableNetCurrent", "Accounts Receivable - Current", "USD"},
+    {"Balance Sheet", "NontradeReceivablesCurrent", "Nontrade Receivables - Current", "USD"},
+    {"Balance Sheet", "InventoryNet", "Inventory", "USD"},
+    {"Balance Sheet", "OtherAssetsCurrent", "Other Current Assets", "USD"},
+    {"Balance Sheet", "AssetsCurrent", "Total Current Assets", "USD"},
+    {"Balance Sheet", "MarketableSecuritiesNoncurrent", "Marketable Securities - Noncurrent", "USD"},
+    {"Balance Sheet", "PropertyPlantAndEquipmentNet", "Property Plant and Equipment", "USD"},
+    {"Balance Sheet", "OtherAssetsNoncurrent", "Other Noncurrent Assets", "USD"},
+    {"Balance Sheet", "AssetsNoncurrent", "Total Noncurrent Assets", "USD"},
+    {"Balance Sheet", "Assets", "Total Assets", "USD"},
+    {"Balance Sheet", "AccountsPayableCurrent", "Accounts Payable", "USD"},
+    {"Balance Sheet", "OtherLiabilitiesCurrent", "Other Current Liabilities", "USD"},
+    {"Balance Sheet", "ContractWithCustomerLiabilityCurrent", "Deferred Revenue", "USD"},
+    {"Balance Sheet", "CommercialPaper", "Commercial Paper", "USD"},
+    {"Balance Sheet", "LongTermDebtCurrent", "Long-Term Debt - Current", "USD"},
+    {"Balance Sheet", "LiabilitiesCurrent", "Total Current Liabilities", "USD"},
+    {"Balance Sheet", "LongTermDebtNoncurrent", "Long-Term Debt - Noncurrent", "USD"},
+    {"Balance Sheet", "OtherLiabilitiesNoncurrent", "Other Noncurrent Liabilities", "USD"},
+    {"Balance Sheet", "LiabilitiesNoncurrent", "Total Noncurrent Liabilities", "USD"},
+    {"Balance Sheet", "Liabilities", "Total Liabilities", "USD"},
+    {"Cash Flow Statement", "CashCashEquivalentsRestrictedCashAndRestrictedCashEquivalents", "Cash Beginning", "USD"},
+    {"Cash Flow Statement", "NetIncomeLoss", "Net Income", "USD"},
+    {"Cash Flow Statement", "DepreciationDepletionAndAmortization", "Depreciation and Amortization", "USD"},
+    {"Cash Flow Statement", "ShareBasedCompensation", "Share-Based Compensation", "USD"},
+    {"Cash Flow Statement", "OtherNoncashIncomeExpense", "Other Noncash Items", "USD"},
+    {"Cash Flow Statement", "IncreaseDecreaseInAccountsReceivable", "Change in Accounts Receivable", "USD"},
+    {"Cash Flow Statement", "IncreaseDecreaseInOtherReceivables", "Change in Other Receivables", "USD"},
+    {"Cash Flow Statement", "IncreaseDecreaseInInventories", "Change in Inventories", "USD"},
+    {"Cash Flow Statement", "IncreaseDecreaseInOtherOperatingAssets", "Change in Other Operating Assets", "USD"},
+    {"Cash Flow Statement", "IncreaseDecreaseInAccountsPayable", "Change in Accounts Payable", "USD"},
+    {"Cash Flow Statement", "IncreaseDecreaseInOtherOperatingLiabilities", "Change in Other Operating Liabilities", "USD"},
+    {"Cash Flow Statement", "NetCashProvidedByUsedInOperatingActivities", "Operating Cash Flow", "USD"},
+    {"Cash Flow Statement", "PaymentsToAcquireAvailableForSaleSecuritiesDebt", "Purchase of Securities", "USD"},
+    {"Cash Flow Statement", "ProceedsFromMaturitiesPrepaymentsAndCallsOfAvailableForSaleSecurities", "Proceeds from Maturities", "USD"},
+    {"Cash Flow Statement", "ProceedsFromSaleOfAvailableForSaleSecuritiesDebt", "Proceeds from Sales of Securities", "USD"},
+    {"Cash Flow Statement", "PaymentsToAcquirePropertyPlantAndEquipment", "Capital Expenditures", "USD"},
+    {"Cash Flow Statement", "PaymentsForProceedsFromOtherInvestingActivities", "Other Investing Activities", "USD"},
+    {"Cash Flow Statement", "NetCashProvidedByUsedInInvestingActivities", "Investing Cash Flow", "USD"},
+    {"Cash Flow Statement", "PaymentsRelatedToTaxWithholdingForShareBasedCompensation", "Tax Withholding", "USD"},
+    {"Cash Flow Statement", "PaymentsOfDividends", "Dividends Paid", "USD"},
+    {"Cash Flow Statement", "PaymentsForRepurchaseOfCommonStock", "Stock Repurchases", "USD"},
+    {"Cash Flow Statement", "ProceedsFromIssuanceOfLongTermDebt", "Proceeds from Debt", "USD"},
+    {"Cash Flow Statement", "RepaymentsOfLongTermDebt", "Debt Repayments", "USD"},
+    {"Cash Flow Statement", "ProceedsFromRepaymentsOfCommercialPaper", "Change in Commercial Paper", "USD"},
+    {"Cash Flow Statement", "ProceedsFromPaymentsForOtherFinancingActivities", "Other Financing Activities", "USD"},
+    {"Cash Flow Statement", "NetCashProvidedByUsedInFinancingActivities", "Financing Cash Flow", "USD"},
+    {"Cash Flow Statement", "CashCashEquivalentsRestrictedCashAndRestrictedCashEquivalentsPeriodIncreaseDecreaseIncludingExchangeRateEffect", "Net Change in Cash", "USD"},
+};
+
+struct IngestOptions {
+    std::string dbPath;
+    std::string cikFile = "CIK.txt";
+    std::string sourceDir;                // read CIK##########.json files instead of the API
+    std::string userAgent;
+    unsigned workers = 8;
+    double requestsPerSecond = 10.0;
+    int quarters = 8;                     // NUM_QUARTERS in Get.py
+    size_t batchCompanies = 50;           // companies written per transaction
+    bool incremental = false;             // only facts filed since the last run
+};
+
+// One entry of facts/us-gaap/<tag>/units/<unit>
+struct XbrlFact {
+    int fy = 0;
+    std::string fp = "FY";
+    bool fpNull = false;
+    std::string end;
+    std::string filed;
+    std::string accession;
+    std::string form;
+    bool hasValue = false;
+    double value = 0.0;
+};
+
+// Collects entityName and the facts of the wanted tag|unit pairs while the
+// document streams through; everything else is skipped without being stored.
+class CompanyFactsHandler : public JsonHandler {
+private:
+    struct Frame {
+        bool object;
+        std::string key;
+    };
+    
+    const std::unordered_set<std::string>& wanted;
+    std::vector<Frame> frames;
+    std::vector<XbrlFact>* capture = nullptr;
+    XbrlFact current;
+    
+    // frames: root{facts} -> facts{us-gaap} -> us-gaap{TAG} -> tag{units} -> units{UNIT} -> [ {fact} ]
+    bool atUnitArray() const {
+        return frames.size() == 6 && frames[0].key == "facts" && frames[1].key == "us-gaap" &&
+               frames[3].key == "units";
+    }
+    
+    bool inFact() const { return capture && frames.size() == 7 && frames.back().object; }
+    
+public:
+    std::string entityName = "Unknown";
+    std::unordered_map<std::string, std::vector<XbrlFact>> facts; // keyed by "tag|unit"
+    
+    explicit CompanyFactsHandler(const std::unordered_set<std::string>& wanted) : wanted(wanted) {}
+    
+    void startObject() override {
+        frames.push_back({true, ""});
+        if (inFact()) current = XbrlFact();
+    }
+    
+    void endObject() override {
+        if (inFact()) capture->push_back(current);
+        frames.pop_back();
+    }
+    
+    void startArray() override {
+        frames.push_back({false, ""});
+        if (atUnitArray()) {
+            auto key = frames[2].key + "|" + frames[4].key;
+            capture = wanted.count(key) ? &facts[key] : nullptr;
+        }
+    }
+    
+    void endArray() override {
+        if (frames.size() == 6) capture = nullptr;
+        frames.pop_back();
+    }
+    
+    void key(const std::string& name) override {
+        frames.back().key = name;
+    }
+    
+    void value(Scalar type, const std::string& text) override {
+        if (frames.size() == 1 && frames[0].key == "entityName" && type == Scalar::String) {
+            entityName = text;
+            return;
+        }
+        if (!inFact()) return;
+        
+        const std::string& field = frames.back().key;
+        if (field == "fy") {
+            current.fy = type == Scalar::Number ? std::atoi(text.c_str()) : 0;
+        } else if (field == "fp") {
+            current.fpNull = type == Scalar::Null;
+            current.fp = text;
+        } else if (field == "end") {
+            current.end = text;
+        } else if (field == "filed") {
+            current.filed = text;
+        } else if (field == "accn") {
+            current.accession = text;
+        } else if (field == "form") {
+            current.form = text;
+        } else if (field == "val" && type == Scalar::Number) {
+            current.hasValue = true;
+            current.value = std::strtod(text.c_str(), nullptr);
+        }
+    }
+};
+
+// One row of financial_statements, as Get.py's insert_data receives it
+struct StatementRow {
+    const MetricSpec* metric;
+    int fiscalYear;
+    std::string fiscalPeriod;
+    std::string endDate;
+    std::string filedDate;
+    std::string accession;
+    const char* valueType;
+    bool hasValue;
+    double value;
+};
+
+// Latest filing seen for a CIK, plus the Last-Modified time of its document
+struct Watermark {
+    std::string filed;
+    std::string accession;
+    int64_t lastModified = 0;
+};
+
+struct CompanyResult {
+    std::string cik;
+    std::string companyName;
+    std::vector<StatementRow> rows;
+    Watermark watermark;
+    bool unchanged = false;
+    std::string error;
+};
+
+// Same selection as Get.py: latest filing per (fy, fp), a YTD row for the most
+// recent year, de-accumulated quarters and full years, up to `quarters` quarters.
+std::vector<StatementRow> selectStatementRows(const CompanyFactsHandler& handler, int quarters) {
+    static const char* quarterNames[] = {"Q4", "Q3", "Q2", "Q1"};
+    std::vector<StatementRow> rows;
+    
+    for (const auto& metric : metricSpecs) {
+        auto found = handler.facts.find(std::string(metric.tag) + "|" + metric.units);
+        if (found == handler.facts.end()) continue;
+        
+        // Apenas 10-Q e 10-K, mais recente primeiro
+        std::vector<const XbrlFact*> data;
+        for (const auto& fact : found->second) {
+            if (fact.form == "10-Q" || fact.form == "10-K") data.push_back(&fact);
+        }
+        std::stable_sort(data.begin(), data.end(), [](const XbrlFact* a, const XbrlFact* b) {
+            return a->end != b->end ? a->end > b->end : a->filed > b->filed;
+        });
+        
+        std::map<int, std::map<std::string, const XbrlFact*>> fiscalYears;
+        for (const XbrlFact* fact : data) {
+            if (!fact->fy || fact->end.empty() || fact->fpNull) continue;
+            const XbrlFact*& slot = fiscalYears[fact->fy][fact->fp];
+            if (!slot || fact->filed > slot->filed) slot = fact;
+        }
+        
+        auto add = [&](int fy, const std::string& fp, const XbrlFact* fact, const char* valueType,
+                       bool hasValue, double value) {
+            rows.push_back({&metric, fy, fp, fact->end, fact->filed, fact->accession, valueType, hasValue, value});
+        };
+        
+        int quartersShown = 0;
+        bool ytdShown = false;
+        for (auto year = fiscalYears.rbegin(); year != fiscalYears.rend(); ++year) {
+            if (quartersShown >= quarters) break;
+            const auto& yearData = year->second;
+            auto lookup = [&](const char* period) -> const XbrlFact* {
+                auto it = yearData.find(period);
+                return it == yearData.end() ? nullptr : it->second;
+            };
+            
+            // YTD para o ano mais recente
+            if (!ytdShown) {
+                for (const char* q : quarterNames) {
+                    if (const XbrlFact* fact = lookup(q)) {
+                        add(year->first, q, fact, "YTD", fact->hasValue, fact->value);
+                        ytdShown = true;
+                        break;
+                    }
+                }
+            }
+            
+            // Quarters individuais (valores acumulados no ano passam a trimestrais)
+            for (int i = 0; i < 4 && quartersShown < quarters; ++i) {
+                const XbrlFact* fact = lookup(quarterNames[i]);
+                if (!fact) continue;
+                double value = fact->value;
+                const XbrlFact* previous = i < 3 ? lookup(quarterNames[i + 1]) : nullptr;
+                if (previous && previous->hasValue && previous->value != 0.0 && fact->hasValue && value != 0.0) {
+                    value -= previous->value;
+                }
+                add(year->first, quarterNames[i], fact, "Quarterly", fact->hasValue, value);
+                quartersShown++;
+            }
+            
+            // FY completo
+            if (const XbrlFact* fact = lookup("FY")) {
+                if (quartersShown < quarters) {
+                    add(year->first, "FY", fact, "Full Year", fact->hasValue, fact->value);
+                }
+            }
+        }
+    }
+    return rows;
+}
+
+// Spaces requests evenly so that all workers together stay under the limit
+class RateLimiter {
+private:
+    std::mutex mutex;
+    std::chrono::steady_clock::duration interval;
+    std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+    
+public:
+    explicit RateLimiter(double requestsPerSecond)
+        : interval(std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+              std::chrono::duration<double>(1.0 / std::max(requestsPerSecond, 0.001)))) {}
+    
+    void acquire() {
+        std::chrono::steady_clock::time_point slot;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            slot = std::max(next, std::chrono::steady_clock::now());
+            next = slot + interval;
+        }
+        std::this_thread::sleep_until(slot);
+    }
+};
+
+// companyfacts endpoint over a per-thread libcurl handle (keeps the connection alive)
+class SecClient {
+private:
+    struct Handle {
+        CURL* curl = curl_easy_init();
+        ~Handle() { if (curl) curl_easy_cleanup(curl); }
+    };
+    
+    struct Transfer {
+        JsonStreamParser* parser;
+        std::string error;
+    };
+    
+    const IngestOptions& options;
+    RateLimiter& limiter;
+    
+    static size_t onData(char* data, size_t size, size_t count, void* user) {
+        auto* transfer = static_cast<Transfer*>(user);
+        try {
+            transfer->parser->feed(data, size * count);
+        } catch (const std::exception& e) {
+            transfer->error = e.what();
+            return 0; // aborts the transfer
+        }
+        return size * count;
+    }
+    
+public:
+    SecClient(const IngestOptions& options, RateLimiter& limiter) : options(options), limiter(limiter) {}
+    
+    // Streams CIK##########.json through the parser; retries on 429 and 5xx responses.
+    // lastModified != 0 makes the request conditional: nullopt means the document
+    // has not changed since then. On success lastModified holds the server's time.
+    std::optional<CompanyFactsHandler> fetch(const std::string& cik, const std::unordered_set<std::string>& wanted,
+                                             int64_t& lastModified) {
+        thread_local Handle handle;
+        if (!handle.curl) throw std::runtime_error("curl_easy_init failed");
+        std::string url = "https://data.sec.gov/api/xbrl/companyfacts/CIK" + cik + ".json";
+        
+        const int maxAttempts = 4;
+        for (int attempt = 1;; ++attempt) {
+            CompanyFactsHandler handler(wanted);
+            JsonStreamParser parser(handler);
+            Transfer transfer{&parser, ""};
+            
+            CURL* curl = handle.curl;
+            curl_easy_reset(curl);
+            curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+            curl_easy_setopt(curl, CURLOPT_USERAGENT, options.userAgent.c_str());
+            curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, "");
+            curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
+            curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 30L);
+            curl_easy_setopt(curl, CURLOPT_TIMEOUT, 300L);
+            curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+            curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, &SecClient::onData);
+            curl_easy_setopt(curl, CURLOPT_WRITEDATA, &transfer);
+            curl_easy_setopt(curl, CURLOPT_FILETIME, 1L);
+            if (lastModified > 0) {
+                curl_easy_setopt(curl, CURLOPT_TIMECONDITION, static_cast<long>(CURL_TIMECOND_IFMODSINCE));
+                curl_easy_setopt(curl, CURLOPT_TIMEVALUE, static_cast<long>(lastModified));
+            }
+            
+            limiter.acquire();
+            CURLcode rc = curl_easy_perform(curl);
+            long status = 0;
+            curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+            
+            if (rc == CURLE_OK) {
+                long unmet = 0;
+                curl_easy_getinfo(curl, CURLINFO_CONDITION_UNMET, &unmet);
+                if (status == 304 || unmet) {
+                    return std::nullopt;
+                }
+                parser.finish();
+                long fileTime = -1;
+                curl_easy_getinfo(curl, CURLINFO_FILETIME, &fileTime);
+                lastModified = fileTime > 0 ? fileTime : 0;
+                return handler;
+            }
+            if (!transfer.error.empty()) {
+                throw std::runtime_error(transfer.error);
+            }
+            
+            bool retryable = status == 429 || status >= 500 || rc == CURLE_OPERATION_TIMEDOUT ||
+                             rc == CURLE_COULDNT_CONNECT || rc == CURLE_RECV_ERROR;
+            if (!retryable || attempt >= maxAttempts) {
+                std::string message = curl_easy_strerror(rc);
+                if (status) message += " (HTTP " + std::to_string(status) + ")";
+                throw std::runtime_error(message);
+            }
+            std::this_thread::sleep_for(std::chrono::seconds(1 << attempt));
+        }
+    }
+};
+
+// Reads a locally stored companyfacts document in fixed-size chunks; the file's
+// mtime plays the role of Last-Modified (see SecClient::fetch)
+std::optional<CompanyFactsHandler> readFactsFile(const std::string& path, const std::unordered_set<std::string>& wanted,
+                                                 int64_t& lastModified) {
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0) throw std::runtime_error("cannot open " + path);
+    if (lastModified > 0 && static_cast<int64_t>(info.st_mtime) <= lastModified) {
+        return std::nullopt;
+    }
+    
+    std::ifstream file(path, std::ios::binary);
+    if (!file) throw std::runtime_error("cannot open " + path);
+    lastModified = static_cast<int64_t>(info.st_mtime);
+    
+    CompanyFactsHandler handler(wanted);
+    JsonStreamParser parser(handler);
+    std::vector<char> buffer(1 << 16);
+    while (file) {
+        file.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        parser.feed(buffer.data(), static_cast<size_t>(file.gcount()));
+    }
+    parser.finish();
+    return handler;
+}
+
+// Creates the Get.py tables and stores companies in bulk. Rows are upserted on
+// their natural key, so re-ingesting a company replaces its facts instead of
+// appending duplicates; per-CIK watermarks record what was seen last.
+class IngestWriter {
+private:
+    Database& db;
+    
+    static std::string now() {
+        std::time_t t = std::time(nullptr);
+        std::tm local = *std::localtime(&t);
+        std::ostringstream ss;
+        ss << std::put_time(&local, "%Y-%m-%d %H:%M:%S");
+        return ss.str();
+    }
+    
+    static SqlParam optionalText(const std::string& text) {
+        return text.empty() ? SqlParam(nullptr) : SqlParam(text);
+    }
+    
+    static const char* statementTable(const std::string& statement) {
+        if (statement == "Income Statement") return "income_statement";
+        if (statement == "Balance Sheet") return "balance_sheet";
+        if (statement == "Cash Flow Statement") return "cash_flow_statement";
+        return nullptr;
+    }
+    
+    // Drops duplicate rows left by earlier append-only runs (keeping the newest)
+    // and adds the unique index the upserts rely on
+    void ensureUniqueKey(const std::string& table, const std::string& index, const std::string& columns) {
+        auto existing = db.executeColumnar("SELECT name FROM sqlite_master WHERE type = 'index' AND name = ?;", {index});
+        if (existing.rowCount > 0) return;
+        
+        Database::Transaction transaction(db);
+        db.execute("DELETE FROM " + table + " WHERE id NOT IN (SELECT MAX(id) FROM " + table +
+                   " GROUP BY " + columns + ");");
+        db.execute("CREATE UNIQUE INDEX " + index + " ON " + table + " (" + columns + ");");
+        transaction.commit();
+    }
+    
+public:
+    explicit IngestWriter(Database& db) : db(db) {
+        db.execute("PRAGMA journal_mode=WAL; PRAGMA synchronous=NORMAL;");
+        db.execute(
+            "CREATE TABLE IF NOT EXISTS financial_statements ("
+            "id INTEGER PRIMARY KEY AUTOINCREMENT, company_name TEXT, cik TEXT, fiscal_year INTEGER, "
+            "fiscal_period TEXT, end_date TEXT, filed_date TEXT, statement_type TEXT, metric_name TEXT, "
+            "metric_tag TEXT, value_type TEXT, value REAL, units TEXT, extraction_date TEXT);");
+        for (const char* table : {"income_statement", "balance_sheet", "cash_flow_statement"}) {
+            db.execute(std::string("CREATE TABLE IF NOT EXISTS ") + table + " ("
+                "id INTEGER PRIMARY KEY AUTOINCREMENT, company_name TEXT, cik TEXT, fiscal_year INTEGER, "
+                "fiscal_period TEXT, end_date TEXT, metric_name TEXT, value REAL);");
+            ensureUniqueKey(table, std::string("idx_") + table + "_key",
+                            "cik, fiscal_year, fiscal_period, metric_name");
+        }
+        db.execute(
+            "CREATE TABLE IF NOT EXISTS ingest_watermarks ("
+            "cik TEXT PRIMARY KEY, last_filed_date TEXT, last_accession TEXT, "
+            "last_modified INTEGER, updated_at TEXT);");
+        
+        // (cik, metric_tag, fiscal_year, fiscal_period) plus the statement and value
+        // type: Get.py stores a YTD and a Quarterly row for the same period, and
+        // NetIncomeLoss under two statements
+        ensureUniqueKey("financial_statements", "idx_financial_statements_key",
+                        "cik, statement_type, metric_tag, fiscal_year, fiscal_period, value_type");
+    }
+    
+    std::unordered_map<std::string, Watermark> loadWatermarks() {
+        std::unordered_map<std::string, Watermark> watermarks;
+        auto result = db.executeColumnar(
+            "SELECT cik, last_filed_date, last_accession, last_modified FROM ingest_watermarks;", {});
+        const auto& cik = result.at("cik");
+        const auto& filed = result.at("last_filed_date");
+        const auto& accession = result.at("last_accession");
+        const auto& modified = result.at("last_modified");
+        for (size_t i = 0; i < result.rowCount; ++i) {
+            if (cik.isNull(i) || cik.type != ColumnarResult::Type::Text) continue;
+            Watermark& mark = watermarks[cik.texts[i]];
+            if (filed.type == ColumnarResult::Type::Text && !filed.isNull(i)) mark.filed = filed.texts[i];
+            if (accession.type == ColumnarResult::Type::Text && !accession.isNull(i)) mark.accession = accession.texts[i];
+            if (modified.hasNumber(i)) mark.lastModified = static_cast<int64_t>(modified.number(i));
+        }
+        return watermarks;
+    }
+    
+    // All companies of the batch in one transaction; returns the rows written
+    size_t write(const std::vector<CompanyResult>& companies) {
+        const std::string upsertFact =
+            "INSERT INTO financial_statements (company_name, cik, fiscal_year, fiscal_period, end_date, "
+            "filed_date, statement_type, metric_name, metric_tag, value_type, value, units, extraction_date) "
+            "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?) "
+            "ON CONFLICT (cik, statement_type, metric_tag, fiscal_year, fiscal_period, value_type) DO UPDATE SET "
+            "company_name = excluded.company_name, end_date = excluded.end_date, filed_date = excluded.filed_date, "
+            "metric_name = excluded.metric_name, value = excluded.value, units = excluded.units, "
+            "extraction_date = excluded.extraction_date;";
+        const std::string upsertWatermark =
+            "INSERT INTO ingest_watermarks (cik, last_filed_date, last_accession, last_modified, updated_at) "
+            "VALUES (?, ?, ?, ?, ?) ON CONFLICT (cik) DO UPDATE SET "
+            "last_filed_date = excluded.last_filed_date, last_accession = excluded.last_accession, "
+            "last_modified = excluded.last_modified, updated_at = excluded.updated_at;";
+        const std::string extractionDate = now();
+        size_t written = 0;
+        
+        Database::Transaction transaction(db);
+        for (const auto& company : companies) {
+            for (const auto& row : company.rows) {
+                SqlParam value = row.hasValue ? SqlParam(row.value) : SqlParam(nullptr);
+                db.executeUpdate(upsertFact, {
+                    company.companyName, company.cik, row.fiscalYear, row.fiscalPeriod, row.endDate,
+                    optionalText(row.filedDate), row.metric->statement, row.metric->label, row.metric->tag,
+                    row.valueType, value, row.metric->units, extractionDate
+                });
+                
+                const char* table = statementTable(row.metric->statement);
+                if (table && std::string(row.valueType) == "Quarterly") {
+                    db.executeUpdate(std::string("INSERT INTO ") + table +
+                        " (company_name, cik, fiscal_year, fiscal_period, end_date, metric_name, value)"
+                        " VALUES (?, ?, ?, ?, ?, ?, ?)"
+                        " ON CONFLICT (cik, fiscal_year, fiscal_period, metric_name) DO UPDATE SET"
+                        " company_name = excluded.company_name, end_date = excluded.end_date,"
+                        " value = excluded.value;", {
+                        company.companyName, company.cik, row.fiscalYear, row.fiscalPeriod, row.endDate,
+                        row.metric->label, value
+                    });
+                }
+                written++;
+            }
+            
+            const Watermark& mark = company.watermark;
+            db.executeUpdate(upsertWatermark, {
+                company.cik, optionalText(mark.filed), optionalText(mark.accession),
+                mark.lastModified ? SqlParam(mark.lastModified) : SqlParam(nullptr), extractionDate
+            });
+        }
+        transaction.commit();
+        return written;
+    }
+};
+
+// Moves the watermark to the latest filing among the selected rows
+Watermark advanceWatermark(const Watermark& previous, const std::vector<StatementRow>& rows, int64_t lastModified) {
+    Watermark next = previous;
+    for (const auto& row : rows) {
+        if (row.filedDate > next.filed) {
+            next.filed = row.filedDate;
+            next.accession = row.accession;
+        }
+    }
+    next.lastModified = lastModified;
+    return next;
+}
+
+// "320193" -> "0000320193", as the companyfacts file names expect
+std::string normalizeCik(std::string cik) {
+    cik.erase(0, cik.find_first_not_of(" \t\r"));
+    cik.erase(cik.find_last_not_of(" \t\r") + 1);
+    if (!cik.empty() && cik.size() < 10 && cik.find_first_not_of("0123456789") == std::string::npos) {
+        cik.insert(0, 10 - cik.size(), '0');
+    }
+    return cik;
+}
+
+std::string defaultDatabaseName() {
+    std::time_t t = std::time(nullptr);
+    std::tm local = *std::localtime(&t);
+    std::ostringstream ss;
+    ss << "sec_financial_data_" << std::put_time(&local, "%Y%m%d_%H%M%S") << ".db";
+    return ss.str();
+}
+
+void printUsage(std::ostream& out) {
+    out << "Usage: ingest [--db path] [--ciks CIK.txt] [--workers n] [--rate requests/s] [--quarters n]\n"
+        << "              [--user-agent \"Name email\"] [--from-dir dir] [--incremental]\n";
+}
+
+int main(int argc, char* argv[]) {
+    IngestOptions options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--incremental") {
+            options.incremental = true;
+            continue;
+        }
+        if (arg == "--help" || arg == "-h" || i + 1 >= argc) {
+            printUsage(arg == "--help" || arg == "-h" ? std::cout : std::cerr);
+            return arg == "--help" || arg == "-h" ? 0 : 2;
+        }
+        std::string value = argv[++i];
+        try {
+            if (arg == "--db") options.dbPath = value;
+            else if (arg == "--ciks") options.cikFile = value;
+            else if (arg == "--from-dir") options.sourceDir = value;
+            else if (arg == "--user-agent") options.userAgent = value;
+            else if (arg == "--workers") options.workers = static_cast<unsigned>(std::max(1, std::stoi(value)));
+            else if (arg == "--rate") options.requestsPerSecond = std::stod(value);
+            else if (arg == "--quarters") options.quarters = std::stoi(value);
+            else {
+                printUsage(std::cerr);
+                return 2;
+            }
+        } catch (const std::exception&) {
+            std::cerr << "Invalid value for " << arg << ": " << value << "\n";
+            return 2;
+        }
+    }
+    
+    // Lê CIKs do ficheiro
+    std::vector<std::string> ciks;
+    {
+        std::ifstream file(options.cikFile);
+        if (!file) {
+            std::cerr << "Error: " << options.cikFile << " not found!\n";
+            std::cerr << "Create it with one CIK per line (e.g. 0000320193)\n";
+            return 1;
+        }
+        std::string line;
+        while (std::getline(file, line)) {
+            std::string cik = normalizeCik(line);
+            if (!cik.empty()) ciks.push_back(cik);
+        }
+    }
+    if (ciks.empty()) {
+        std::cerr << "Error: " << options.cikFile << " is empty!\n";
+        return 1;
+    }
+    
+    if (options.dbPath.empty()) options.dbPath = defaultDatabaseName();
+    if (options.userAgent.empty()) {
+        const char* env = std::getenv("SEC_USER_AGENT");
+        options.userAgent = env ? env : "SeuNome seu@email.com";
+        if (!env && options.sourceDir.empty()) {
+            std::cerr << "Warning: set --user-agent or SEC_USER_AGENT to \"Name email\" as SEC requires\n";
+        }
+    }
+    
+    std::cout << "Found " << ciks.size() << " CIK(s) to process\n";
+    std::cout << "Database: " << options.dbPath << "\n";
+    
+    try {
+        Database db(options.dbPath);
+        IngestWriter writer(db);
+        const auto watermarks = writer.loadWatermarks();
+        
+        curl_global_init(CURL_GLOBAL_DEFAULT);
+        RateLimiter limiter(options.requestsPerSecond);
+        SecClient client(options, limiter);
+        
+        std::unordered_set<std::string> wanted;
+        for (const auto& metric : metricSpecs) {
+            wanted.insert(std::string(metric.tag) + "|" + metric.units);
+        }
+        
+        // Workers fetch and parse; this thread is the only one touching the database
+        std::mutex mutex;
+        std::condition_variable ready;
+        std::deque<CompanyResult> finished;
+        std::atomic<bool> aborted{false};
+        
+        auto start = std::chrono::steady_clock::now();
+        size_t successful = 0, unchanged = 0, totalRows = 0, received = 0;
+        {
+            ThreadPool pool(options.workers);
+            for (const auto& cik : ciks) {
+                pool.submit([&, cik] {
+                    CompanyResult result;
+                    result.cik = cik;
+                    try {
+                        if (aborted) throw std::runtime_error("aborted");
+                        auto previous = watermarks.find(cik);
+                        Watermark seen = previous != watermarks.end() ? previous->second : Watermark();
+                        int64_t lastModified = options.incremental ? seen.lastModified : 0;
+                        
+                        auto handler = options.sourceDir.empty()
+                            ? client.fetch(cik, wanted, lastModified)
+                            : readFactsFile(options.sourceDir + "/CIK" + cik + ".json", wanted, lastModified);
+                        if (!handler) {
+                            result.unchanged = true;
+                        } else {
+                            result.companyName = handler->entityName;
+                            result.rows = selectStatementRows(*handler, options.quarters);
+                            result.watermark = advanceWatermark(seen, result.rows, lastModified);
+                            if (options.incremental) {
+                                // Upserts make the boundary day idempotent, so >= is safe
+                                result.rows.erase(std::remove_if(result.rows.begin(), result.rows.end(),
+                                    [&](const StatementRow& row) { return row.filedDate < seen.filed; }),
+                                    result.rows.end());
+                            }
+                        }
+                    } catch (const std::exception& e) {
+                        result.error = e.what();
+                    }
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        finished.push_back(std::move(result));
+                    }
+                    ready.notify_one();
+                });
+            }
+            
+            while (received < ciks.size()) {
+                std::vector<CompanyResult> batch;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    ready.wait(lock, [&] { return !finished.empty(); });
+                    while (!finished.empty() && batch.size() < options.batchCompanies) {
+                        batch.push_back(std::move(finished.front()));
+                        finished.pop_front();
+                    }
+                }
+                received += batch.size();
+                
+                std::vector<CompanyResult> stored;
+                for (auto& company : batch) {
+                    if (!company.error.empty()) {
+                        std::cout << "  x CIK " << company.cik << ": " << company.error << "\n";
+                        continue;
+                    }
+                    if (company.unchanged) {
+                        std::cout << "  = CIK " << company.cik << ": unchanged\n";
+                        unchanged++;
+                        continue;
+                    }
+                    std::cout << "  ok CIK " << company.cik << " " << company.companyName << ": "
+                              << company.rows.size() << " rows\n";
+                    stored.push_back(std::move(company));
+                }
+                try {
+                    totalRows += writer.write(stored);
+                } catch (...) {
+                    aborted = true; // let the queued workers drain quickly
+                    throw;
+                }
+                successful += stored.size();
+            }
+        }
+        curl_global_cleanup();
+        
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "\n" << std::string(80, '=') << "\n";
+        std::cout << "INGESTION COMPLETE\n";
+        std::cout << std::string(80, '=') << "\n";
+        std::cout << "Database: " << options.dbPath << "\n";
+        std::cout << "Companies processed: " << successful << "/" << ciks.size() << "\n";
+        if (options.incremental) std::cout << "Companies unchanged: " << unchanged << "\n";
+        std::cout << "Rows written: " << totalRows << " in " << std::fixed << std::setprecision(1)
+                  << elapsed << " s\n";
+    } catch (const std::exception& e) {
+        std::cerr << "Fatal error: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -1,4 +1,16 @@
-#include <sqlite3.h>
+#include "ConnectionPool.h"
+#include "Database.h"
+#include "MonteCarlo.h"
+#include "NumberFormat.h"
+#include "PanelSnapshot.h"
+#include "PanelStore.h"
+#include "Profiler.h"
+#include "RatioEngine.h"
+#include "ResultCache.h"
+#include "Screener.h"
+#include "SectorAggregates.h"
+#include "ThreadPool.h"
+#include "TimeSeries.h"
 #include <iostream>
 #include <string>
 #include <vector>
@@ -6,222 +18,309 @@
 #include <algorithm>
 #include <iomanip>
 #include <sstream>
+#include <fstream>
 #include <memory>
 #include <cmath>
 #include <optional>
 #include <numeric>
 #include <random>
+#include <cstdint>
+#include <stdexcept>
+#include <limits>
+#include <unordered_map>
+#include <chrono>
+#include <array>
+#include <atomic>
+#include <csignal>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <type_traits>
 
-class Database {
-private:
-    sqlite3* db;
-    
-public:
-    Database(const std::string& db_path) : db(nullptr) {
-        if (sqlite3_open(db_path.c_str(), &db) != SQLITE_OK) {
-            throw std::runtime_error("Cannot open database: " + std::string(sqlite3_errmsg(db)));
+// One batch Monte Carlo run over many tickers and metrics
+struct BatchMonteCarloRequest {
+    std::vector<std::string> tickers; // empty = every ticker of the main table
+    std::vector<std::string> metrics;
+    int simulations = 5000;
+    int years = 5;
+};
+
+struct BatchMonteCarloResult {
+    std::string ticker;
+    std::string metric;
+    MonteCarloSimulator::GrowthModel model;
+    uint64_t seed = 0;
+    std::map<std::string, double> stats;
+};
+
+struct BatchMonteCarloSummary {
+    int64_t runId = 0;
+    size_t jobs = 0;
+    size_t completed = 0; // jobs with results (saved, with --save), simulated or cached
+    size_t simulated = 0; // jobs simulated by this run
+    size_t skipped = 0;
+    size_t cached = 0;    // jobs answered by the result cache
+    double elapsedMs = 0.0;
+};
+
+// Set by Ctrl+C while FinancialAnalyzer::runInBackground waits for a job
+inline std::atomic<bool> interruptRequested{false};
+inline void requestInterrupt(int) { interruptRequested = true; }
+
+// Splits "a, b,c" into trimmed, non-empty items
+inline std::vector<std::string> splitList(const std::string& text, char separator = ',') {
+    std::vector<std::string> items;
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, separator)) {
+        size_t first = item.find_first_not_of(" \t\r\n");
+        if (first == std::string::npos) continue;
+        size_t last = item.find_last_not_of(" \t\r\n");
+        items.push_back(item.substr(first, last - first + 1));
+    }
+    return items;
+}
+
+// True for columns holding ratios, margins and other unitless values rather
+// than amounts (net_margin, current_ratio, debt_to_equity, roe, ...)
+inline bool isRatioColumn(const std::string& name) {
+    static const char* const words[] = {"ratio", "margin", "turnover", "coverage", "multiplier", "percent",
+                                        "growth", "yield", "roe", "roa", "beta", "return", "to"};
+    for (const auto& word : splitList(name, '_')) {
+        for (const char* ratioWord : words) {
+            if (word == ratioWord) return true;
         }
     }
+    return false;
+}
+
+// Metrics printed as plain numbers with two decimals instead of K/M/B amounts:
+// ratios computed in memory and loaded ratio columns
+inline bool isRatioMetric(const PanelStore& panel, int metricId) {
+    return panel.isDerived(metricId) || isRatioColumn(panel.metrics()[metricId]);
+}
+
+// CSV field, quoted only when needed
+inline std::string csvField(const std::string& text) {
+    if (text.find_first_of(",\"\n") == std::string::npos) return text;
+    std::string quoted = "\"";
+    for (char c : text) {
+        if (c == '"') quoted += '"';
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+// Full-precision number for machine-readable output; empty when missing
+inline std::string csvNumber(double value) {
+    if (std::isnan(value)) return "";
+    std::ostringstream ss;
+    ss << std::setprecision(15) << value;
+    return ss.str();
+}
+
+class FinancialAnalyzer {
+private:
+    Database db;
+    SchemaCatalog catalog;
+    std::string mainTable;
+    ThreadPool scheduler; // shared by every parallel feature: loads, ratios, sector stats, Monte Carlo
+    MonteCarloSimulator mcSimulator;
+    std::unique_ptr<ConnectionPool> readers; // read-only connections for pool workers; none for in-memory databases
+    PanelStore panel;
+    std::unique_ptr<Screener> screener; // bound to the current panel
+    SectorAggregateCache aggregates;    // built from the current panel on first use
+    CompactPanelStore quarterlyPanel;   // Q1..Q4 history of a long-format table, loaded on demand
+    NumberFormatter formatter;          // shared char buffer for console numbers
+    ResultCache resultCache;            // Monte Carlo statistics of earlier identical requests
+    std::string snapshotPath;           // binary panel snapshot to map/refresh; empty = always load from SQLite
+    int64_t panelDataVersion = -1;      // PRAGMA data_version when the panel was loaded
+    bool prepareTables = false;         // index every main table (--prepare or menu option 14)
+    bool interactive;
     
-    ~Database() {
-        if (db) {
-            sqlite3_close(db);
-        }
+    // Status messages go to stderr in command-line mode so stdout stays machine-readable
+    std::ostream& statusOut() {
+        return interactive ? std::cout : std::cerr;
     }
     
-    std::vector<std::map<std::string, std::string>> executeQuery(const std::string& query) {
-        sqlite3_stmt* stmt;
-        std::vector<std::map<std::string, std::string>> results;
-        
-        if (sqlite3_prepare_v2(db, query.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
-            throw std::runtime_error("Failed to prepare statement: " + std::string(sqlite3_errmsg(db)));
-        }
-        
-        int columnCount = sqlite3_column_count(stmt);
-        
-        while (sqlite3_step(stmt) == SQLITE_ROW) {
-            std::map<std::string, std::string> row;
-            for (int i = 0; i < columnCount; i++) {
-                std::string columnName = sqlite3_column_name(stmt, i);
-                const unsigned char* value = sqlite3_column_text(stmt, i);
-                row[columnName] = value ? std::string(reinterpret_cast<const char*>(value)) : "N/A";
-            }
-            results.push_back(row);
-        }
-        
-        sqlite3_finalize(stmt);
-        return results;
+    // Numeric metric columns of the main table, taken from the declared schema
+    std::vector<std::string> metricColumns() {
+        const TableSchema* table = catalog.getTable(mainTable);
+        if (!table) return {};
+        auto columns = table->numericColumns();
+        columns.erase(std::remove(columns.begin(), columns.end(), "year"), columns.end());
+        return columns;
     }
-
-    std::vector<std::string> getTableNames() {
-        std::string query = "SELECT name FROM sqlite_master WHERE type='table';";
-        std::vector<std::string> tables;
-        try {
-            auto results = executeQuery(query);
-            for (const auto& row : results) {
-                tables.push_back(row.at("name"));
-            }
-        } catch (const std::exception& e) {
-            std::cout << "Error getting table names: " << e.what() << "\n";
-        }
-        return tables;
+    
+    bool mainTableHasColumn(const std::string& column) {
+        const TableSchema* table = catalog.getTable(mainTable);
+        return table && table->hasColumn(column);
     }
-
-    std::vector<std::string> getColumnNames(const std::string& tableName) {
-        std::string query = "PRAGMA table_info(" + tableName + ");";
-        std::vector<std::string> columns;
-        try {
-            auto results = executeQuery(query);
-            for (const auto& row : results) {
-                columns.push_back(row.at("name"));
-            }
-        } catch (const std::exception& e) {
-            std::cout << "Error getting column names for " << tableName << ": " << e.what() << "\n";
+    
+    // True when the main table uses the long (EAV) layout written by GET/Get.py
+    bool mainTableIsLongFormat() {
+        for (const char* column : {"cik", "fiscal_year", "fiscal_period", "metric_tag", "value"}) {
+            if (!mainTableHasColumn(column)) return false;
         }
-        return columns;
+        return true;
     }
-
-    void inspectDatabase() {
-        std::cout << "\n=== DATABASE INSPECTION ===\n";
-        auto tables = getTableNames();
-        
-        if (tables.empty()) {
-            std::cout << "No tables found in the database!\n";
+    
+    // (Re)builds the in-memory panel from the main table
+    void loadPanel() {
+        screener.reset();
+        aggregates.clear();
+        quarterlyPanel.clear();
+        panel.clear();
+        bool longFormat = !mainTable.empty() && mainTableIsLongFormat();
+        if (mainTable.empty() || (!longFormat && (!mainTableHasColumn("ticker") || !mainTableHasColumn("year")))) {
             return;
         }
         
-        std::cout << "Found " << tables.size() << " tables:\n";
-        
-        for (const auto& table : tables) {
-            std::cout << "\nTable: " << table << "\n";
-            auto columns = getColumnNames(table);
-            std::cout << "Columns (" << columns.size() << "): ";
-            for (size_t i = 0; i < columns.size(); ++i) {
-                std::cout << columns[i];
-                if (i < columns.size() - 1) std::cout << ", ";
+        try {
+            Profiler::Scope profile("panel.load");
+            auto start = std::chrono::steady_clock::now();
+            panelDataVersion = db.dataVersion();
+            SnapshotSource source;
+            if (!snapshotPath.empty()) {
+                source = SnapshotSource::of(db, mainTable);
+                if (PanelSnapshot::map(panel, source, snapshotPath)) {
+                    double elapsedMs = std::chrono::duration<double, std::milli>(
+                        std::chrono::steady_clock::now() - start).count();
+                    statusOut() << "Mapped " << panel.rowCount() << " rows (" << panel.tickerCount() << " tickers, "
+                                << panel.metricCount() - panel.derivedCount() << " metrics + " << panel.derivedCount()
+                                << " ratios, " << panel.minYear() << "-" << panel.maxYear() << ") from "
+                                << snapshotPath << " in " << std::fixed << std::setprecision(1) << elapsedMs << " ms\n";
+                    return;
+                }
             }
-            std::cout << "\n";
             
-            // Show sample data
-            try {
-                std::string sampleQuery = "SELECT * FROM " + table + " LIMIT 2;";
-                auto sampleResults = executeQuery(sampleQuery);
-                if (!sampleResults.empty()) {
-                    std::cout << "Sample data:\n";
-                    for (const auto& row : sampleResults) {
-                        for (const auto& [key, value] : row) {
-                            std::cout << "  " << key << ": " << (value.length() > 50 ? value.substr(0, 50) + "..." : value) << "\n";
-                        }
-                        std::cout << "  ---\n";
-                    }
+            if (longFormat) {
+                panel.loadLongFormat(db, mainTable, mainTableHasColumn("filed_date"));
+            } else if (readers) {
+                panel.load(*readers, scheduler, mainTable, metricColumns(), mainTableHasColumn("sector"));
+            } else {
+                panel.load(db, mainTable, metricColumns(), mainTableHasColumn("sector"));
+            }
+            size_t loadedMetrics = panel.metricCount();
+            std::vector<std::string> ratios;
+            {
+                Profiler::Scope ratioProfile("panel.ratios");
+                ratios = RatioEngine::computeAll(panel, scheduler);
+            }
+            double elapsedMs = std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - start).count();
+            statusOut() << "Loaded " << panel.rowCount() << " rows (" << panel.tickerCount() << " tickers, "
+                      << loadedMetrics << " metrics + " << ratios.size() << " ratios, "
+                      << panel.minYear() << "-" << panel.maxYear()
+                      << ") into memory in " << std::fixed << std::setprecision(1) << elapsedMs << " ms\n";
+            
+            if (!snapshotPath.empty()) {
+                Profiler::Scope snapshotProfile("panel.write_snapshot");
+                if (PanelSnapshot::write(panel, source, snapshotPath)) {
+                    statusOut() << "Wrote panel snapshot " << snapshotPath << "\n";
                 } else {
-                    std::cout << "  Table is empty\n";
+                    statusOut() << "Could not write panel snapshot " << snapshotPath << "\n";
                 }
-            } catch (const std::exception& e) {
-                std::cout << "  Could not sample data: " << e.what() << "\n";
             }
+        } catch (const std::exception& e) {
+            statusOut() << "Error loading data into memory: " << e.what() << "\n";
+            screener.reset();
+            aggregates.clear();
+            quarterlyPanel.clear();
+            panel.clear();
         }
     }
     
-    bool tableExists(const std::string& tableName) {
-        auto tables = getTableNames();
-        return std::find(tables.begin(), tables.end(), tableName) != tables.end();
+    // Per-job seed derived from the run seed and a stable job key (FNV-1a + splitmix64)
+    static uint64_t jobSeed(uint64_t baseSeed, const std::string& key) {
+        uint64_t hash = 1469598103934665603ull;
+        for (unsigned char c : key) {
+            hash = (hash ^ c) * 1099511628211ull;
+        }
+        uint64_t z = baseSeed ^ hash;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
     }
-};
-
-class MonteCarloSimulator {
-private:
-    std::mt19937_64 rng;
     
-public:
-    MonteCarloSimulator() : rng(std::random_device{}()) {}
+    // Data-version part of a result cache key: the exact observations a model was fitted on
+    static uint64_t seriesFingerprint(const std::vector<int>& years, const std::vector<double>& values) {
+        uint64_t hash = ResultCache::fingerprint(years.data(), years.size() * sizeof(int));
+        return ResultCache::fingerprint(values.data(), values.size() * sizeof(double), hash);
+    }
     
-    // Gera caminhos aleatórios usando Geometric Brownian Motion (GBM)
-    std::vector<std::vector<double>> simulateGBM(double initialValue, double meanReturn, 
-                                                double volatility, int years, int numSimulations) {
-        std::vector<std::vector<double>> paths(numSimulations);
-        std::normal_distribution<double> normal(0.0, 1.0);
-        
-        double dt = 1.0; // 1 year time step
-        double drift = (meanReturn - 0.5 * volatility * volatility) * dt;
-        double diffusion = volatility * std::sqrt(dt);
-        
-        for (int i = 0; i < numSimulations; ++i) {
-            std::vector<double> path(years + 1);
-            path[0] = initialValue;
-            
-            for (int t = 1; t <= years; ++t) {
-                double randomShock = normal(rng);
-                path[t] = path[t-1] * std::exp(drift + diffusion * randomShock);
+    // Cached (sector, year, metric) statistics; nullptr when the group has no values
+    const SectorAggregate* sectorAggregate(const std::string& sector, int year, const std::string& metric) {
+        if (!aggregates.built() || aggregates.table() != panel.table()) {
+            aggregates.build(panel, &scheduler);
+        }
+        return aggregates.find(sector, year, metric);
+    }
+    
+    // Quarterly (float32) panel of the main table; only the long layout written by
+    // GET/Get.py carries Q1..Q4 rows. False when the table has none.
+    bool ensureQuarterlyPanel() {
+        if (!mainTableIsLongFormat()) return false;
+        if (!quarterlyPanel.loaded() || quarterlyPanel.table() != mainTable) {
+            try {
+                Profiler::Scope profile("panel.load_quarterly");
+                auto start = std::chrono::steady_clock::now();
+                quarterlyPanel.loadLongFormat(db, mainTable, mainTableHasColumn("filed_date"),
+                                              CompactPanelStore::Resolution::Quarterly,
+                                              mainTableHasColumn("value_type"));
+                double elapsedMs = std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - start).count();
+                statusOut() << "Loaded " << quarterlyPanel.rowCount() << " quarterly rows ("
+                            << quarterlyPanel.tickerCount() << " tickers, " << quarterlyPanel.metricCount()
+                            << " metrics) into memory in " << std::fixed << std::setprecision(1) << elapsedMs << " ms\n";
+            } catch (const std::exception& e) {
+                statusOut() << "Error loading quarterly data: " << e.what() << "\n";
+                quarterlyPanel.clear();
             }
-            
-            paths[i] = path;
         }
-        
-        return paths;
+        return quarterlyPanel.cellCount() > 0;
     }
     
-    // Calcula estatísticas dos caminhos simulados
-    std::map<std::string, double> calculateStatistics(const std::vector<std::vector<double>>& paths) {
-        std::map<std::string, double> stats;
-        int numSimulations = paths.size();
-        int projectionYears = paths[0].size() - 1;
-        
-        // Coletar valores finais
-        std::vector<double> finalValues(numSimulations);
-        for (int i = 0; i < numSimulations; ++i) {
-            finalValues[i] = paths[i].back();
-        }
-        
-        // Ordenar para percentis
-        std::sort(finalValues.begin(), finalValues.end());
-        
-        // Calcular estatísticas
-        double sum = std::accumulate(finalValues.begin(), finalValues.end(), 0.0);
-        stats["mean"] = sum / numSimulations;
-        stats["median"] = finalValues[numSimulations / 2];
-        stats["p5"] = finalValues[static_cast<int>(numSimulations * 0.05)];
-        stats["p25"] = finalValues[static_cast<int>(numSimulations * 0.25)];
-        stats["p75"] = finalValues[static_cast<int>(numSimulations * 0.75)];
-        stats["p95"] = finalValues[static_cast<int>(numSimulations * 0.95)];
-        stats["min"] = finalValues.front();
-        stats["max"] = finalValues.back();
-        
-        // Probabilidade de crescimento
-        double initialValue = paths[0][0];
-        int growthCount = std::count_if(finalValues.begin(), finalValues.end(),
-                                       [initialValue](double x) { return x > initialValue; });
-        stats["growth_probability"] = (static_cast<double>(growthCount) / numSimulations) * 100.0;
-        
-        return stats;
+    // Asks for annual or quarterly data when the main table can provide both
+    bool askQuarterly() {
+        if (!mainTableIsLongFormat()) return false;
+        char resolution;
+        std::cout << "Resolution (A=annual, Q=quarterly): ";
+        std::cin >> resolution;
+        if (resolution != 'q' && resolution != 'Q') return false;
+        if (!ensureQuarterlyPanel()) {
+            std::cout << "No quarterly data in " << mainTable << "; using annual data.\n";
+            return false;
+        }
+        return true;
     }
-};
-
-class FinancialAnalyzer {
-private:
-    Database db;
-    std::string mainTable;
-    MonteCarloSimulator mcSimulator;
     
-    std::string formatMillions(double value) {
-        if (value == 0) return "0";
-        double absValue = std::abs(value);
-        double millions = value / 1000000.0;
-        std::stringstream ss;
-        
-        if (absValue >= 1000000000) { // Billions
-            double billions = value / 1000000000.0;
-            ss << std::fixed << std::setprecision(2) << billions << "B";
-        } else if (absValue >= 1000000) { // Millions
-            ss << std::fixed << std::setprecision(1) << millions << "M";
-        } else if (absValue >= 1000) { // Thousands
-            double thousands = value / 1000.0;
-            ss << std::fixed << std::setprecision(1) << thousands << "K";
-        } else {
-            ss << std::fixed << std::setprecision(0) << value;
+    bool ensurePanel() {
+        // Also reloads once another connection committed to the database
+        if (!panel.loaded() || panel.table() != mainTable || db.dataVersion() != panelDataVersion) {
+            loadPanel();
         }
-        
-        return ss.str();
+        if (!panel.loaded()) {
+            statusOut() << "Error: Table doesn't have required 'ticker' or 'year' columns!\n";
+            return false;
+        }
+        return true;
+    }
+    
+    std::string formatMillions(double value) {
+        Profiler::Scope profile("format");
+        Profiler::add(Profiler::Counter::ValuesFormatted, 1);
+        return std::string(formatter.millions(value));
+    }
+    
+    // formatMillions without the copy, for printing straight away
+    std::string_view formatMillionsView(double value) {
+        Profiler::Scope profile("format");
+        Profiler::add(Profiler::Counter::ValuesFormatted, 1);
+        return formatter.millions(value);
     }
     
     void runMonteCarloTests() {
@@ -248,8 +347,8 @@ private:
     void testMonteCarloScenario(const std::string& ticker, const std::string& metric,
                                double initialValue, double meanReturn, double volatility,
                                int years, int simulations) {
-        auto paths = mcSimulator.simulateGBM(initialValue, meanReturn, volatility, years, simulations);
-        auto stats = mcSimulator.calculateStatistics(paths);
+        auto terminal = mcSimulator.simulateGBMCheckpoints(initialValue, meanReturn, volatility, years, simulations);
+        auto stats = mcSimulator.calculateStatistics(terminal);
         
         std::cout << "\n" << std::string(60, '-') << "\n";
         std::cout << "SIMULATION RESULTS (" << ticker << " - " << metric << ")\n";
@@ -259,8 +358,10 @@ private:
         std::cout << "Annual Volatility: " << std::fixed << std::setprecision(1) << (volatility * 100) << "%\n";
         std::cout << "Projection Years: " << years << "\n";
         std::cout << "Simulations: " << simulations << "\n";
+        std::cout << "Variance Reduction: " << varianceReductionName(mcSimulator.getVarianceReduction()) << "\n";
         std::cout << "\nPROJECTION STATISTICS (in millions):\n";
         std::cout << "Average: " << formatMillions(stats["mean"]) << "\n";
+        std::cout << "Standard Error: " << formatMillions(stats["std_error"]) << "\n";
         std::cout << "Median: " << formatMillions(stats["median"]) << "\n";
         std::cout << "5th Percentile: " << formatMillions(stats["p5"]) << "\n";
         std::cout << "25th Percentile: " << formatMillions(stats["p25"]) << "\n";
@@ -275,6 +376,10 @@ private:
         std::cout << "Simulation Average: " << formatMillions(stats["mean"]) << "\n";
         std::cout << "Difference: " << std::fixed << std::setprecision(1) 
                   << ((stats["mean"] - expected_value) / expected_value * 100) << "%\n";
+        if (stats["std_error"] > 0) {
+            std::cout << "Difference in standard errors: " << std::fixed << std::setprecision(2)
+                      << ((stats["mean"] - expected_value) / stats["std_error"]) << "\n";
+        }
         
         if (std::abs(stats["mean"] - expected_value) / expected_value < 0.1) {
             std::cout << "✅ Simulation results are consistent with theoretical expectations\n";
@@ -287,23 +392,30 @@ private:
                                  double currentValue, int currentYear,
                                  double meanReturn, double volatility,
                                  int projectionYears, int simulations,
-                                 const std::map<std::string, double>& stats) {
+                                 const std::map<std::string, double>& stats,
+                                 const std::string& returnModel = "") {
         std::cout << "\n" << std::string(70, '=') << "\n";
         std::cout << "MONTE CARLO SIMULATION RESULTS: " << ticker << " - " << metric << "\n";
         std::cout << std::string(70, '=') << "\n";
-        std::cout << "Current Value (" << currentYear << "): " << formatMillions(currentValue) << "\n";
+        std::cout << "Current Value (" << currentYear << "): " << formatMillionsView(currentValue) << "\n";
         std::cout << "Historical Mean Return: " << std::fixed << std::setprecision(1) << (meanReturn * 100) << "%\n";
         std::cout << "Historical Volatility: " << std::fixed << std::setprecision(1) << (volatility * 100) << "%\n";
         std::cout << "Projection Years: " << projectionYears << "\n";
         std::cout << "Simulations: " << simulations << "\n";
+        if (returnModel.empty()) {
+            std::cout << "Variance Reduction: " << varianceReductionName(mcSimulator.getVarianceReduction()) << "\n";
+        } else {
+            std::cout << "Return Model: " << returnModel << "\n";
+        }
         
         std::cout << "\nPROJECTION STATISTICS FOR " << (currentYear + projectionYears) << " (in millions):\n";
-        std::cout << "Average: " << formatMillions(stats.at("mean")) << "\n";
-        std::cout << "Median: " << formatMillions(stats.at("median")) << "\n";
-        std::cout << "5th Percentile (Conservative): " << formatMillions(stats.at("p5")) << "\n";
-        std::cout << "25th Percentile: " << formatMillions(stats.at("p25")) << "\n";
-        std::cout << "75th Percentile: " << formatMillions(stats.at("p75")) << "\n";
-        std::cout << "95th Percentile (Optimistic): " << formatMillions(stats.at("p95")) << "\n";
+        std::cout << "Average: " << formatMillionsView(stats.at("mean")) << "\n";
+        std::cout << "Standard Error: " << formatMillionsView(stats.at("std_error")) << "\n";
+        std::cout << "Median: " << formatMillionsView(stats.at("median")) << "\n";
+        std::cout << "5th Percentile (Conservative): " << formatMillionsView(stats.at("p5")) << "\n";
+        std::cout << "25th Percentile: " << formatMillionsView(stats.at("p25")) << "\n";
+        std::cout << "75th Percentile: " << formatMillionsView(stats.at("p75")) << "\n";
+        std::cout << "95th Percentile (Optimistic): " << formatMillionsView(stats.at("p95")) << "\n";
         std::cout << "Probability of Growth: " << std::fixed << std::setprecision(1) << stats.at("growth_probability") << "%\n";
         
         // Análise de risco
@@ -323,18 +435,12 @@ private:
         }
     }
     
-public:
-    FinancialAnalyzer(const std::string& db_path) : db(db_path) {
-        std::cout << "Database connected successfully!\n";
-        
-        // Inspect the database to understand its structure
-        db.inspectDatabase();
-        
+    void detectMainTable() {
         // Try to find the main financial data table
-        auto tables = db.getTableNames();
+        const auto& tables = catalog.getTableNames();
         
         if (tables.empty()) {
-            std::cout << "No tables found in the database!\n";
+            statusOut() << "No tables found in the database!\n";
             return;
         }
         
@@ -351,12 +457,18 @@ public:
             for (const auto& financialName : financialTableNames) {
                 if (lowerTable.find(financialName) != std::string::npos) {
                     mainTable = table;
-                    std::cout << "Using table: " << mainTable << " for financial data\n";
+                    statusOut() << "Using table: " << mainTable << " for financial data\n";
                     return;
                 }
             }
         }
         
+        if (!interactive) {
+            mainTable = tables[0];
+            statusOut() << "No obvious financial table found. Using: " << mainTable << "\n";
+            return;
+        }
+        
         // If no obvious financial table found, let user choose
         if (mainTable.empty()) {
             std::cout << "\nNo obvious financial table found. Please select a table:\n";
@@ -378,15 +490,119 @@ public:
         }
     }
     
-    void setMainTable(const std::string& tableName) {
-        if (db.tableExists(tableName)) {
+public:
+    // Startup only reads the schema catalog; table inspection is on demand, the
+    // panel is loaded by the first feature that needs it and the database is only
+    // changed (WAL, indexes) once preparation is asked for.
+    // interactive = false disables every prompt (command-line mode).
+    FinancialAnalyzer(const std::string& db_path, bool interactive = true)
+        : db(db_path), catalog(db), interactive(interactive) {
+        statusOut() << "Database connected successfully!\n";
+        mcSimulator.useThreadPool(scheduler);
+        if (!db.fileName().empty()) {
+            readers = std::make_unique<ConnectionPool>(db.fileName(), scheduler.size());
+        }
+        detectMainTable();
+    }
+    
+    // Indexes for the main table's lookups (see Database::prepareForAnalysis);
+    // a read-only database is used as it is
+    void prepareDatabase() {
+        if (mainTable.empty()) return;
+        statusOut() << "Preparing database for " << mainTable << " (WAL journal, indexes, ANALYZE)...\n";
+        
+        std::vector<std::vector<std::string>> indexes;
+        if (mainTableIsLongFormat()) {
+            // Matches the pivot scan: WHERE fiscal_period = ? ORDER BY cik, fiscal_year, metric_tag
+            indexes.push_back({"fiscal_period", "cik", "fiscal_year", "metric_tag"});
+        } else if (mainTableHasColumn("ticker") && mainTableHasColumn("year")) {
+            indexes.push_back({"ticker", "year"});
+            if (mainTableHasColumn("sector")) indexes.push_back({"sector", "year", "ticker"});
+        }
+        
+        try {
+            auto start = std::chrono::steady_clock::now();
+            auto created = db.prepareForAnalysis(mainTable, indexes);
+            for (const auto& name : created) {
+                statusOut() << "Created index " << name << "\n";
+            }
+            if (!created.empty()) {
+                catalog.refresh();
+                double elapsedMs = std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - start).count();
+                statusOut() << "Database prepared in " << std::fixed << std::setprecision(1) << elapsedMs << " ms\n";
+            }
+        } catch (const std::exception& e) {
+            statusOut() << "Could not prepare database (" << e.what() << "); continuing without new indexes\n";
+        }
+    }
+    
+    bool setMainTable(const std::string& tableName) {
+        catalog.refresh();
+        if (catalog.tableExists(tableName)) {
             mainTable = tableName;
-            std::cout << "Main table set to: " << mainTable << "\n";
-        } else {
-            std::cout << "Table '" << tableName << "' does not exist!\n";
+            statusOut() << "Main table set to: " << mainTable << "\n";
+            screener.reset();
+            aggregates.clear();
+            quarterlyPanel.clear();
+            panel.clear();
+            if (prepareTables) prepareDatabase();
+            return true;
+        }
+        statusOut() << "Table '" << tableName << "' does not exist!\n";
+        return false;
+    }
+    
+    MonteCarloSimulator& simulator() { return mcSimulator; }
+    
+    // Prepares the main table now and every main table chosen later
+    void enablePreparation() {
+        prepareTables = true;
+        prepareDatabase();
+    }
+    
+    // Picks up schema changes made since the last command (one PRAGMA query),
+    // so the metadata probes within a command don't each check again
+    void beginCommand() {
+        catalog.refreshIfChanged();
+    }
+    
+    // Maps the panel from this snapshot file when it matches the database and
+    // rewrites it whenever the panel has to be built from SQLite instead
+    void setSnapshotPath(const std::string& path) {
+        snapshotPath = path;
+    }
+    
+    // Keeps cached results across runs in a side file, <database>.cache, so the
+    // database itself (and a --snapshot of it) stays unchanged
+    void persistResultCache() {
+        if (db.fileName().empty()) {
+            statusOut() << "In-memory database; results are cached for this run only\n";
+            return;
+        }
+        std::string path = db.fileName() + ".cache";
+        if (!resultCache.persistTo(path)) {
+            statusOut() << "Cannot open result cache " << path << "; results are cached for this run only\n";
         }
     }
     
+    // Compiles a screening condition against the in-memory panel (see Screener);
+    // throws std::invalid_argument on syntax errors and unknown columns
+    Screener::Query compileScreen(const std::string& condition) {
+        if (!ensurePanel()) {
+            throw std::runtime_error("no data loaded for table '" + mainTable + "'");
+        }
+        if (!screener) {
+            screener = std::make_unique<Screener>(panel, catalog.getTable(mainTable));
+        }
+        return screener->compile(condition);
+    }
+    
+    // Matching ticker-years, ordered by ticker and year unless the query ranks them
+    std::vector<ScreenMatch> runScreen(const Screener::Query& query) {
+        return screener->run(query);
+    }
+    
     // Feature 1: Stock Comparison
     void stockComparison() {
         if (mainTable.empty()) {
@@ -405,98 +621,57 @@ public:
         std::cout << "Enter year: ";
         std::cin >> year;
         
+        Profiler::Scope profile("feature.compare");
         std::transform(ticker1.begin(), ticker1.end(), ticker1.begin(), ::toupper);
         std::transform(ticker2.begin(), ticker2.end(), ticker2.begin(), ::toupper);
         
-        auto columns = db.getColumnNames(mainTable);
-        
-        bool hasTicker = std::find(columns.begin(), columns.end(), "ticker") != columns.end();
-        bool hasYear = std::find(columns.begin(), columns.end(), "year") != columns.end();
-        
-        if (!hasTicker || !hasYear) {
-            std::cout << "Error: Table doesn't have required 'ticker' or 'year' columns!\n";
+        if (!ensurePanel()) {
             return;
         }
         
-        std::stringstream query;
-        query << "SELECT ";
-        
-        std::vector<std::string> numericColumns;
-        for (const auto& col : columns) {
-            if (col == "ticker" || col == "year" || col == "sector" || col == "company" || 
-                col == "id" || col == "date" || col == "period") continue;
-            numericColumns.push_back(col);
-        }
+        const auto& numericColumns = panel.metrics();
         
         if (numericColumns.empty()) {
             std::cout << "No numeric columns found for comparison!\n";
             return;
         }
         
-        query << "ticker, year";
-        for (const auto& col : numericColumns) {
-            query << ", " << col;
+        std::vector<int> foundTickers;
+        for (const auto& ticker : {ticker1, ticker2}) {
+            int id = panel.tickerId(ticker);
+            if (panel.hasRow(id, year) && std::find(foundTickers.begin(), foundTickers.end(), id) == foundTickers.end()) {
+                foundTickers.push_back(id);
+            }
         }
         
-        query << " FROM " << mainTable 
-              << " WHERE (ticker = '" << ticker1 << "' OR ticker = '" << ticker2 << "') "
-              << "AND year = " << year;
+        if (foundTickers.empty()) {
+            std::cout << "No data found for the specified tickers and year.\n";
+            return;
+        }
         
-        try {
-            auto results = db.executeQuery(query.str());
-            
-            if (results.empty()) {
-                std::cout << "No data found for the specified tickers and year.\n";
-                return;
-            }
-            
-            std::cout << "\n" << std::string(80, '=') << "\n";
-            std::cout << std::left << std::setw(25) << "METRIC";
-            
-            std::vector<std::string> foundTickers;
-            for (const auto& row : results) {
-                std::string ticker = row.at("ticker");
-                if (std::find(foundTickers.begin(), foundTickers.end(), ticker) == foundTickers.end()) {
-                    foundTickers.push_back(ticker);
-                }
-            }
-            
-            for (const auto& ticker : foundTickers) {
-                std::cout << std::setw(25) << ticker;
-            }
-            std::cout << "\n" << std::string(80, '=') << "\n";
-            
-            for (const auto& col : numericColumns) {
-                std::cout << std::left << std::setw(25) << col;
-                for (const auto& ticker : foundTickers) {
-                    bool found = false;
-                    for (const auto& row : results) {
-                        if (row.at("ticker") == ticker) {
-                            std::string value = row.at(col);
-                            if (value != "N/A") {
-                                try {
-                                    double numValue = std::stod(value);
-                                    // Always format in millions for financial metrics
-                                    std::cout << std::setw(25) << formatMillions(numValue);
-                                } catch (...) {
-                                    std::cout << std::setw(25) << value;
-                                }
-                            } else {
-                                std::cout << std::setw(25) << "N/A";
-                            }
-                            found = true;
-                            break;
-                        }
-                    }
-                    if (!found) {
-                        std::cout << std::setw(25) << "N/A";
-                    }
+        std::cout << "\n" << std::string(80, '=') << "\n";
+        std::cout << std::left << std::setw(25) << "METRIC";
+        
+        for (int id : foundTickers) {
+            std::cout << std::setw(25) << panel.tickerName(id);
+        }
+        std::cout << "\n" << std::string(80, '=') << "\n";
+        
+        for (size_t m = 0; m < numericColumns.size(); ++m) {
+            std::cout << std::left << std::setw(25) << numericColumns[m];
+            for (int id : foundTickers) {
+                double value = panel.value(static_cast<int>(m), id, year);
+                if (!std::isnan(value) && isRatioMetric(panel, static_cast<int>(m))) {
+                    // Ratios are plain numbers (percentages or multiples)
+                    std::cout << std::setw(25) << formatter.fixed(value, 2);
+                } else if (!std::isnan(value)) {
+                    // Always format in millions for financial metrics
+                    std::cout << std::setw(25) << formatMillionsView(value);
+                } else {
+                    std::cout << std::setw(25) << "N/A";
                 }
-                std::cout << "\n";
             }
-            
-        } catch (const std::exception& e) {
-            std::cout << "Error fetching data: " << e.what() << "\n";
+            std::cout << "\n";
         }
     }
     
@@ -507,33 +682,32 @@ public:
             return;
         }
         
-        auto columns = db.getColumnNames(mainTable);
-        
-        bool hasSector = std::find(columns.begin(), columns.end(), "sector") != columns.end();
-        
-        if (!hasSector) {
+        if (!mainTableHasColumn("sector")) {
             std::cout << "No sector information found in the database.\n";
             return;
         }
         
+        if (!ensurePanel()) {
+            return;
+        }
+        
         std::cout << "\n=== SECTOR ANALYSIS ===\n";
         
-        try {
-            auto sectorResults = db.executeQuery("SELECT DISTINCT sector FROM " + mainTable + " WHERE sector IS NOT NULL AND sector != 'N/A';");
-            if (sectorResults.empty()) {
-                std::cout << "No sectors found in the database.\n";
-                return;
-            }
-            
-            std::cout << "Available sectors:\n";
-            for (const auto& row : sectorResults) {
-                std::cout << " - " << row.at("sector") << "\n";
-            }
-        } catch (const std::exception& e) {
-            std::cout << "Error getting sectors: " << e.what() << "\n";
+        std::vector<std::string> sectors;
+        for (const auto& name : panel.sectors()) {
+            if (name != "N/A") sectors.push_back(name);
+        }
+        
+        if (sectors.empty()) {
+            std::cout << "No sectors found in the database.\n";
             return;
         }
         
+        std::cout << "Available sectors:\n";
+        for (const auto& name : sectors) {
+            std::cout << " - " << name << "\n";
+        }
+        
         std::string sector;
         int year;
         
@@ -543,79 +717,32 @@ public:
         std::cout << "Enter year: ";
         std::cin >> year;
         
-        std::string metricColumn;
-        for (const auto& col : columns) {
-            if (col != "ticker" && col != "year" && col != "sector" && col != "id" && 
-                col != "company" && col != "date" && col != "period") {
-                metricColumn = col;
-                break;
-            }
-        }
-        
-        if (metricColumn.empty()) {
+        Profiler::Scope profile("feature.sector");
+        if (panel.metrics().empty()) {
             std::cout << "No numeric metrics found for analysis.\n";
             return;
         }
         
-        std::string query = "SELECT ticker, " + metricColumn + " FROM " + mainTable + 
-                           " WHERE sector = '" + sector + "' AND year = " + std::to_string(year) + 
-                           " AND " + metricColumn + " IS NOT NULL AND " + metricColumn + " != 'N/A';";
+        const std::string& metricColumn = panel.metrics()[0];
+        const SectorAggregate* stats = sectorAggregate(sector, year, metricColumn);
         
-        try {
-            auto results = db.executeQuery(query);
-            
-            if (results.empty()) {
-                std::cout << "No data found for sector '" << sector << "' in year " << year << "\n";
-                return;
-            }
-            
-            std::vector<double> values;
-            for (const auto& row : results) {
-                try {
-                    values.push_back(std::stod(row.at(metricColumn)));
-                } catch (...) {
-                    // Skip non-numeric values
-                }
-            }
-            
-            if (values.empty()) {
-                std::cout << "No numeric data found for analysis.\n";
-                return;
-            }
-            
-            // Calculate advanced statistics
-            std::sort(values.begin(), values.end());
-            double sum = 0.0;
-            for (double val : values) sum += val;
-            double average = sum / values.size();
-            double median = values.size() % 2 == 0 ? 
-                (values[values.size()/2 - 1] + values[values.size()/2]) / 2.0 : 
-                values[values.size()/2];
-            
-            // Standard deviation
-            double variance = 0.0;
-            for (double val : values) {
-                variance += (val - average) * (val - average);
-            }
-            variance /= values.size();
-            double std_dev = std::sqrt(variance);
-            
-            std::cout << "\n" << std::string(60, '=') << "\n";
-            std::cout << "SECTOR ANALYSIS: " << sector << " (" << year << ")\n";
-            std::cout << "Metric: " << metricColumn << "\n";
-            std::cout << std::string(60, '=') << "\n";
-            std::cout << "Companies analyzed: " << values.size() << "\n";
-            std::cout << "Average: " << formatMillions(average) << "\n";
-            std::cout << "Median: " << formatMillions(median) << "\n";
-            std::cout << "Standard Deviation: " << formatMillions(std_dev) << "\n";
-            std::cout << "Min: " << formatMillions(values.front()) << "\n";
-            std::cout << "Max: " << formatMillions(values.back()) << "\n";
-            std::cout << "25th Percentile: " << formatMillions(values[values.size()/4]) << "\n";
-            std::cout << "75th Percentile: " << formatMillions(values[3*values.size()/4]) << "\n";
-            
-        } catch (const std::exception& e) {
-            std::cout << "Error in sector analysis: " << e.what() << "\n";
+        if (!stats) {
+            std::cout << "No data found for sector '" << sector << "' in year " << year << "\n";
+            return;
         }
+        
+        std::cout << "\n" << std::string(60, '=') << "\n";
+        std::cout << "SECTOR ANALYSIS: " << sector << " (" << year << ")\n";
+        std::cout << "Metric: " << metricColumn << "\n";
+        std::cout << std::string(60, '=') << "\n";
+        std::cout << "Companies analyzed: " << stats->count << "\n";
+        std::cout << "Average: " << formatMillions(stats->mean) << "\n";
+        std::cout << "Median: " << formatMillions(stats->median()) << "\n";
+        std::cout << "Standard Deviation: " << formatMillions(stats->stdDev()) << "\n";
+        std::cout << "Min: " << formatMillions(stats->min) << "\n";
+        std::cout << "Max: " << formatMillions(stats->max) << "\n";
+        std::cout << "25th Percentile: " << formatMillions(stats->percentile(0.25)) << "\n";
+        std::cout << "75th Percentile: " << formatMillions(stats->percentile(0.75)) << "\n";
     }
     
     // Feature 3: Portfolio Screener
@@ -625,44 +752,59 @@ public:
             return;
         }
         
-        auto columns = db.getColumnNames(mainTable);
+        if (!ensurePanel()) {
+            return;
+        }
         
         std::cout << "\n=== PORTFOLIO SCREENER ===\n";
         std::cout << "Available numeric columns for screening:\n";
-        for (const auto& col : columns) {
-            if (col != "ticker" && col != "year" && col != "sector" && col != "id" && 
-                col != "company" && col != "date" && col != "period") {
-                std::cout << " - " << col << "\n";
-            }
+        for (const auto& col : panel.metrics()) {
+            std::cout << " - " << col << "\n";
         }
+        std::cout << " - year (also: ticker = 'AAPL', sector = 'Technology')\n";
         
         std::string condition;
-        std::cout << "\nEnter screening condition (e.g., \"revenue > 1000 AND net_income > 500\"):\n";
+        std::cout << "\nEnter screening condition (e.g., \"revenue > 1000 AND net_income > 500\"),\n";
+        std::cout << "optionally ranked: \"... ORDER BY net_income DESC LIMIT 10\"\n";
         std::cout << "NOTE: Values should be in millions (e.g., 1000 for 1 billion)\n";
         std::cin.ignore();
         std::getline(std::cin, condition);
         
+        Profiler::Scope profile("feature.screen");
         if (condition.empty()) {
             std::cout << "No condition provided.\n";
             return;
         }
         
-        std::string query = "SELECT ticker, year FROM " + mainTable + " WHERE " + condition + " ORDER BY ticker, year;";
-        
         try {
-            auto results = db.executeQuery(query);
+            auto query = compileScreen(condition);
+            auto results = runScreen(query);
+            bool ranked = query.rankMetric >= 0;
             
             std::cout << "\n" << std::string(60, '=') << "\n";
             std::cout << "SCREENER RESULTS: " << results.size() << " companies found\n";
             std::cout << std::string(60, '=') << "\n";
             
             if (!results.empty()) {
-                std::cout << std::left << std::setw(10) << "Ticker" << std::setw(10) << "Year" << "\n";
-                std::cout << std::string(20, '-') << "\n";
+                std::cout << std::left << std::setw(10) << "Ticker" << std::setw(10) << "Year";
+                if (ranked) std::cout << panel.metrics()[query.rankMetric];
+                std::cout << "\n" << std::string(ranked ? 40 : 20, '-') << "\n";
                 
-                for (const auto& row : results) {
-                    std::cout << std::left << std::setw(10) << row.at("ticker")
-                              << std::setw(10) << row.at("year") << "\n";
+                // Amounts in K/M/B; ratios would round to whole numbers that way
+                bool ratio = ranked && isRatioMetric(panel, query.rankMetric);
+                for (const auto& match : results) {
+                    std::cout << std::left << std::setw(10) << panel.tickerName(match.tickerId)
+                              << std::setw(10) << match.year;
+                    if (ranked) {
+                        if (std::isnan(match.rankValue)) {
+                            std::cout << "N/A";
+                        } else if (ratio) {
+                            std::cout << formatter.fixed(match.rankValue, 2);
+                        } else {
+                            std::cout << formatMillionsView(match.rankValue);
+                        }
+                    }
+                    std::cout << "\n";
                 }
             } else {
                 std::cout << "No companies matched your criteria.\n";
@@ -690,10 +832,9 @@ public:
         std::cout << "Enter year: ";
         std::cin >> year;
         
+        Profiler::Scope profile("feature.ratios");
         std::transform(ticker.begin(), ticker.end(), ticker.begin(), ::toupper);
         
-        auto columns = db.getColumnNames(mainTable);
-        
         // Try to get common financial metrics
         std::map<std::string, double> metrics;
         std::vector<std::string> metricNames = {
@@ -703,28 +844,22 @@ public:
             "ebitda", "eps", "shares_outstanding"
         };
         
-        std::stringstream query;
-        query << "SELECT * FROM " << mainTable 
-              << " WHERE ticker = '" << ticker << "' AND year = " << year;
+        if (!ensurePanel()) {
+            return;
+        }
         
         try {
-            auto results = db.executeQuery(query.str());
-            
-            if (results.empty()) {
+            int tickerId = panel.tickerId(ticker);
+            if (!panel.hasRow(tickerId, year)) {
                 std::cout << "No data found for " << ticker << " in year " << year << "\n";
                 return;
             }
             
             // Extract available metrics
-            for (const auto& row : results) {
-                for (const auto& metric : metricNames) {
-                    if (row.find(metric) != row.end() && row.at(metric) != "N/A") {
-                        try {
-                            metrics[metric] = std::stod(row.at(metric));
-                        } catch (...) {
-                            metrics[metric] = 0.0;
-                        }
-                    }
+            for (const auto& metric : metricNames) {
+                double value = panel.value(panel.metricId(metric), tickerId, year);
+                if (!std::isnan(value)) {
+                    metrics[metric] = value;
                 }
             }
             
@@ -740,49 +875,30 @@ public:
             if (metrics.count("total_assets")) std::cout << "Total Assets: " << formatMillions(metrics["total_assets"]) << "\n";
             if (metrics.count("total_liabilities")) std::cout << "Total Liabilities: " << formatMillions(metrics["total_liabilities"]) << "\n";
             
-            std::cout << "\nPROFITABILITY RATIOS:\n";
-            // Calculate and display ratios
-            if (metrics.count("net_income") && metrics.count("revenue") && metrics["revenue"] != 0) {
-                double net_margin = (metrics["net_income"] / metrics["revenue"]) * 100;
-                std::cout << "Net Profit Margin: " << std::fixed << std::setprecision(2) << net_margin << "%\n";
-            }
-            
-            if (metrics.count("gross_profit") && metrics.count("revenue") && metrics["revenue"] != 0) {
-                double gross_margin = (metrics["gross_profit"] / metrics["revenue"]) * 100;
-                std::cout << "Gross Margin: " << std::fixed << std::setprecision(2) << gross_margin << "%\n";
-            }
+            // Ratios come precomputed for the whole panel (see RatioEngine)
+            auto printRatio = [&](const char* label, const char* ratio, const char* unit) {
+                double value = panel.value(panel.metricId(ratio), tickerId, year);
+                if (!std::isnan(value)) {
+                    std::cout << label << ": " << std::fixed << std::setprecision(2) << value << unit << "\n";
+                }
+            };
             
-            if (metrics.count("ebitda") && metrics.count("revenue") && metrics["revenue"] != 0) {
-                double ebitda_margin = (metrics["ebitda"] / metrics["revenue"]) * 100;
-                std::cout << "EBITDA Margin: " << std::fixed << std::setprecision(2) << ebitda_margin << "%\n";
-            }
+            std::cout << "\nPROFITABILITY RATIOS:\n";
+            printRatio("Net Profit Margin", "net_margin", "%");
+            printRatio("Gross Margin", "gross_margin", "%");
+            printRatio("Operating Margin", "operating_margin", "%");
+            printRatio("EBITDA Margin", "ebitda_margin", "%");
+            printRatio("Free Cash Flow Margin", "fcf_margin", "%");
             
             std::cout << "\nLIQUIDITY & SOLVENCY RATIOS:\n";
-            if (metrics.count("current_assets") && metrics.count("current_liabilities") && metrics["current_liabilities"] != 0) {
-                double current_ratio = metrics["current_assets"] / metrics["current_liabilities"];
-                std::cout << "Current Ratio: " << std::fixed << std::setprecision(2) << current_ratio << "x\n";
-            }
-            
-            if (metrics.count("total_liabilities") && metrics.count("total_assets") && metrics["total_assets"] != 0) {
-                double debt_ratio = (metrics["total_liabilities"] / metrics["total_assets"]) * 100;
-                std::cout << "Debt Ratio: " << std::fixed << std::setprecision(2) << debt_ratio << "%\n";
-            }
-            
-            if (metrics.count("long_term_debt") && metrics.count("ebitda") && metrics["ebitda"] != 0) {
-                double debt_ebitda = metrics["long_term_debt"] / metrics["ebitda"];
-                std::cout << "Debt/EBITDA: " << std::fixed << std::setprecision(2) << debt_ebitda << "x\n";
-            }
+            printRatio("Current Ratio", "current_ratio", "x");
+            printRatio("Debt Ratio", "debt_ratio", "%");
+            printRatio("Debt/Equity", "debt_to_equity", "x");
+            printRatio("Debt/EBITDA", "debt_to_ebitda", "x");
             
             std::cout << "\nRETURN RATIOS:\n";
-            if (metrics.count("net_income") && metrics.count("shareholders_equity") && metrics["shareholders_equity"] != 0) {
-                double roe = (metrics["net_income"] / metrics["shareholders_equity"]) * 100;
-                std::cout << "Return on Equity (ROE): " << std::fixed << std::setprecision(2) << roe << "%\n";
-            }
-            
-            if (metrics.count("operating_income") && metrics.count("total_assets") && metrics["total_assets"] != 0) {
-                double roa = (metrics["operating_income"] / metrics["total_assets"]) * 100;
-                std::cout << "Return on Assets (ROA): " << std::fixed << std::setprecision(2) << roa << "%\n";
-            }
+            printRatio("Return on Equity (ROE)", "roe", "%");
+            printRatio("Return on Assets (ROA)", "roa", "%");
             
             std::cout << std::string(70, '=') << "\n";
             
@@ -806,31 +922,39 @@ public:
         std::cout << "Enter ticker: ";
         std::cin >> ticker;
         
-        auto columns = db.getColumnNames(mainTable);
+        if (!ensurePanel()) {
+            return;
+        }
+        bool quarterly = askQuarterly();
+        
         std::cout << "Available metrics:\n";
-        for (const auto& col : columns) {
-            if (col != "ticker" && col != "year" && col != "sector" && col != "id" && 
-                col != "company" && col != "date" && col != "period") {
-                std::cout << " - " << col << "\n";
-            }
+        for (const auto& col : quarterly ? quarterlyPanel.metrics() : panel.metrics()) {
+            std::cout << " - " << col << "\n";
         }
         
         std::cout << "Enter metric to analyze: ";
         std::cin >> metric;
-        std::cout << "Enter number of years to analyze: ";
+        std::cout << (quarterly ? "Enter number of quarters to analyze: " : "Enter number of years to analyze: ");
         std::cin >> years;
         
+        Profiler::Scope profile("feature.series");
         std::transform(ticker.begin(), ticker.end(), ticker.begin(), ::toupper);
         
-        std::stringstream query;
-        query << "SELECT year, " << metric << " FROM " << mainTable 
-              << " WHERE ticker = '" << ticker << "' AND year IS NOT NULL"
-              << " ORDER BY year DESC LIMIT " << years;
+        if (quarterly) {
+            quarterlyTimeSeries(ticker, metric, years);
+            return;
+        }
         
         try {
-            auto results = db.executeQuery(query.str());
+            int metricId = panel.metricId(metric);
+            if (metricId < 0) {
+                throw std::runtime_error("unknown numeric metric '" + metric + "'");
+            }
+            
+            int tickerId = panel.tickerId(ticker);
+            auto rowYears = panel.recentYears(tickerId, years);
             
-            if (results.empty()) {
+            if (rowYears.empty()) {
                 std::cout << "No time series data found for " << ticker << "\n";
                 return;
             }
@@ -838,14 +962,11 @@ public:
             std::vector<double> values;
             std::vector<int> years_data;
             
-            for (const auto& row : results) {
-                if (row.at(metric) != "N/A") {
-                    try {
-                        values.push_back(std::stod(row.at(metric)));
-                        years_data.push_back(std::stoi(row.at("year")));
-                    } catch (...) {
-                        // Skip invalid data
-                    }
+            for (int year : rowYears) {
+                double value = panel.value(metricId, tickerId, year);
+                if (!std::isnan(value)) {
+                    values.push_back(value);
+                    years_data.push_back(year);
                 }
             }
             
@@ -864,19 +985,43 @@ public:
                 std::cout << years_data[i] << ": " << formatMillions(values[i]) << "\n";
             }
             
-            // Calculate growth rates
+            // Kernels run over the ticker's contiguous yearly series, oldest first
+            const size_t first = static_cast<size_t>(years_data.back() - panel.minYear());
+            const size_t span = static_cast<size_t>(years_data[0] - years_data.back() + 1);
+            const double* series = panel.series(metricId, tickerId) + first;
+            std::vector<double> growth(span), mean(span), stdDev(span), zScore(span), drawdown(span);
+            TimeSeries::growth(series, span, 1, growth.data());
+            TimeSeries::rollingStats(series, span, span, 2, mean.data(), stdDev.data());
+            TimeSeries::zScore(series, span, mean.data(), stdDev.data(), zScore.data());
+            TimeSeries::maxDrawdown(series, span, drawdown.data());
+            
             std::cout << "\nGROWTH ANALYSIS:\n";
-            for (size_t i = 1; i < values.size(); ++i) {
-                double growth = ((values[i-1] - values[i]) / values[i]) * 100;
-                std::cout << years_data[i] << " to " << years_data[i-1] << ": " 
-                          << std::fixed << std::setprecision(2) << growth << "%\n";
+            for (size_t i = span; i-- > 1;) {
+                if (std::isnan(series[i]) || std::isnan(series[i - 1])) continue;
+                int year = years_data.back() + static_cast<int>(i);
+                std::cout << year - 1 << " to " << year << ": ";
+                if (std::isnan(growth[i])) {
+                    std::cout << "N/A (non-positive base)\n";
+                } else {
+                    std::cout << std::fixed << std::setprecision(2) << growth[i] * 100 << "%\n";
+                }
             }
             
-            // Calculate CAGR if we have enough data
-            if (values.size() >= 2) {
-                double cagr = (std::pow(values[0] / values.back(), 1.0 / (years_data[0] - years_data.back())) - 1) * 100;
-                std::cout << "\nCAGR (" << years_data.back() << "-" << years_data[0] << "): " 
-                          << std::fixed << std::setprecision(2) << cagr << "%\n";
+            double cagr = TimeSeries::cagr(values.back(), values[0], years_data[0] - years_data.back()) * 100;
+            std::cout << "\nCAGR (" << years_data.back() << "-" << years_data[0] << "): ";
+            if (std::isnan(cagr)) {
+                std::cout << "N/A (no positive start/end values)\n";
+            } else {
+                std::cout << std::fixed << std::setprecision(2) << cagr << "%\n";
+            }
+            
+            std::cout << "Volatility (std / |mean|): " << std::fixed << std::setprecision(2)
+                      << stdDev.back() / std::abs(mean.back()) * 100 << "%\n";
+            if (!std::isnan(zScore.back())) {
+                std::cout << "Latest Z-Score: " << std::fixed << std::setprecision(2) << zScore.back() << "\n";
+            }
+            if (!std::isnan(drawdown.back())) {
+                std::cout << "Max Drawdown: " << std::fixed << std::setprecision(2) << drawdown.back() * 100 << "%\n";
             }
             
         } catch (const std::exception& e) {
@@ -884,10 +1029,110 @@ public:
         }
     }
     
-    // Feature 6: Monte Carlo Simulation - CORRIGIDA
-    void monteCarloSimulation() {
-        if (mainTable.empty()) {
-            std::cout << "No suitable table found for financial data!\n";
+    // Quarterly counterpart of timeSeriesAnalysis(): the last `quarters` quarters
+    // with QoQ and YoY growth and an annualized CAGR
+    void quarterlyTimeSeries(const std::string& ticker, const std::string& metric, int quarters) {
+        try {
+            int metricId = quarterlyPanel.metricId(metric);
+            if (metricId < 0) {
+                throw std::runtime_error("unknown numeric metric '" + metric + "'");
+            }
+            int tickerId = quarterlyPanel.tickerId(ticker);
+            if (tickerId < 0 || quarters < 2) {
+                std::cout << "No time series data found for " << ticker << "\n";
+                return;
+            }
+            
+            // Trailing window ending at the ticker's latest reported quarter
+            const float* series = quarterlyPanel.series(metricId, tickerId);
+            size_t points = static_cast<size_t>(quarterlyPanel.periodCount());
+            while (points > 0 && std::isnan(series[points - 1])) --points;
+            size_t span = std::min(points, static_cast<size_t>(quarters));
+            size_t first = points - span;
+            if (std::count_if(series + first, series + points, [](float v) { return !std::isnan(v); }) < 2) {
+                std::cout << "Insufficient data for time series analysis.\n";
+                return;
+            }
+            
+            std::vector<double> qoq(points), yoy(points);
+            TimeSeries::growth(series, points, 1, qoq.data());
+            TimeSeries::growth(series, points, 4, yoy.data());
+            auto label = [&](size_t index) {
+                return std::to_string(quarterlyPanel.minYear() + static_cast<int>(index / 4)) + " " +
+                       quarterlyPanel.periodLabel(static_cast<int>(index % 4));
+            };
+            
+            std::cout << "\n" << std::string(60, '=') << "\n";
+            std::cout << "QUARTERLY TIME SERIES: " << ticker << " - " << metric << "\n";
+            std::cout << std::string(60, '=') << "\n";
+            std::cout << std::left << std::setw(12) << "Quarter" << std::setw(16) << "Value"
+                      << std::setw(12) << "QoQ" << "YoY\n";
+            auto percent = [](double value) {
+                if (std::isnan(value)) return std::string("N/A");
+                std::ostringstream text;
+                text << std::fixed << std::setprecision(2) << value * 100 << "%";
+                return text.str();
+            };
+            size_t oldest = points, newest = 0;
+            for (size_t i = points; i-- > first;) {
+                if (std::isnan(series[i])) continue;
+                oldest = i;
+                newest = std::max(newest, i);
+                std::cout << std::left << std::setw(12) << label(i) << std::setw(16) << formatMillions(series[i])
+                          << std::setw(12) << percent(qoq[i]) << percent(yoy[i]) << "\n";
+            }
+            
+            double cagr = TimeSeries::cagr(series[oldest], series[newest], (newest - oldest) / 4.0);
+            std::cout << "\nAnnualized CAGR (" << label(oldest) << " - " << label(newest) << "): " << percent(cagr) << "\n";
+            
+        } catch (const std::exception& e) {
+            std::cout << "Error in time series analysis: " << e.what() << "\n";
+        }
+    }
+    
+    // Feature 6: Monte Carlo Simulation - CORRIGIDA
+    // Interactive mode runs work on the scheduler while this thread shows the
+    // elapsed time, and Ctrl+C cancels it (the parallel Monte Carlo engines stop
+    // at their next chunk). Command-line mode runs it inline. Exceptions from
+    // work propagate; returns false when it was cancelled.
+    bool runInBackground(const std::string& label, const std::function<void(const CancellationToken&)>& work) {
+        CancellationToken token;
+        if (!interactive) {
+            work(token);
+            return true;
+        }
+        
+        mcSimulator.setCancellation(token);
+        interruptRequested = false;
+        auto previousHandler = std::signal(SIGINT, requestInterrupt);
+        auto job = scheduler.submit([&work, &token] { work(token); });
+        
+        auto start = std::chrono::steady_clock::now();
+        size_t shown = 0;
+        while (job.wait_for(std::chrono::milliseconds(200)) != std::future_status::ready) {
+            if (interruptRequested) token.cancel();
+            double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::string line = label + "... " + std::string(formatter.fixed(elapsed, 1, " s")) +
+                               (token.cancelled() ? " (cancelling)" : " (Ctrl+C to cancel)");
+            std::cout << "\r" << line << std::string(shown > line.size() ? shown - line.size() : 0, ' ') << std::flush;
+            shown = line.size();
+        }
+        if (shown) std::cout << "\r" << std::string(shown, ' ') << "\r" << std::flush;
+        std::signal(SIGINT, previousHandler);
+        mcSimulator.clearCancellation();
+        
+        try {
+            job.get();
+        } catch (const OperationCancelled&) {
+            std::cout << label << " cancelled.\n";
+            return false;
+        }
+        return true;
+    }
+    
+    void monteCarloSimulation() {
+        if (mainTable.empty()) {
+            std::cout << "No suitable table found for financial data!\n";
             return;
         }
         
@@ -899,6 +1144,16 @@ public:
         std::cout << "Use test data for demonstration? (y/n): ";
         std::cin >> useTestData;
         
+        int varianceChoice;
+        std::cout << "Variance reduction (0=none, 1=antithetic, 2=control variate, 3=quasi-random): ";
+        std::cin >> varianceChoice;
+        switch (varianceChoice) {
+            case 1: mcSimulator.setVarianceReduction(VarianceReduction::Antithetic); break;
+            case 2: mcSimulator.setVarianceReduction(VarianceReduction::ControlVariate); break;
+            case 3: mcSimulator.setVarianceReduction(VarianceReduction::QuasiRandom); break;
+            default: mcSimulator.setVarianceReduction(VarianceReduction::None); break;
+        }
+        
         if (useTestData == 'y' || useTestData == 'Y') {
             runMonteCarloTests();
             return;
@@ -913,13 +1168,14 @@ public:
         std::cout << "Enter ticker: ";
         std::cin >> ticker;
         
-        auto columns = db.getColumnNames(mainTable);
+        if (!ensurePanel()) {
+            return;
+        }
+        bool quarterly = askQuarterly();
+        
         std::cout << "Available metrics for simulation:\n";
-        for (const auto& col : columns) {
-            if (col != "ticker" && col != "year" && col != "sector" && col != "id" && 
-                col != "company" && col != "date" && col != "period") {
-                std::cout << " - " << col << "\n";
-            }
+        for (const auto& col : quarterly ? quarterlyPanel.metrics() : panel.metrics()) {
+            std::cout << " - " << col << "\n";
         }
         
         std::cout << "Enter metric: ";
@@ -929,76 +1185,152 @@ public:
         std::cout << "Enter years for projection: ";
         std::cin >> years_projection;
         
-        std::transform(ticker.begin(), ticker.end(), ticker.begin(), ::toupper);
+        // Bootstrap: resample the actual historical returns instead of fitting a normal
+        int returnModel;
+        double blockLength = 1.0;
+        char poolSector = 'n';
+        std::cout << "Return model (0=fitted GBM, 1=block bootstrap, 2=stationary bootstrap): ";
+        std::cin >> returnModel;
+        const bool bootstrap = returnModel == 1 || returnModel == 2;
+        const BootstrapMode bootstrapMode = returnModel == 1 ? BootstrapMode::Block : BootstrapMode::Stationary;
+        if (bootstrap) {
+            std::cout << "Mean block length in periods (e.g. 2): ";
+            std::cin >> blockLength;
+            std::cout << "Pool the returns of every ticker in the same sector? (y/n): ";
+            std::cin >> poolSector;
+        }
+        const bool pooled = bootstrap && (poolSector == 'y' || poolSector == 'Y');
+        
+        Profiler::Scope profile("feature.montecarlo");
+        if (simulations < 1 || years_projection < 1) {
+            std::cout << "Simulations and projection years must be positive.\n";
+            return;
+        }
+        if (bootstrap && !(blockLength >= 1.0)) {
+            std::cout << "The block length must be at least 1 period.\n";
+            return;
+        }
         
-        // Get historical data for parameter estimation
-        std::stringstream query;
-        query << "SELECT year, " << metric << " FROM " << mainTable 
-              << " WHERE ticker = '" << ticker << "' AND " << metric << " IS NOT NULL"
-              << " AND " << metric << " != 'N/A'"
-              << " ORDER BY year ASC";  // Ordem ascendente para cálculos corretos
+        std::transform(ticker.begin(), ticker.end(), ticker.begin(), ::toupper);
         
         try {
-            auto results = db.executeQuery(query.str());
-            
-            if (results.size() < 3) {
-                std::cout << "Insufficient historical data for simulation (need at least 3 data points).\n";
-                std::cout << "Available data points: " << results.size() << "\n";
-                return;
-            }
-            
-            // Extrair valores históricos
+            // Extrair valores históricos (ordem ascendente para cálculos corretos)
             std::vector<double> historical_values;
             std::vector<int> years;
-            
-            for (const auto& row : results) {
-                try {
-                    historical_values.push_back(std::stod(row.at(metric)));
-                    years.push_back(std::stoi(row.at("year")));
-                } catch (...) {
-                    // Skip invalid data
+            ReturnHistory history;
+            std::string poolName;
+            auto collect = [&](const auto& source) {
+                int metricId = source.metricId(metric);
+                int tickerId = source.tickerId(ticker);
+                if (metricId < 0) {
+                    throw std::runtime_error("unknown numeric metric '" + metric + "'");
                 }
+                if (tickerId < 0) return;
+                const auto* series = source.series(metricId, tickerId);
+                for (int offset = 0; offset < source.periodCount(); ++offset) {
+                    if (!std::isnan(series[offset])) {
+                        historical_values.push_back(series[offset]);
+                        years.push_back(source.minYear() + offset / source.periodsPerYear());
+                    }
+                }
+                if (!bootstrap) return;
+                history.addSeries(series, source.periodCount());
+                if (!pooled) return;
+                
+                // Peers: the tickers in the same sector at the ticker's latest classified period
+                const size_t periods = source.periodCount();
+                const int* sectors = source.sectorCells();
+                int latest = static_cast<int>(periods) - 1;
+                while (latest >= 0 && sectors[tickerId * periods + latest] < 0) --latest;
+                if (latest < 0) {
+                    throw std::runtime_error(ticker + " has no sector to pool returns from");
+                }
+                int sectorId = sectors[tickerId * periods + latest];
+                poolName = source.sectors()[sectorId];
+                for (size_t peer = 0; peer < source.tickerCount(); ++peer) {
+                    if (static_cast<int>(peer) != tickerId && sectors[peer * periods + latest] == sectorId) {
+                        history.addSeries(source.series(metricId, static_cast<int>(peer)), periods);
+                    }
+                }
+            };
+            if (quarterly) {
+                collect(quarterlyPanel);
+            } else {
+                collect(panel);
             }
+            history.finish();
             
             if (historical_values.size() < 3) {
-                std::cout << "Insufficient valid data points for simulation.\n";
+                std::cout << "Insufficient historical data for simulation (need at least 3 data points).\n";
+                std::cout << "Available data points: " << historical_values.size() << "\n";
                 return;
             }
             
             // Calcular retornos logarítmicos e volatilidade
-            std::vector<double> log_returns;
-            for (size_t i = 1; i < historical_values.size(); ++i) {
-                if (historical_values[i-1] > 0) {
-                    double log_return = std::log(historical_values[i] / historical_values[i-1]);
-                    log_returns.push_back(log_return);
-                }
-            }
-            
-            if (log_returns.empty()) {
+            const int periodsPerYear = quarterly ? 4 : 1;
+            auto model = MonteCarloSimulator::fitGrowthModel(years, historical_values, periodsPerYear);
+            if (!model) {
                 std::cout << "Cannot calculate returns from the data.\n";
                 return;
             }
             
-            // Calcular média e desvio padrão dos retornos
-            double mean_return = std::accumulate(log_returns.begin(), log_returns.end(), 0.0) / log_returns.size();
-            double variance = 0.0;
-            for (double ret : log_returns) {
-                variance += (ret - mean_return) * (ret - mean_return);
-            }
-            double volatility = std::sqrt(variance / log_returns.size());
+            double mean_return = model->meanReturn;
+            double volatility = model->volatility;
+            double current_value = model->currentValue;
+            int latest_year = model->latestYear;
             
-            double current_value = historical_values.back();
-            int latest_year = years.back();
+            std::string returnModelName;
+            if (bootstrap) {
+                if (history.empty()) {
+                    std::cout << "No consecutive positive values to resample.\n";
+                    return;
+                }
+                std::ostringstream name;
+                name << bootstrapModeName(bootstrapMode) << " (block " << std::setprecision(3) << blockLength
+                     << (periodsPerYear > 1 ? " quarters, " : " years, ") << history.size() << " returns from "
+                     << history.series() << (history.series() == 1 ? " ticker" : " tickers");
+                if (pooled) name << " in " << poolName;
+                name << ")";
+                returnModelName = name.str();
+            }
             
-            // Executar simulação Monte Carlo
-            auto paths = mcSimulator.simulateGBM(current_value, mean_return, volatility, years_projection, simulations);
-            auto stats = mcSimulator.calculateStatistics(paths);
+            // Executar simulação Monte Carlo (quarterly: four steps of 0.25 years per projection year)
+            std::string cacheKey = ResultCache::makeKey(
+                "montecarlo", ticker, metric, periodsPerYear, simulations, years_projection,
+                static_cast<int>(mcSimulator.getVarianceReduction()), mcSimulator.getSeed(),
+                seriesFingerprint(years, historical_values), returnModel, blockLength, pooled,
+                ResultCache::fingerprint(history.returns(), history.size() * sizeof(double)));
+            std::map<std::string, double> stats;
+            if (const auto* cached = resultCache.find(cacheKey)) {
+                stats = *cached;
+                std::cout << "(cached result)\n";
+            } else {
+                bool finished = runInBackground("Simulating", [&](const CancellationToken&) {
+                    if (bootstrap) {
+                        auto terminal = mcSimulator.simulateBootstrap(history, bootstrapMode, blockLength, current_value,
+                                                                      years_projection * periodsPerYear, simulations);
+                        stats = mcSimulator.calculateStatistics(terminal);
+                        return;
+                    }
+                    mcSimulator.setTimeStep(1.0 / periodsPerYear);
+                    auto terminal = mcSimulator.simulateGBMCheckpoints(current_value, mean_return, volatility,
+                                                                       years_projection * periodsPerYear, simulations);
+                    mcSimulator.setTimeStep(1.0);
+                    stats = mcSimulator.calculateStatistics(terminal);
+                });
+                if (!finished) {
+                    mcSimulator.setTimeStep(1.0);
+                    return;
+                }
+                resultCache.store(cacheKey, stats);
+            }
             
             // Mostrar resultados
             displayMonteCarloResults(ticker, metric, current_value, latest_year, 
-                                   mean_return, volatility, years_projection, simulations, stats);
+                                   mean_return, volatility, years_projection, simulations, stats, returnModelName);
             
         } catch (const std::exception& e) {
+            mcSimulator.setTimeStep(1.0);
             std::cout << "Error in Monte Carlo simulation: " << e.what() << "\n";
         }
     }
@@ -1015,90 +1347,83 @@ public:
         std::cout << "Enter ticker: ";
         std::cin >> ticker;
         
+        Profiler::Scope profile("feature.risk");
         std::transform(ticker.begin(), ticker.end(), ticker.begin(), ::toupper);
         
-        // Get volatility data
-        std::string volatilityQuery = 
-            "SELECT year, revenue, net_income, total_assets, total_liabilities "
-            "FROM " + mainTable + " WHERE ticker = '" + ticker + "' "
-            "AND year IS NOT NULL ORDER BY year DESC LIMIT 5";
+        if (!ensurePanel()) {
+            return;
+        }
         
         try {
-            auto results = db.executeQuery(volatilityQuery);
+            // Volatility data: the five most recent years, newest first
+            int tickerId = panel.tickerId(ticker);
+            auto rowYears = panel.recentYears(tickerId, 5);
             
-            if (results.size() < 3) {
+            if (rowYears.size() < 3) {
                 std::cout << "Insufficient data for risk analysis.\n";
                 return;
             }
             
-            std::map<std::string, std::vector<double>> metrics;
-            std::vector<int> years;
-            
-            for (const auto& row : results) {
-                years.push_back(std::stoi(row.at("year")));
-                
-                for (const auto& [key, value] : row) {
-                    if (key != "year" && key != "ticker" && value != "N/A") {
-                        try {
-                            metrics[key].push_back(std::stod(value));
-                        } catch (...) {
-                            // Skip conversion errors
-                        }
-                    }
-                }
-            }
+            // Window covering those rows; every statistic below reads the same trailing window
+            const int latestYear = rowYears.front();
+            const size_t window = static_cast<size_t>(latestYear - rowYears.back() + 1);
+            const size_t latest = static_cast<size_t>(latestYear - panel.minYear());
+            const size_t first = latest + 1 - window;
             
             std::cout << "\n" << std::string(60, '=') << "\n";
             std::cout << "RISK ANALYSIS: " << ticker << "\n";
             std::cout << std::string(60, '=') << "\n";
             
-            // Calculate volatility for each metric
+            const std::vector<const char*> riskMetrics = {"net_income", "revenue", "total_assets", "total_liabilities"};
+            auto latestValue = [&](const char* name) {
+                return panel.value(panel.metricId(name), tickerId, latestYear);
+            };
+            
+            // Volatility for each metric: rolling population std / |rolling mean|
             std::cout << "VOLATILITY ANALYSIS (Coefficient of Variation):\n";
-            for (const auto& [metric, values] : metrics) {
-                if (values.size() >= 3) {
-                    double mean = std::accumulate(values.begin(), values.end(), 0.0) / values.size();
-                    double variance = 0.0;
-                    for (double val : values) {
-                        variance += (val - mean) * (val - mean);
-                    }
-                    double std_dev = std::sqrt(variance / values.size());
-                    double coefficient_of_variation = (std_dev / std::abs(mean)) * 100;
-                    
-                    std::cout << metric << ": " 
+            for (const char* name : riskMetrics) {
+                int metricId = panel.metricId(name);
+                if (metricId < 0) continue;
+                
+                std::vector<double> mean(window), stdDev(window);
+                TimeSeries::rollingStats(panel.series(metricId, tickerId) + first, window, window, 3,
+                                         mean.data(), stdDev.data());
+                if (!std::isnan(mean.back())) {
+                    double coefficient_of_variation = (stdDev.back() / std::abs(mean.back())) * 100;
+                    std::cout << name << ": " 
                               << std::fixed << std::setprecision(2) << coefficient_of_variation << "%\n";
                 }
             }
             
             // Calculate financial stability ratios
             std::cout << "\nFINANCIAL STABILITY:\n";
-            if (metrics.count("total_assets") && metrics.count("total_liabilities")) {
-                auto& assets = metrics["total_assets"];
-                auto& liabilities = metrics["total_liabilities"];
+            double assets = latestValue("total_assets");
+            double liabilities = latestValue("total_liabilities");
+            if (!std::isnan(assets) && !std::isnan(liabilities)) {
+                double current_debt_ratio = liabilities / assets;
+                std::cout << "Current Debt Ratio: " << std::fixed << std::setprecision(3) << current_debt_ratio << "\n";
                 
-                if (!assets.empty() && !liabilities.empty()) {
-                    double current_debt_ratio = liabilities.back() / assets.back();
-                    std::cout << "Current Debt Ratio: " << std::fixed << std::setprecision(3) << current_debt_ratio << "\n";
-                    
-                    if (current_debt_ratio > 0.6) {
-                        std::cout << "⚠️  High debt level detected\n";
-                    } else if (current_debt_ratio > 0.4) {
-                        std::cout << "ℹ️  Moderate debt level\n";
-                    } else {
-                        std::cout << "✅ Conservative debt level\n";
-                    }
+                if (current_debt_ratio > 0.6) {
+                    std::cout << "⚠️  High debt level detected\n";
+                } else if (current_debt_ratio > 0.4) {
+                    std::cout << "ℹ️  Moderate debt level\n";
+                } else {
+                    std::cout << "✅ Conservative debt level\n";
                 }
             }
             
-            // Revenue stability analysis
-            if (metrics.count("revenue") && metrics["revenue"].size() >= 3) {
-                auto& revenue = metrics["revenue"];
+            // Revenue stability analysis: mean YoY growth over the window
+            int revenueId = panel.metricId("revenue");
+            const double* revenue = revenueId >= 0 ? panel.series(revenueId, tickerId) + first : nullptr;
+            if (revenue && std::count_if(revenue, revenue + window, [](double v) { return !std::isnan(v); }) >= 3) {
+                std::vector<double> growth(window);
+                TimeSeries::growth(revenue, window, 1, growth.data());
+                
                 double total_growth = 0.0;
                 int growth_periods = 0;
-                
-                for (size_t i = 1; i < revenue.size(); ++i) {
-                    if (revenue[i-1] > 0) {
-                        double growth = (revenue[i] - revenue[i-1]) / revenue[i-1];
-                        total_growth += growth;
+                for (size_t i = 1; i < window; ++i) {
+                    if (revenue[i - 1] > 0 && !std::isnan(growth[i])) {
+                        total_growth += growth[i];
                         growth_periods++;
                     }
                 }
@@ -1118,13 +1443,21 @@ public:
                         std::cout << "📉 Declining company\n";
                     }
                 }
+                
+                std::vector<double> drawdown(window);
+                TimeSeries::maxDrawdown(revenue, window, drawdown.data());
+                if (!std::isnan(drawdown.back())) {
+                    std::cout << "Max Revenue Drawdown: " << std::fixed << std::setprecision(2)
+                              << drawdown.back() * 100 << "%\n";
+                }
             }
             
             // Show current financial position
             std::cout << "\nCURRENT FINANCIAL POSITION (in millions):\n";
-            for (const auto& [metric, values] : metrics) {
-                if (!values.empty()) {
-                    std::cout << metric << ": " << formatMillions(values.back()) << "\n";
+            for (const char* name : riskMetrics) {
+                double value = latestValue(name);
+                if (!std::isnan(value)) {
+                    std::cout << name << ": " << formatMillions(value) << "\n";
                 }
             }
             
@@ -1135,7 +1468,8 @@ public:
     
     // Feature 8: Change Main Table
     void changeMainTable() {
-        auto tables = db.getTableNames();
+        catalog.refresh();
+        const auto& tables = catalog.getTableNames();
         
         if (tables.empty()) {
             std::cout << "No tables found in the database!\n";
@@ -1155,10 +1489,647 @@ public:
         if (choice >= 1 && choice <= static_cast<int>(tables.size())) {
             mainTable = tables[choice - 1];
             std::cout << "Main table changed to: " << mainTable << "\n";
+            if (prepareTables) prepareDatabase();
+            loadPanel();
         } else {
             std::cout << "Invalid choice!\n";
         }
     }
+    
+    // Portfolio model of `tickers` on one metric of the annual panel; empty
+    // weights = equal weights. Throws on unknown names or too little history.
+    MonteCarloSimulator::PortfolioModel fitPortfolio(std::vector<std::string> tickers, const std::string& metric,
+                                                     const std::vector<double>& weights) {
+        if (!ensurePanel()) {
+            throw std::runtime_error("main table has no ticker/year data");
+        }
+        int metricId = panel.metricId(metric);
+        if (metricId < 0) {
+            throw std::invalid_argument("unknown metric '" + metric + "'");
+        }
+        
+        std::vector<int> years;
+        for (int offset = 0; offset < panel.yearCount(); ++offset) years.push_back(panel.minYear() + offset);
+        std::vector<std::vector<double>> values;
+        for (auto& ticker : tickers) {
+            std::transform(ticker.begin(), ticker.end(), ticker.begin(), ::toupper);
+            int tickerId = panel.tickerId(ticker);
+            if (tickerId < 0) {
+                throw std::invalid_argument("unknown ticker '" + ticker + "'");
+            }
+            if (std::count(tickers.begin(), tickers.end(), ticker) > 1) {
+                throw std::invalid_argument("ticker '" + ticker + "' listed twice");
+            }
+            const double* series = panel.series(metricId, tickerId);
+            values.emplace_back(series, series + panel.yearCount());
+        }
+        return MonteCarloSimulator::fitPortfolioModel(tickers, years, values, weights);
+    }
+    
+    // Fits a growth model for every (ticker, metric) pair from the in-memory
+    // panel and runs one simulation per pair on the shared scheduler.
+    std::vector<BatchMonteCarloResult> simulateBatch(const BatchMonteCarloRequest& request,
+                                                     BatchMonteCarloSummary& summary) {
+        std::vector<BatchMonteCarloResult> results;
+        if (!ensurePanel()) {
+            return results;
+        }
+        
+        std::vector<int> metricIds;
+        for (const auto& metric : request.metrics) {
+            int id = panel.metricId(metric);
+            if (id < 0) {
+                statusOut() << "Skipping unknown metric '" << metric << "'\n";
+                continue;
+            }
+            metricIds.push_back(id);
+        }
+        
+        std::vector<int> tickerIds;
+        if (request.tickers.empty()) {
+            for (size_t t = 0; t < panel.tickerCount(); ++t) tickerIds.push_back(static_cast<int>(t));
+        } else {
+            for (auto ticker : request.tickers) {
+                std::transform(ticker.begin(), ticker.end(), ticker.begin(), ::toupper);
+                int id = panel.tickerId(ticker);
+                if (id < 0) {
+                    statusOut() << "Skipping unknown ticker '" << ticker << "'\n";
+                    continue;
+                }
+                tickerIds.push_back(id);
+            }
+        }
+        
+        // Fit every model from the panel before any simulation starts; jobs whose
+        // result is cached are answered here and not simulated again
+        std::vector<int> years;
+        std::vector<double> values;
+        std::vector<size_t> pending;
+        std::vector<std::string> pendingKeys;
+        for (int tickerId : tickerIds) {
+            for (int metricId : metricIds) {
+                summary.jobs++;
+                years.clear();
+                values.clear();
+                const double* series = panel.series(metricId, tickerId);
+                for (int offset = 0; offset < panel.yearCount(); ++offset) {
+                    if (!std::isnan(series[offset])) {
+                        years.push_back(panel.minYear() + offset);
+                        values.push_back(series[offset]);
+                    }
+                }
+                
+                auto model = MonteCarloSimulator::fitGrowthModel(years, values);
+                if (!model) {
+                    summary.skipped++;
+                    continue;
+                }
+                BatchMonteCarloResult result;
+                result.ticker = panel.tickerName(tickerId);
+                result.metric = panel.metrics()[metricId];
+                result.model = *model;
+                result.seed = jobSeed(mcSimulator.getSeed(), result.ticker + "|" + result.metric);
+                std::string cacheKey = ResultCache::makeKey(
+                    "batch", result.ticker, result.metric, request.simulations, request.years,
+                    static_cast<int>(mcSimulator.getVarianceReduction()), result.seed, seriesFingerprint(years, values));
+                if (const auto* cached = resultCache.find(cacheKey)) {
+                    result.stats = *cached;
+                    summary.cached++;
+                } else {
+                    pending.push_back(results.size());
+                    pendingKeys.push_back(std::move(cacheKey));
+                }
+                results.push_back(std::move(result));
+            }
+        }
+        
+        summary.simulated = pending.size();
+        scheduler.parallelFor(0, pending.size(), 1, [&](size_t begin, size_t end) {
+            for (size_t j = begin; j < end; ++j) {
+                BatchMonteCarloResult& job = results[pending[j]];
+                auto terminal = mcSimulator.simulateGBMCheckpointsSerial(
+                    job.model.currentValue, job.model.meanReturn, job.model.volatility,
+                    request.years, request.simulations, job.seed);
+                job.stats = mcSimulator.calculateStatistics(terminal);
+            }
+        }, mcSimulator.getCancellation());
+        
+        std::optional<Database::Transaction> transaction;
+        if (resultCache.persistent() && !pending.empty()) transaction.emplace(*resultCache.database());
+        for (size_t j = 0; j < pending.size(); ++j) {
+            resultCache.store(pendingKeys[j], results[pending[j]].stats);
+        }
+        if (transaction) transaction->commit();
+        
+        return results;
+    }
+    
+    // Stores a batch in monte_carlo_results under a new run_id, in one transaction
+    void saveBatchResults(const std::vector<BatchMonteCarloResult>& results,
+                          const BatchMonteCarloRequest& request, BatchMonteCarloSummary& summary) {
+        db.execute(
+            "CREATE TABLE IF NOT EXISTS monte_carlo_results ("
+            "run_id INTEGER NOT NULL, ticker TEXT NOT NULL, metric TEXT NOT NULL, "
+            "base_year INTEGER, current_value REAL, mean_return REAL, volatility REAL, "
+            "projection_years INTEGER, simulations INTEGER, variance_reduction TEXT, seed INTEGER, "
+            "mean REAL, std_error REAL, median REAL, p5 REAL, p25 REAL, p75 REAL, p95 REAL, "
+            "min_value REAL, max_value REAL, growth_probability REAL, "
+            "created_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP, "
+            "UNIQUE(run_id, ticker, metric));");
+        
+        Database::Transaction transaction(db);
+        auto lastRun = db.executeColumnar("SELECT COALESCE(MAX(run_id), 0) AS last_run FROM monte_carlo_results;", {});
+        summary.runId = static_cast<int64_t>(lastRun.columns[0].number(0)) + 1;
+        
+        const std::string insert =
+            "INSERT INTO monte_carlo_results (run_id, ticker, metric, base_year, current_value, "
+            "mean_return, volatility, projection_years, simulations, variance_reduction, seed, "
+            "mean, std_error, median, p5, p25, p75, p95, min_value, max_value, growth_probability) "
+            "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?);";
+        const char* mode = varianceReductionName(mcSimulator.getVarianceReduction());
+        
+        size_t saved = 0;
+        for (const auto& job : results) {
+            const auto& stats = job.stats;
+            db.executeUpdate(insert, {
+                summary.runId, job.ticker, job.metric,
+                job.model.latestYear, job.model.currentValue, job.model.meanReturn, job.model.volatility,
+                request.years, request.simulations, mode, static_cast<int64_t>(job.seed),
+                stats.at("mean"), stats.at("std_error"), stats.at("median"), stats.at("p5"),
+                stats.at("p25"), stats.at("p75"), stats.at("p95"), stats.at("min"), stats.at("max"),
+                stats.at("growth_probability")
+            });
+            saved++;
+        }
+        transaction.commit();
+        summary.completed = saved;
+    }
+    
+    // Runs a whole batch and stores all results in monte_carlo_results
+    BatchMonteCarloSummary runBatchMonteCarlo(const BatchMonteCarloRequest& request) {
+        BatchMonteCarloSummary summary;
+        auto start = std::chrono::steady_clock::now();
+        
+        auto results = simulateBatch(request, summary);
+        try {
+            saveBatchResults(results, request, summary);
+        } catch (const std::exception& e) {
+            std::cout << "Error saving batch results: " << e.what() << "\n";
+            summary.completed = 0;
+        }
+        
+        summary.elapsedMs = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+        return summary;
+    }
+    
+    // Feature 10: Batch Monte Carlo over many tickers
+    void batchMonteCarloSimulation() {
+        if (mainTable.empty()) {
+            std::cout << "No suitable table found for financial data!\n";
+            return;
+        }
+        
+        if (!ensurePanel()) {
+            return;
+        }
+        
+        std::cout << "\n=== BATCH MONTE CARLO SIMULATION ===\n";
+        std::cout << "Available metrics:\n";
+        for (const auto& col : panel.metrics()) {
+            std::cout << " - " << col << "\n";
+        }
+        
+        BatchMonteCarloRequest request;
+        std::string tickers, metrics;
+        
+        std::cout << "Enter tickers (comma-separated, or ALL): ";
+        std::cin.ignore();
+        std::getline(std::cin, tickers);
+        std::cout << "Enter metrics (comma-separated): ";
+        std::getline(std::cin, metrics);
+        std::cout << "Enter number of simulations per ticker: ";
+        std::cin >> request.simulations;
+        std::cout << "Enter years for projection: ";
+        std::cin >> request.years;
+        
+        Profiler::Scope profile("feature.batch_montecarlo");
+        if (request.simulations < 1 || request.years < 1) {
+            std::cout << "Simulations and projection years must be positive.\n";
+            return;
+        }
+        
+        // ALL only as the whole answer, so lists like "AAPL,BALL" stay lists
+        request.tickers = splitList(tickers);
+        if (request.tickers.size() == 1) {
+            std::string upper = request.tickers[0];
+            std::transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
+            if (upper == "ALL") request.tickers.clear();
+        }
+        request.metrics = splitList(metrics);
+        
+        BatchMonteCarloSummary summary;
+        try {
+            if (!runInBackground("Simulating batch", [&](const CancellationToken&) { summary = runBatchMonteCarlo(request); })) {
+                return;
+            }
+        } catch (const std::exception& e) {
+            std::cout << "Error in batch simulation: " << e.what() << "\n";
+            return;
+        }
+        
+        std::cout << "\n" << std::string(60, '=') << "\n";
+        std::cout << "BATCH RESULTS (run " << summary.runId << ")\n";
+        std::cout << std::string(60, '=') << "\n";
+        std::cout << "Jobs: " << summary.jobs << "\n";
+        std::cout << "Saved: " << summary.completed << "\n";
+        std::cout << "Simulated: " << summary.simulated << "\n";
+        std::cout << "Skipped (insufficient history): " << summary.skipped << "\n";
+        if (summary.cached > 0) {
+            std::cout << "From result cache: " << summary.cached << "\n";
+        }
+        std::cout << "Elapsed: " << std::fixed << std::setprecision(1) << summary.elapsedMs << " ms\n";
+        if (summary.completed > 0) {
+            std::cout << "Results stored in table monte_carlo_results (run_id = " << summary.runId << ")\n";
+        }
+    }
+    
+    // Feature 13: Correlated Monte Carlo of a whole portfolio
+    void portfolioMonteCarlo() {
+        if (mainTable.empty()) {
+            std::cout << "No suitable table found for financial data!\n";
+            return;
+        }
+        
+        if (!ensurePanel()) {
+            return;
+        }
+        
+        std::cout << "\n=== PORTFOLIO MONTE CARLO ===\n";
+        std::cout << "Available metrics:\n";
+        for (const auto& col : panel.metrics()) {
+            std::cout << " - " << col << "\n";
+        }
+        
+        std::string tickers, metric, weights;
+        int simulations;
+        int years_projection;
+        
+        std::cout << "Enter tickers (comma-separated): ";
+        std::cin.ignore();
+        std::getline(std::cin, tickers);
+        std::cout << "Enter metric: ";
+        std::getline(std::cin, metric);
+        std::cout << "Enter weights (comma-separated, blank = equal): ";
+        std::getline(std::cin, weights);
+        std::cout << "Enter number of simulations: ";
+        std::cin >> simulations;
+        std::cout << "Enter years for projection: ";
+        std::cin >> years_projection;
+        
+        Profiler::Scope profile("feature.portfolio");
+        if (simulations < 1 || years_projection < 1) {
+            std::cout << "Simulations and projection years must be positive.\n";
+            return;
+        }
+        
+        try {
+            std::vector<double> weightValues;
+            for (const auto& weight : splitList(weights)) weightValues.push_back(std::stod(weight));
+            auto model = fitPortfolio(splitList(tickers), metric, weightValues);
+            MonteCarloSimulator::PortfolioValues values;
+            std::map<std::string, double> stats;
+            bool finished = runInBackground("Simulating portfolio", [&](const CancellationToken&) {
+                values = mcSimulator.simulatePortfolio(model, years_projection, simulations);
+                stats = mcSimulator.calculatePortfolioStatistics(values.portfolio, 1.0);
+            });
+            if (!finished) return;
+            
+            const size_t n = model.assets.size();
+            auto percent = [](double value) {
+                std::ostringstream text;
+                text << std::fixed << std::setprecision(1) << value * 100 << "%";
+                return text.str();
+            };
+            std::cout << "\n" << std::string(70, '=') << "\n";
+            std::cout << "PORTFOLIO MONTE CARLO: " << metric << " (" << n << " assets)\n";
+            std::cout << std::string(70, '=') << "\n";
+            std::cout << std::left << std::setw(12) << "Asset" << std::setw(10) << "Weight" << std::setw(16) << "Current"
+                      << std::setw(12) << "Mean Ret." << std::setw(12) << "Volatility" << "Avg. Projected\n";
+            for (size_t a = 0; a < n; ++a) {
+                const auto& asset = model.models[a];
+                double projected = std::accumulate(values.assets[a].begin(), values.assets[a].end(), 0.0) / simulations;
+                std::cout << std::left << std::setw(12) << model.assets[a] << std::setw(10) << percent(model.weights[a])
+                          << std::setw(16) << formatMillions(asset.currentValue) << std::setw(12) << percent(asset.meanReturn)
+                          << std::setw(12) << percent(asset.volatility) << formatMillions(projected) << "\n";
+            }
+            
+            std::cout << "\nCorrelation of log returns";
+            if (model.shrinkage > 0.0) {
+                std::cout << " (shrunk " << percent(model.shrinkage) << " towards identity)";
+            }
+            std::cout << ":\n" << std::setw(12) << "";
+            for (size_t b = 0; b < n; ++b) std::cout << std::right << std::setw(10) << model.assets[b];
+            std::cout << "\n";
+            for (size_t a = 0; a < n; ++a) {
+                std::cout << std::left << std::setw(12) << model.assets[a] << std::right << std::fixed << std::setprecision(2);
+                for (size_t b = 0; b < n; ++b) std::cout << std::setw(10) << model.correlation[a * n + b];
+                std::cout << "\n";
+            }
+            if (n > 1 && model.overlappingReturns < 3) {
+                std::cout << "Warning: some correlations rest on fewer than 3 common years.\n";
+            }
+            
+            std::cout << "\nPORTFOLIO VALUE AFTER " << years_projection << " YEARS (start = 1.00, "
+                      << simulations << " simulations):\n" << std::setprecision(3);
+            std::cout << "Average: " << stats["mean"] << "  (standard error " << stats["std_error"] << ")\n";
+            std::cout << "Median: " << stats["median"] << "\n";
+            std::cout << "5th / 95th Percentile: " << stats["p5"] << " / " << stats["p95"] << "\n";
+            std::cout << "25th / 75th Percentile: " << stats["p25"] << " / " << stats["p75"] << "\n";
+            std::cout << std::setprecision(1);
+            std::cout << "Probability of Growth: " << stats["growth_probability"] << "%\n";
+            std::cout << "Value at Risk (95%): " << stats["var95"] << "% of the portfolio\n";
+            std::cout << "Expected Shortfall (95%): " << stats["cvar95"] << "% of the portfolio\n";
+            
+        } catch (const std::exception& e) {
+            std::cout << "Error in portfolio simulation: " << e.what() << "\n";
+        }
+    }
+    
+    // Command-line mode: CSV on `out`, errors reported as exceptions
+    void writeComparisonCsv(const std::vector<std::string>& tickers, int year, std::ostream& out) {
+        Profiler::Scope profile("feature.compare");
+        if (!ensurePanel()) {
+            throw std::runtime_error("main table has no ticker/year data");
+        }
+        
+        std::vector<int> foundTickers;
+        for (auto ticker : tickers) {
+            std::transform(ticker.begin(), ticker.end(), ticker.begin(), ::toupper);
+            int id = panel.tickerId(ticker);
+            if (panel.hasRow(id, year) && std::find(foundTickers.begin(), foundTickers.end(), id) == foundTickers.end()) {
+                foundTickers.push_back(id);
+            }
+        }
+        if (foundTickers.empty()) {
+            throw std::runtime_error("no data found for the specified tickers and year");
+        }
+        
+        out << "metric";
+        for (int id : foundTickers) out << "," << csvField(panel.tickerName(id));
+        out << "\n";
+        for (size_t m = 0; m < panel.metricCount(); ++m) {
+            out << csvField(panel.metrics()[m]);
+            for (int id : foundTickers) {
+                out << "," << csvNumber(panel.value(static_cast<int>(m), id, year));
+            }
+            out << "\n";
+        }
+    }
+    
+    // One row of cached sector statistics per metric (all panel metrics when none given)
+    void writeSectorCsv(const std::string& sector, int year, std::vector<std::string> metrics, std::ostream& out) {
+        Profiler::Scope profile("feature.sector");
+        if (!ensurePanel()) {
+            throw std::runtime_error("no data loaded for table '" + mainTable + "'");
+        }
+        if (metrics.empty()) metrics = panel.metrics();
+        for (const auto& metric : metrics) {
+            if (panel.metricId(metric) < 0) {
+                throw std::invalid_argument("unknown metric '" + metric + "'");
+            }
+        }
+        
+        out << "sector,year,metric,count,mean,std_dev,min,p25,median,p75,max\n";
+        for (const auto& metric : metrics) {
+            const SectorAggregate* stats = sectorAggregate(sector, year, metric);
+            if (!stats) continue;
+            out << csvField(sector) << "," << year << "," << csvField(metric) << "," << stats->count << ","
+                << csvNumber(stats->mean) << "," << csvNumber(stats->stdDev()) << "," << csvNumber(stats->min) << ","
+                << csvNumber(stats->percentile(0.25)) << "," << csvNumber(stats->median()) << ","
+                << csvNumber(stats->percentile(0.75)) << "," << csvNumber(stats->max) << "\n";
+        }
+    }
+    
+    // Universe-wide series analytics of one metric: every kernel runs over all
+    // tickers' contiguous histories at once, one row per ticker-period. The
+    // window counts periods (years, or quarters with quarterly = true).
+    void writeSeriesCsv(const std::string& metric, size_t window, bool quarterly, std::ostream& out) {
+        Profiler::Scope profile("feature.series");
+        if (!ensurePanel()) {
+            throw std::runtime_error("no data loaded for table '" + mainTable + "'");
+        }
+        if (quarterly) {
+            if (!ensureQuarterlyPanel()) {
+                throw std::runtime_error("no quarterly data in table '" + mainTable + "'");
+            }
+            writeSeriesCsv(quarterlyPanel, metric, window, out);
+        } else {
+            writeSeriesCsv(panel, metric, window, out);
+        }
+    }
+    
+    template <typename Value>
+    void writeSeriesCsv(const BasicPanelStore<Value>& source, const std::string& metric, size_t window,
+                        std::ostream& out) {
+        int metricId = source.metricId(metric);
+        if (metricId < 0) {
+            throw std::invalid_argument("unknown metric '" + metric + "'");
+        }
+        if (window < 2) {
+            throw std::invalid_argument("window must be at least 2");
+        }
+        
+        const size_t periodsPerYear = static_cast<size_t>(source.periodsPerYear());
+        const bool quarterly = periodsPerYear > 1;
+        auto yoy = TimeSeries::acrossTickers(source, metricId, scheduler, [&](const Value* x, size_t n, double* o) {
+            TimeSeries::growth(x, n, periodsPerYear, o);
+        });
+        std::vector<double> qoq;
+        if (quarterly) {
+            qoq = TimeSeries::acrossTickers(source, metricId, scheduler, [](const Value* x, size_t n, double* o) {
+                TimeSeries::growth(x, n, 1, o);
+            });
+        }
+        auto cagr = TimeSeries::acrossTickers(source, metricId, scheduler, [&](const Value* x, size_t n, double* o) {
+            TimeSeries::rollingCagr(x, n, window - 1, static_cast<double>(periodsPerYear), o);
+        });
+        // Full windows only, so every rolling_*_<window> value covers `window` periods
+        std::vector<double> mean, stdDev, zScore;
+        TimeSeries::rollingStatsAcrossTickers(source, metricId, scheduler, window, window, mean, stdDev, zScore);
+        auto drawdown = TimeSeries::acrossTickers(source, metricId, scheduler, [](const Value* x, size_t n, double* o) {
+            TimeSeries::maxDrawdown(x, n, o);
+        });
+        
+        const Value* values = source.column(metricId);
+        const uint8_t* present = source.presentCells();
+        out << "ticker,year," << (quarterly ? "period," : "") << csvField(metric) << ",yoy_growth,"
+            << (quarterly ? "qoq_growth," : "") << "cagr_" << window << ",rolling_mean_" << window
+            << ",rolling_std_" << window << ",zscore_" << window << ",max_drawdown\n";
+        for (size_t cell = 0; cell < source.cellCount(); ++cell) {
+            if (!present[cell]) continue;
+            out << csvField(source.tickerName(source.cellTicker(cell))) << "," << source.cellYear(cell) << ",";
+            if (quarterly) out << source.periodLabel(source.cellPeriod(cell)) << ",";
+            out << csvNumber(values[cell]) << "," << csvNumber(yoy[cell]) << ",";
+            if (quarterly) out << csvNumber(qoq[cell]) << ",";
+            out << csvNumber(cagr[cell]) << "," << csvNumber(mean[cell]) << "," << csvNumber(stdDev[cell]) << ","
+                << csvNumber(zScore[cell]) << "," << csvNumber(drawdown[cell]) << "\n";
+        }
+    }
+    
+    void writeScreenCsv(const std::string& condition, std::ostream& out) {
+        Profiler::Scope profile("feature.screen");
+        auto query = compileScreen(condition);
+        auto results = runScreen(query);
+        bool ranked = query.rankMetric >= 0;
+        out << "ticker,year";
+        if (ranked) out << "," << csvField(panel.metrics()[query.rankMetric]);
+        out << "\n";
+        for (const auto& match : results) {
+            out << csvField(panel.tickerName(match.tickerId)) << "," << match.year;
+            if (ranked) out << "," << csvNumber(match.rankValue);
+            out << "\n";
+        }
+    }
+    
+    // Simulates a batch and prints one row per (ticker, metric); optionally stores it too
+    BatchMonteCarloSummary writeBatchCsv(const BatchMonteCarloRequest& request, bool save, std::ostream& out) {
+        Profiler::Scope profile("feature.batch_montecarlo");
+        BatchMonteCarloSummary summary;
+        auto start = std::chrono::steady_clock::now();
+        auto results = simulateBatch(request, summary);
+        if (save) {
+            saveBatchResults(results, request, summary);
+        } else {
+            summary.completed = results.size();
+        }
+        summary.elapsedMs = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+        
+        out << "ticker,metric,base_year,current_value,mean_return,volatility,projection_years,simulations,"
+               "seed,mean,std_error,median,p5,p25,p75,p95,min,max,growth_probability\n";
+        for (const auto& job : results) {
+            const auto& stats = job.stats;
+            out << csvField(job.ticker) << "," << csvField(job.metric) << "," << job.model.latestYear << ","
+                << csvNumber(job.model.currentValue) << "," << csvNumber(job.model.meanReturn) << ","
+                << csvNumber(job.model.volatility) << "," << request.years << "," << request.simulations << ","
+                << job.seed;
+            for (const char* key : {"mean", "std_error", "median", "p5", "p25", "p75", "p95", "min", "max",
+                                    "growth_probability"}) {
+                out << "," << csvNumber(stats.at(key));
+            }
+            out << "\n";
+        }
+        return summary;
+    }
+    
+    // One row per asset (native units) and a final "PORTFOLIO" row (start = 1.0)
+    void writePortfolioCsv(const std::vector<std::string>& tickers, const std::string& metric,
+                           const std::vector<double>& weights, int years, int simulations, std::ostream& out) {
+        Profiler::Scope profile("feature.portfolio");
+        auto model = fitPortfolio(tickers, metric, weights);
+        auto values = mcSimulator.simulatePortfolio(model, years, simulations);
+        statusOut() << "Correlation from at least " << model.overlappingReturns << " common returns, shrunk "
+                    << std::fixed << std::setprecision(0) << model.shrinkage * 100 << "% towards identity\n";
+        
+        out << "asset,weight,current_value,mean_return,volatility,projection_years,simulations,"
+               "mean,std_error,median,p5,p25,p75,p95,min,max,growth_probability,var95,cvar95\n";
+        auto writeRow = [&](const std::string& name, double weight, double current, double meanReturn,
+                            double volatility, std::vector<double>& terminal) {
+            auto stats = mcSimulator.calculatePortfolioStatistics(terminal, current);
+            out << csvField(name) << "," << csvNumber(weight) << "," << csvNumber(current) << ","
+                << csvNumber(meanReturn) << "," << csvNumber(volatility) << "," << years << "," << simulations;
+            for (const char* key : {"mean", "std_error", "median", "p5", "p25", "p75", "p95", "min", "max",
+                                    "growth_probability", "var95", "cvar95"}) {
+                out << "," << csvNumber(stats.at(key));
+            }
+            out << "\n";
+        };
+        for (size_t a = 0; a < model.assets.size(); ++a) {
+            const auto& asset = model.models[a];
+            writeRow(model.assets[a], model.weights[a], asset.currentValue, asset.meanReturn, asset.volatility,
+                     values.assets[a]);
+        }
+        writeRow("PORTFOLIO", 1.0, 1.0, PanelStore::missing, PanelStore::missing, values.portfolio);
+    }
+    
+    // Feature 11: Database Inspection
+    void inspectDatabase() {
+        std::string table;
+        std::cout << "Enter table name (or ALL): ";
+        std::cin >> table;
+        
+        std::string upper = table;
+        std::transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
+        db.inspectDatabase(upper == "ALL" ? "" : table);
+    }
+    
+    void inspectDatabase(const std::string& table) {
+        Profiler::Scope profile("feature.inspect");
+        db.inspectDatabase(table);
+    }
+    
+    // Feature 12: Query Plans
+    void showQueryPlans() {
+        Profiler::Scope profile("feature.plan");
+        if (mainTable.empty()) {
+            std::cout << "No suitable table found for financial data!\n";
+            return;
+        }
+        
+        std::string table = Database::quoteIdentifier(mainTable);
+        std::vector<std::pair<std::string, std::string>> queries;
+        if (mainTableIsLongFormat()) {
+            queries.push_back({"Panel load (pivot scan)",
+                "SELECT cik, fiscal_year, metric_tag, value FROM " + table +
+                " WHERE fiscal_period = ? ORDER BY cik, fiscal_year, metric_tag"});
+            queries.push_back({"Ticker history", "SELECT * FROM " + table + " WHERE cik = ? AND fiscal_period = 'FY'"});
+        } else {
+            queries.push_back({"Panel load", "SELECT * FROM " + table + " WHERE ticker IS NOT NULL AND year IS NOT NULL"});
+            queries.push_back({"Ticker/year lookup", "SELECT * FROM " + table + " WHERE ticker = ? AND year = ?"});
+            queries.push_back({"Recent years", "SELECT * FROM " + table + " WHERE ticker = ? ORDER BY year DESC LIMIT 5"});
+            if (mainTableHasColumn("sector")) {
+                queries.push_back({"Sector/year", "SELECT ticker FROM " + table + " WHERE sector = ? AND year = ?"});
+            }
+        }
+        
+        std::cout << "\n=== QUERY PLANS (" << mainTable << ") ===\n";
+        for (const auto& [label, query] : queries) {
+            std::cout << "\n" << label << ":\n  " << query << "\n";
+            try {
+                for (const auto& line : db.explainQueryPlan(query)) {
+                    std::cout << "    " << line << "\n";
+                }
+            } catch (const std::exception& e) {
+                std::cout << "    " << e.what() << "\n";
+            }
+        }
+    }
+    
+    // Feature 9: Reload in-memory data after the database changed
+    void reloadData() {
+        Profiler::Scope profile("feature.reload");
+        std::cout << "\n=== RELOAD DATA ===\n";
+        catalog.refresh();
+        if (!mainTable.empty() && !catalog.tableExists(mainTable)) {
+            std::cout << "Table '" << mainTable << "' no longer exists!\n";
+            mainTable.clear();
+            screener.reset();
+            aggregates.clear();
+            quarterlyPanel.clear();
+            panel.clear();
+            return;
+        }
+        
+        // Keep the old panel so the sector aggregates only absorb what changed
+        PanelStore previous = std::move(panel);
+        SectorAggregateCache cached = std::move(aggregates);
+        loadPanel();
+        if (panel.loaded() && cached.built()) {
+            cached.update(previous, panel);
+            aggregates = std::move(cached);
+        }
+    }
 };
 
 void showMenu() {
@@ -1173,12 +2144,62 @@ void showMenu() {
     std::cout << "6. Monte Carlo Simulation\n";
     std::cout << "7. Risk Analysis\n";
     std::cout << "8. Change Main Table\n";
-    std::cout << "9. Exit\n";
+    std::cout << "9. Reload Data\n";
+    std::cout << "10. Batch Monte Carlo\n";
+    std::cout << "11. Inspect Database\n";
+    std::cout << "12. Query Plans\n";
+    std::cout << "13. Portfolio Monte Carlo\n";
+    std::cout << "14. Prepare Database (WAL, indexes)\n";
+    std::cout << "0. Exit\n";
     std::cout << std::string(50, '=') << "\n";
-    std::cout << "Select option (1-9): ";
+    std::cout << "Select option (0-14): ";
+}
+
+void printUsage(std::ostream& out) {
+    out << "Usage: app [--db path] [--table name] [--seed n] [--snapshot FILE] [--persist-cache]\n"
+        << "           [--prepare] [--profile] [--trace FILE]\n"
+        << "           <command> [args]\n"
+        << "Without a command the interactive menu starts. --snapshot keeps a binary copy of the\n"
+        << "in-memory panel in FILE and maps it on later runs while the database is unchanged.\n"
+        << "--persist-cache keeps Monte Carlo results in a side file, <database>.cache, so a\n"
+        << "rerun with the same --seed, parameters and data is answered without simulating.\n"
+        << "--prepare switches the database to WAL and indexes the main table first (a one-time\n"
+        << "cost on large tables); without it the journal mode and indexes are left as they are.\n"
+        << "--profile prints a per-stage timing breakdown to stderr at exit; --trace also writes\n"
+        << "Chrome trace JSON to FILE.\n\n"
+        << "Commands (CSV on stdout, status on stderr):\n"
+        << "  compare TICKER TICKER... YEAR\n"
+        << "  screen \"CONDITION [ORDER BY METRIC [DESC]] [LIMIT n]\"\n"
+        << "  sector \"SECTOR\" YEAR [METRIC...]\n"
+        << "  series METRIC [--window n] [--resolution annual|quarterly]\n"
+        << "  inspect [TABLE]\n"
+        << "  plan\n"
+        << "  montecarlo [--tickers FILE|LIST|ALL] [--metrics LIST] [--simulations n] [--years n]\n"
+        << "             [--variance none|antithetic|control|quasi] [--save]\n"
+        << "  portfolio TICKER... [--metric m] [--weights LIST] [--simulations n] [--years n]\n";
 }
 
-int main() {
+// Reads tickers from a file (whitespace/comma separated) or from an inline list
+std::vector<std::string> readTickerList(const std::string& argument) {
+    std::ifstream file(argument);
+    std::string text = argument;
+    if (file) {
+        std::stringstream contents;
+        contents << file.rdbuf();
+        text = contents.str();
+    }
+    std::replace_if(text.begin(), text.end(), [](char c) { return std::isspace(static_cast<unsigned char>(c)); }, ',');
+    auto tickers = splitList(text);
+    if (tickers.size() == 1) {
+        std::string upper = tickers[0];
+        std::transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
+        if (upper == "ALL") tickers.clear();
+    }
+    return tickers;
+}
+
+// Interactive menu loop
+int runInteractive() {
     try {
         std::string dbPath;
         std::cout << "Enter database path (default: financial_data_new.db): ";
@@ -1191,10 +2212,13 @@ int main() {
         std::cout << "Using database: " << dbPath << "\n";
         FinancialAnalyzer analyzer(dbPath);
         
-        int choice = 0;
-        while (choice != 9) {
+        int choice = -1;
+        while (choice != 0) {
             showMenu();
-            std::cin >> choice;
+            if (!(std::cin >> choice)) {
+                break; // end of input
+            }
+            analyzer.beginCommand();
             
             switch (choice) {
                 case 1:
@@ -1222,6 +2246,24 @@ int main() {
                     analyzer.changeMainTable();
                     break;
                 case 9:
+                    analyzer.reloadData();
+                    break;
+                case 10:
+                    analyzer.batchMonteCarloSimulation();
+                    break;
+                case 11:
+                    analyzer.inspectDatabase();
+                    break;
+                case 12:
+                    analyzer.showQueryPlans();
+                    break;
+                case 13:
+                    analyzer.portfolioMonteCarlo();
+                    break;
+                case 14:
+                    analyzer.enablePreparation();
+                    break;
+                case 0:
                     std::cout << "Goodbye!\n";
                     break;
                 default:
@@ -1236,4 +2278,171 @@ int main() {
     }
     
     return 0;
+}
+// Non-interactive entry point: app [--db path] <command> [args]
+int runCommandLine(int argc, char* argv[]) {
+    std::map<std::string, std::string> options;
+    std::vector<std::string> args;
+    bool save = false;
+    bool profile = false;
+    bool persistCache = false;
+    bool prepare = false;
+    
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            printUsage(std::cout);
+            return 0;
+        } else if (arg == "--save") {
+            save = true;
+        } else if (arg == "--profile") {
+            profile = true;
+        } else if (arg == "--persist-cache") {
+            persistCache = true;
+        } else if (arg == "--prepare") {
+            prepare = true;
+        } else if (arg.size() > 2 && arg.compare(0, 2, "--") == 0) {
+            if (i + 1 >= argc) {
+                std::cerr << "Missing value for " << arg << "\n";
+                return 2;
+            }
+            options[arg.substr(2)] = argv[++i];
+        } else {
+            args.push_back(arg);
+        }
+    }
+    
+    const std::string command = args.empty() ? "" : args[0];
+    const std::string tracePath = options.count("trace") ? options["trace"] : "";
+    if (profile || !tracePath.empty()) {
+        Profiler::enable(!tracePath.empty());
+    }
+    // Printed on every exit path once profiling is on
+    struct ProfileReport {
+        const std::string& tracePath;
+        ~ProfileReport() {
+            if (!Profiler::enabled()) return;
+            Profiler::report(std::cerr);
+            if (!tracePath.empty()) {
+                if (Profiler::writeChromeTrace(tracePath)) {
+                    std::cerr << "Trace written to " << tracePath << "\n";
+                } else {
+                    std::cerr << "Cannot write trace to " << tracePath << "\n";
+                }
+            }
+        }
+    } report{tracePath};
+    if (command.empty() && Profiler::enabled()) {
+        return runInteractive();
+    }
+    
+    bool validCommand = (command == "compare" && args.size() >= 3) ||
+                        (command == "screen" && args.size() == 2) ||
+                        (command == "sector" && args.size() >= 3) ||
+                        (command == "series" && args.size() == 2) ||
+                        (command == "inspect" && args.size() <= 2) ||
+                        (command == "plan" && args.size() == 1) ||
+                        (command == "montecarlo" && args.size() == 1) ||
+                        (command == "portfolio" && args.size() >= 2);
+    if (!validCommand) {
+        printUsage(std::cerr);
+        return 2;
+    }
+    auto option = [&](const std::string& name, const std::string& fallback) {
+        auto it = options.find(name);
+        return it == options.end() ? fallback : it->second;
+    };
+    
+    try {
+        FinancialAnalyzer analyzer(option("db", "../../financial_data.db"), false);
+        if (options.count("table") && !analyzer.setMainTable(options["table"])) {
+            return 1;
+        }
+        if (prepare) {
+            analyzer.enablePreparation();
+        }
+        if (options.count("seed")) {
+            analyzer.simulator().setSeed(std::stoull(options["seed"]));
+        }
+        if (options.count("snapshot")) {
+            analyzer.setSnapshotPath(options["snapshot"]);
+        }
+        if (persistCache) {
+            analyzer.persistResultCache();
+        }
+        
+        if (command == "compare") {
+            std::vector<std::string> tickers(args.begin() + 1, args.end() - 1);
+            analyzer.writeComparisonCsv(tickers, std::stoi(args.back()), std::cout);
+        } else if (command == "screen") {
+            analyzer.writeScreenCsv(args[1], std::cout);
+        } else if (command == "sector") {
+            std::vector<std::string> metrics(args.begin() + 3, args.end());
+            analyzer.writeSectorCsv(args[1], std::stoi(args[2]), metrics, std::cout);
+        } else if (command == "series") {
+            std::string resolution = option("resolution", "annual");
+            if (resolution != "annual" && resolution != "quarterly") {
+                std::cerr << "Unknown resolution '" << resolution << "' (annual or quarterly)\n";
+                return 2;
+            }
+            analyzer.writeSeriesCsv(args[1], std::stoul(option("window", "5")), resolution == "quarterly", std::cout);
+        } else if (command == "plan") {
+            analyzer.showQueryPlans();
+        } else if (command == "inspect") {
+            analyzer.inspectDatabase(args.size() == 2 ? args[1] : "");
+        } else if (command == "portfolio") {
+            std::vector<std::string> tickers(args.begin() + 1, args.end());
+            std::vector<double> weights;
+            for (const auto& weight : splitList(option("weights", ""))) weights.push_back(std::stod(weight));
+            int simulations = std::stoi(option("simulations", "5000"));
+            int years = std::stoi(option("years", "5"));
+            if (simulations < 1 || years < 1) {
+                std::cerr << "Simulations and projection years must be positive.\n";
+                return 2;
+            }
+            analyzer.writePortfolioCsv(tickers, option("metric", "revenue"), weights, years, simulations, std::cout);
+        } else {
+            BatchMonteCarloRequest request;
+            request.tickers = readTickerList(option("tickers", "ALL"));
+            request.metrics = splitList(option("metrics", "revenue"));
+            request.simulations = std::stoi(option("simulations", "5000"));
+            request.years = std::stoi(option("years", "5"));
+            if (request.simulations < 1 || request.years < 1) {
+                std::cerr << "Simulations and projection years must be positive.\n";
+                return 2;
+            }
+            
+            std::string variance = option("variance", "none");
+            if (variance == "antithetic") {
+                analyzer.simulator().setVarianceReduction(VarianceReduction::Antithetic);
+            } else if (variance == "control") {
+                analyzer.simulator().setVarianceReduction(VarianceReduction::ControlVariate);
+            } else if (variance == "quasi") {
+                analyzer.simulator().setVarianceReduction(VarianceReduction::QuasiRandom);
+            } else if (variance != "none") {
+                std::cerr << "Unknown variance reduction '" << variance << "'\n";
+                return 2;
+            }
+            
+            auto summary = analyzer.writeBatchCsv(request, save, std::cout);
+            std::cerr << "Jobs: " << summary.jobs << ", simulated: " << summary.simulated
+                      << ", skipped: " << summary.skipped << ", cached: " << summary.cached
+                      << ", elapsed: " << std::fixed
+                      << std::setprecision(1) << summary.elapsedMs << " ms";
+            if (save) std::cerr << ", run_id: " << summary.runId;
+            std::cerr << "\n";
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1) {
+        return runCommandLine(argc, argv);
+    }
+    return runInteractive();
 }
\ No newline at end of file